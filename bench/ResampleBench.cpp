@@ -0,0 +1,258 @@
+// Checks resamplePixels and times it against the scalar bilinear scaler
+// the wlr backend used before. Built and run by `make bench`.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "capture/Resample.hpp"
+
+using namespace coomer;
+
+namespace {
+
+struct Image {
+    int w = 0;
+    int h = 0;
+    std::vector<std::uint8_t> pixels;
+
+    Image(int width, int height)
+        : w(width),
+          h(height),
+          pixels(static_cast<size_t>(width) * height * 4u) {}
+
+    std::ptrdiff_t stride() const {
+        return static_cast<std::ptrdiff_t>(w) * 4;
+    }
+    std::uint8_t* row(int y) {
+        return pixels.data() + static_cast<size_t>(y) * stride();
+    }
+};
+
+// The per-pixel float scaler resamplePixels replaced, kept as the baseline.
+void scalarBilinear(const Image& src, Image& dst) {
+    float scaleX = 0.0f;
+    float scaleY = 0.0f;
+    if (dst.w > 1 && src.w > 1) {
+        scaleX = static_cast<float>(src.w - 1) / static_cast<float>(dst.w - 1);
+    }
+    if (dst.h > 1 && src.h > 1) {
+        scaleY = static_cast<float>(src.h - 1) / static_cast<float>(dst.h - 1);
+    }
+    for (int y = 0; y < dst.h; ++y) {
+        float srcYf = scaleY * static_cast<float>(y);
+        int y0 = static_cast<int>(srcYf);
+        int y1 = std::min(y0 + 1, src.h - 1);
+        float fy = srcYf - static_cast<float>(y0);
+        for (int x = 0; x < dst.w; ++x) {
+            float srcXf = scaleX * static_cast<float>(x);
+            int x0 = static_cast<int>(srcXf);
+            int x1 = std::min(x0 + 1, src.w - 1);
+            float fx = srcXf - static_cast<float>(x0);
+            size_t dstIdx = (static_cast<size_t>(y) * dst.w + x) * 4u;
+            size_t idx00 = (static_cast<size_t>(y0) * src.w + x0) * 4u;
+            size_t idx10 = (static_cast<size_t>(y0) * src.w + x1) * 4u;
+            size_t idx01 = (static_cast<size_t>(y1) * src.w + x0) * 4u;
+            size_t idx11 = (static_cast<size_t>(y1) * src.w + x1) * 4u;
+            for (int c = 0; c < 4; ++c) {
+                float v00 = static_cast<float>(src.pixels[idx00 + c]);
+                float v10 = static_cast<float>(src.pixels[idx10 + c]);
+                float v01 = static_cast<float>(src.pixels[idx01 + c]);
+                float v11 = static_cast<float>(src.pixels[idx11 + c]);
+                float v0 = v00 + (v10 - v00) * fx;
+                float v1 = v01 + (v11 - v01) * fx;
+                float v = v0 + (v1 - v0) * fy;
+                int vi = static_cast<int>(v + 0.5f);
+                dst.pixels[dstIdx + c] =
+                    static_cast<std::uint8_t>(std::clamp(vi, 0, 255));
+            }
+        }
+    }
+}
+
+void fillRandom(Image& image, unsigned int seed) {
+    std::srand(seed);
+    for (std::uint8_t& byte : image.pixels) {
+        byte = static_cast<std::uint8_t>(std::rand() & 0xff);
+    }
+}
+
+Image flipRows(Image& src) {
+    Image flipped(src.w, src.h);
+    for (int y = 0; y < src.h; ++y) {
+        std::copy(src.row(y), src.row(y) + src.stride(),
+                  flipped.row(src.h - 1 - y));
+    }
+    return flipped;
+}
+
+const char* filterName(ResampleFilter filter) {
+    switch (filter) {
+        case ResampleFilter::Auto:
+            return "auto";
+        case ResampleFilter::Area:
+            return "area";
+        case ResampleFilter::Bilinear:
+            return "bilinear";
+        case ResampleFilter::Bicubic:
+            return "bicubic";
+    }
+    return "?";
+}
+
+constexpr ResampleFilter kFilters[] = {
+    ResampleFilter::Auto, ResampleFilter::Area, ResampleFilter::Bilinear,
+    ResampleFilter::Bicubic};
+
+int g_failures = 0;
+
+void check(bool ok, const char* what, ResampleFilter filter, int srcW,
+           int srcH, int dstW, int dstH) {
+    if (!ok) {
+        std::printf("FAIL %s: %s %dx%d -> %dx%d\n", what, filterName(filter),
+                    srcW, srcH, dstW, dstH);
+        ++g_failures;
+    }
+}
+
+// Every filter must pass a flat colour through unchanged, in both
+// directions and with either axis left alone.
+void checkFlat() {
+    const int sizes[][4] = {{100, 60, 37, 23}, {37, 23, 100, 60},
+                            {64, 64, 64, 32},  {64, 64, 32, 64},
+                            {5, 5, 13, 3},     {1920, 1080, 1280, 720}};
+    const std::uint8_t colour[4] = {10, 200, 255, 0};
+    for (const auto& size : sizes) {
+        Image src(size[0], size[1]);
+        for (size_t i = 0; i < src.pixels.size(); ++i) {
+            src.pixels[i] = colour[i % 4];
+        }
+        for (ResampleFilter filter : kFilters) {
+            Image dst(size[2], size[3]);
+            resamplePixels(src.pixels.data(), src.stride(), src.w, src.h,
+                           dst.pixels.data(), dst.stride(), dst.w, dst.h,
+                           filter);
+            bool flat = true;
+            for (size_t i = 0; i < dst.pixels.size(); ++i) {
+                flat = flat && dst.pixels[i] == colour[i % 4];
+            }
+            check(flat, "flat colour changed", filter, src.w, src.h, dst.w,
+                  dst.h);
+        }
+    }
+}
+
+// A bottom-up image read with a negative stride must give the same result
+// as the upright image.
+void checkFlipped() {
+    const int sizes[][4] = {
+        {640, 360, 427, 240}, {320, 200, 640, 400}, {300, 300, 300, 150}};
+    for (const auto& size : sizes) {
+        Image src(size[0], size[1]);
+        fillRandom(src, 7);
+        Image flipped = flipRows(src);
+        for (ResampleFilter filter : kFilters) {
+            Image upright(size[2], size[3]);
+            Image inverted(size[2], size[3]);
+            resamplePixels(src.pixels.data(), src.stride(), src.w, src.h,
+                           upright.pixels.data(), upright.stride(), upright.w,
+                           upright.h, filter);
+            resamplePixels(flipped.row(flipped.h - 1), -flipped.stride(),
+                           flipped.w, flipped.h, inverted.pixels.data(),
+                           inverted.stride(), inverted.w, inverted.h, filter);
+            check(upright.pixels == inverted.pixels,
+                  "negative stride differs", filter, src.w, src.h,
+                  upright.w, upright.h);
+        }
+    }
+}
+
+// Halving with area averaging is a rounded 2x2 box average.
+void checkHalving() {
+    Image src(512, 288);
+    fillRandom(src, 3);
+    Image dst(src.w / 2, src.h / 2);
+    resamplePixels(src.pixels.data(), src.stride(), src.w, src.h,
+                   dst.pixels.data(), dst.stride(), dst.w, dst.h,
+                   ResampleFilter::Area);
+    int maxError = 0;
+    for (int y = 0; y < dst.h; ++y) {
+        for (int x = 0; x < dst.w * 4; ++x) {
+            int c = x % 4;
+            int px = (x / 4) * 2;
+            int sum = src.row(2 * y)[px * 4 + c] +
+                      src.row(2 * y)[(px + 1) * 4 + c] +
+                      src.row(2 * y + 1)[px * 4 + c] +
+                      src.row(2 * y + 1)[(px + 1) * 4 + c];
+            maxError =
+                std::max(maxError, std::abs(dst.row(y)[x] - (sum + 2) / 4));
+        }
+    }
+    check(maxError <= 1, "box average off by more than 1",
+          ResampleFilter::Area, src.w, src.h, dst.w, dst.h);
+}
+
+// Best of a few runs, in milliseconds.
+double bestOf(int runs, const std::function<void()>& fn) {
+    double best = 1e30;
+    for (int i = 0; i < runs; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+void bench(int srcW, int srcH, int dstW, int dstH, int runs) {
+    Image src(srcW, srcH);
+    fillRandom(src, 1);
+    Image flipped = flipRows(src);
+    Image dst(dstW, dstH);
+    std::printf("%dx%d -> %dx%d, best of %d:\n", srcW, srcH, dstW, dstH,
+                runs);
+    double scalar = bestOf(runs, [&] { scalarBilinear(src, dst); });
+    std::printf("  %-22s %8.2f ms\n", "scalar bilinear (old)", scalar);
+    for (ResampleFilter filter : kFilters) {
+        double ms = bestOf(runs, [&] {
+            resamplePixels(src.pixels.data(), src.stride(), src.w, src.h,
+                           dst.pixels.data(), dst.stride(), dst.w, dst.h,
+                           filter);
+        });
+        std::printf("  %-22s %8.2f ms  %5.2fx\n", filterName(filter), ms,
+                    scalar / ms);
+    }
+    double ms = bestOf(runs, [&] {
+        resamplePixels(flipped.row(flipped.h - 1), -flipped.stride(),
+                       flipped.w, flipped.h, dst.pixels.data(), dst.stride(),
+                       dst.w, dst.h, ResampleFilter::Auto);
+    });
+    std::printf("  %-22s %8.2f ms  %5.2fx\n", "auto, negative stride", ms,
+                scalar / ms);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int runs = argc > 1 ? std::max(1, std::atoi(argv[1])) : 5;
+
+    checkFlat();
+    checkFlipped();
+    checkHalving();
+    if (g_failures > 0) {
+        std::printf("%d checks failed\n", g_failures);
+        return 1;
+    }
+    std::printf("all checks passed\n\n");
+
+    bench(3840, 2160, 2560, 1440, runs);
+    bench(2560, 1440, 3840, 2160, runs);
+    bench(3840, 2160, 1920, 1080, runs);
+    return 0;
+}
@@ -50,6 +50,47 @@ complete -c coomer -l overlay \
 complete -c coomer -l portal-interactive \
     -d "Enable interactive mode for portal (show selection dialog)"
 
+# --filter <mode>: nearest|bilinear|bicubic|lanczos
+complete -c coomer -l filter -r -f \
+    -a "nearest bilinear bicubic lanczos" \
+    -d "Filter used once the view is at rest (default: bicubic)"
+
+# --software
+complete -c coomer -l software \
+    -d "Render on the CPU without OpenGL"
+
+# --gles
+complete -c coomer -l gles \
+    -d "Use an OpenGL ES 3.0 context (Wayland only)"
+
+# --viewporter
+complete -c coomer -l viewporter \
+    -d "Let the compositor zoom via wp_viewporter, no GL (Wayland only)"
+
+# --latency
+complete -c coomer -l latency \
+    -d "Report input-to-photon latency on exit"
+
+# --predict
+complete -c coomer -l predict \
+    -d "Extrapolate the pointer to the expected presentation time"
+
+# --low-latency
+complete -c coomer -l low-latency \
+    -d "Allow tearing and compositor bypass to cut latency"
+
+# --hud
+complete -c coomer -l hud \
+    -d "Show the performance HUD (toggle with H)"
+
+# --stats
+complete -c coomer -l stats \
+    -d "Report frame time percentiles and missed frames on exit"
+
+# --stats-json <file>
+complete -c coomer -l stats-json -r -F \
+    -d "Like --stats, and write them to <file> as JSON"
+
 # --no-spotlight
 complete -c coomer -l no-spotlight \
     -d "Disable spotlight mode"
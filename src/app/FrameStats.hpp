@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "platform/Log.hpp"
+
+namespace coomer {
+
+// Per-frame timings of the render loop, kept for the most recent kMaxFrames
+// frames. All times are in seconds.
+class FrameStats {
+public:
+    static constexpr size_t kMaxFrames = 4096;
+
+    struct Frame {
+        // Loop work for the frame, swaps excluded.
+        double cpu = 0.0;
+        // Time spent in swap/present calls.
+        double swap = 0.0;
+        // Time since the previous frame, 0 when the loop idled in between.
+        double interval = 0.0;
+    };
+
+    void add(const Frame& frame) {
+        frames_[next_] = frame;
+        next_ = (next_ + 1) % kMaxFrames;
+        count_ = std::min(count_ + 1, kMaxFrames);
+        ++total_;
+    }
+
+    // GPU execution time of one upload or draw; these arrive frames after
+    // the work and are summarized on their own.
+    void addGpuUpload(double seconds) {
+        gpuUpload_.add(seconds);
+    }
+    void addGpuDraw(double seconds) {
+        gpuDraw_.add(seconds);
+    }
+
+    // Output refresh period from presentation feedback; without it the
+    // median frame interval stands in for it.
+    void setRefresh(double refresh) {
+        if (refresh > 0.0) {
+            refresh_ = refresh;
+        }
+    }
+
+    void report() const {
+        if (count_ == 0) {
+            LOG_INFO("frame stats: no frames rendered");
+            return;
+        }
+        Summary cpu = summarize(&Frame::cpu);
+        Summary swap = summarize(&Frame::swap);
+        Summary interval = summarize(&Frame::interval);
+        double refresh = refreshPeriod(interval);
+        LOG_INFO("frame stats over %zu of %zu frames (ms, p50/p95/p99/max):",
+                 count_, total_);
+        logSummary("cpu", cpu);
+        logSummary("swap", swap);
+        logSummary("interval", interval);
+        if (gpuDraw_.count > 0) {
+            logSummary("gpu draw", summarize(gpuDraw_.values()));
+        }
+        if (gpuUpload_.count > 0) {
+            logSummary("gpu upload", summarize(gpuUpload_.values()));
+        }
+        LOG_INFO("  missed %zu of %zu continuous frames (refresh %.2f ms%s)",
+                 missedFrames(refresh), interval.count, refresh * 1000.0,
+                 refresh_ > 0.0 ? "" : ", estimated");
+    }
+
+    bool writeJson(const std::string& path) const {
+        std::FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            LOG_ERROR("failed to write frame stats to %s", path.c_str());
+            return false;
+        }
+        Summary interval = summarize(&Frame::interval);
+        double refresh = refreshPeriod(interval);
+        std::fprintf(file,
+                     "{\"frames\": %zu, \"recorded\": %zu, \"refresh_ms\": "
+                     "%.3f, \"refresh_estimated\": %s, \"missed\": %zu",
+                     total_, count_, refresh * 1000.0,
+                     refresh_ > 0.0 ? "false" : "true",
+                     missedFrames(refresh));
+        writeJsonSummary(file, "cpu_ms", summarize(&Frame::cpu));
+        writeJsonSummary(file, "swap_ms", summarize(&Frame::swap));
+        writeJsonSummary(file, "interval_ms", interval);
+        if (gpuDraw_.count > 0) {
+            writeJsonSummary(file, "gpu_draw_ms",
+                             summarize(gpuDraw_.values()));
+        }
+        if (gpuUpload_.count > 0) {
+            writeJsonSummary(file, "gpu_upload_ms",
+                             summarize(gpuUpload_.values()));
+        }
+        std::fprintf(file, "}\n");
+        std::fclose(file);
+        return true;
+    }
+
+private:
+    struct Summary {
+        size_t count = 0;
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+    struct Samples {
+        std::array<double, kMaxFrames> ring{};
+        size_t next = 0;
+        size_t count = 0;
+
+        void add(double value) {
+            ring[next] = value;
+            next = (next + 1) % kMaxFrames;
+            count = std::min(count + 1, kMaxFrames);
+        }
+        std::vector<double> values() const {
+            return std::vector<double>(ring.begin(), ring.begin() + count);
+        }
+    };
+
+    // Percentiles of one field over the recorded frames; intervals of 0
+    // (the loop idled before the frame) are left out.
+    Summary summarize(double Frame::*field) const {
+        std::vector<double> values;
+        values.reserve(count_);
+        for (size_t i = 0; i < count_; ++i) {
+            double value = frames_[i].*field;
+            if (field != &Frame::interval || value > 0.0) {
+                values.push_back(value);
+            }
+        }
+        return summarize(std::move(values));
+    }
+
+    static Summary summarize(std::vector<double> values) {
+        Summary summary;
+        summary.count = values.size();
+        if (values.empty()) {
+            return summary;
+        }
+        std::sort(values.begin(), values.end());
+        auto percentile = [&values](double p) {
+            return values[static_cast<size_t>(p * (values.size() - 1) + 0.5)];
+        };
+        summary.p50 = percentile(0.5);
+        summary.p95 = percentile(0.95);
+        summary.p99 = percentile(0.99);
+        summary.max = values.back();
+        return summary;
+    }
+
+    double refreshPeriod(const Summary& interval) const {
+        return refresh_ > 0.0 ? refresh_ : interval.p50;
+    }
+
+    // A frame is missed when it came more than half a refresh late.
+    size_t missedFrames(double refresh) const {
+        if (refresh <= 0.0) {
+            return 0;
+        }
+        size_t missed = 0;
+        for (size_t i = 0; i < count_; ++i) {
+            missed += frames_[i].interval > refresh * 1.5 ? 1 : 0;
+        }
+        return missed;
+    }
+
+    static void logSummary(const char* name, const Summary& s) {
+        LOG_INFO("  %-10s %7.2f %7.2f %7.2f %7.2f", name, s.p50 * 1000.0,
+                 s.p95 * 1000.0, s.p99 * 1000.0, s.max * 1000.0);
+    }
+
+    static void writeJsonSummary(std::FILE* file, const char* name,
+                                 const Summary& s) {
+        std::fprintf(file,
+                     ", \"%s\": {\"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, "
+                     "\"max\": %.3f}",
+                     name, s.p50 * 1000.0, s.p95 * 1000.0, s.p99 * 1000.0,
+                     s.max * 1000.0);
+    }
+
+    std::array<Frame, kMaxFrames> frames_{};
+    size_t next_ = 0;
+    size_t count_ = 0;
+    size_t total_ = 0;
+    double refresh_ = 0.0;
+    Samples gpuUpload_;
+    Samples gpuDraw_;
+};
+
+}  // namespace coomer
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <string>
+
+#include "app/cli.hpp"
+#include "capture/CaptureTypes.hpp"
+#include "render/IRenderer.hpp"
+
+namespace coomer {
+
+// State behind the performance HUD: what was captured and how long each
+// stage took, plus recent frame times for the graph and FPS.
+class Hud {
+public:
+    static constexpr size_t kGraphFrames = 120;
+
+    explicit Hud(bool visible) : visible_(visible) {}
+
+    bool visible() const {
+        return visible_;
+    }
+    void toggle() {
+        visible_ = !visible_;
+    }
+
+    void setCapture(const std::string& backend, const CaptureResult& capture,
+                    double captureSeconds) {
+        backend_ = backend;
+        imageW_ = capture.image.w;
+        imageH_ = capture.image.h;
+        captureSeconds_ = captureSeconds;
+        grabSeconds_ = capture.grabSeconds;
+        decodeSeconds_ = capture.decodeSeconds;
+    }
+    void setUpload(double cpuSeconds) {
+        uploadSeconds_ = cpuSeconds;
+    }
+    void addGpuTiming(const GpuTiming& timing) {
+        double seconds = timing.end - timing.start;
+        if (timing.stage == GpuTiming::Stage::Upload) {
+            gpuUploadSeconds_ = seconds;
+        } else {
+            gpuDrawSeconds_ = seconds;
+        }
+    }
+    void setRefresh(double refresh) {
+        if (refresh > 0.0) {
+            refresh_ = refresh;
+        }
+    }
+
+    // interval is the time since the previous frame, 0 after an idle
+    // period; the graph then shows the frame's own work time.
+    void addFrame(double workSeconds, double interval) {
+        frames_.push_back(Frame{workSeconds, interval});
+        if (frames_.size() > kGraphFrames) {
+            frames_.pop_front();
+        }
+    }
+
+    HudInfo build(float zoom, FilterMode filter, size_t textureBytes) const {
+        HudInfo info;
+        double intervals = 0.0;
+        size_t continuous = 0;
+        for (const Frame& frame : frames_) {
+            info.frameTimes.push_back(static_cast<float>(
+                frame.interval > 0.0 ? frame.interval : frame.work));
+            if (frame.interval > 0.0) {
+                intervals += frame.interval;
+                ++continuous;
+            }
+        }
+        double fps = continuous > 0 ? continuous / intervals : 0.0;
+        double work = frames_.empty() ? 0.0 : frames_.back().work;
+        info.lines.push_back(format("%5.1f fps  frame %.2f ms  gpu %.2f ms",
+                                    fps, work * 1000.0,
+                                    gpuDrawSeconds_ * 1000.0));
+        info.lines.push_back(format("%s %dx%d", backend_.c_str(), imageW_,
+                                    imageH_));
+        info.lines.push_back(format(
+            "capture %.1f ms  grab %.1f  decode %.1f", captureSeconds_ * 1000.0,
+            grabSeconds_ * 1000.0, decodeSeconds_ * 1000.0));
+        info.lines.push_back(format("upload %.1f ms  gpu %.2f ms",
+                                    uploadSeconds_ * 1000.0,
+                                    gpuUploadSeconds_ * 1000.0));
+        info.lines.push_back(
+            format("texture %.1f MiB", textureBytes / (1024.0 * 1024.0)));
+        info.lines.push_back(format("zoom %.2fx  %s", zoom,
+                                    filterModeToString(filter).c_str()));
+        info.targetFrameTime = static_cast<float>(refresh_);
+        return info;
+    }
+
+private:
+    struct Frame {
+        double work;
+        double interval;
+    };
+
+    template <typename... Args>
+    static std::string format(const char* fmt, Args... args) {
+        char buffer[128];
+        std::snprintf(buffer, sizeof(buffer), fmt, args...);
+        return buffer;
+    }
+
+    bool visible_;
+    std::string backend_;
+    int imageW_ = 0;
+    int imageH_ = 0;
+    double captureSeconds_ = 0.0;
+    double grabSeconds_ = 0.0;
+    double decodeSeconds_ = 0.0;
+    double uploadSeconds_ = 0.0;
+    double gpuUploadSeconds_ = 0.0;
+    double gpuDrawSeconds_ = 0.0;
+    double refresh_ = 1.0 / 60.0;
+    std::deque<Frame> frames_;
+};
+
+}  // namespace coomer
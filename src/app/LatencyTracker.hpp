@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "platform/Log.hpp"
+#include "window/IWindow.hpp"
+
+namespace coomer {
+
+// Matches presentation feedback to the swaps that produced it, giving the
+// input-to-photon latency of frames drawn in response to input and the
+// usual delay between a swap and the frame reaching the screen.
+class LatencyTracker {
+public:
+    // Records a swap. inputTime is the newest input event the frame shows,
+    // or 0 when the frame was not drawn in response to input.
+    void swapped(double swapTime, double inputTime) {
+        ++swaps_;
+        pending_.push_back(Swap{swaps_, swapTime, inputTime});
+        // Feedback that never arrives must not pile up
+        if (pending_.size() > 64) {
+            pending_.pop_front();
+        }
+    }
+
+    void presented(const std::vector<FramePresentation>& frames) {
+        for (const FramePresentation& frame : frames) {
+            if (frame.modeKnown) {
+                ++modeFrames_;
+                tornFrames_ += frame.torn ? 1 : 0;
+                zeroCopyFrames_ += frame.zeroCopy ? 1 : 0;
+            }
+            while (!pending_.empty() && pending_.front().swap < frame.swap) {
+                pending_.pop_front();
+            }
+            if (pending_.empty() || pending_.front().swap != frame.swap) {
+                continue;
+            }
+            const Swap& swap = pending_.front();
+            double delay = frame.time - swap.swapTime;
+            if (delay >= 0.0) {
+                presentDelay_ = hasDelay_
+                                    ? presentDelay_ + (delay - presentDelay_) *
+                                                          0.1
+                                    : delay;
+                hasDelay_ = true;
+            }
+            if (swap.inputTime > 0.0 && frame.time >= swap.inputTime) {
+                latencies_.push_back(frame.time - swap.inputTime);
+            }
+            pending_.pop_front();
+        }
+    }
+
+    // Smoothed delay from swap to presentation, 0 until feedback arrived.
+    double presentDelay() const {
+        return presentDelay_;
+    }
+
+    void report() const {
+        if (latencies_.empty()) {
+            LOG_INFO("input-to-photon latency: no presentation feedback");
+            return;
+        }
+        std::vector<double> sorted = latencies_;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&sorted](double p) {
+            size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+            return sorted[index] * 1000.0;
+        };
+        LOG_INFO(
+            "input-to-photon latency over %zu frames: p50 %.1f ms, p90 %.1f "
+            "ms, p99 %.1f ms, max %.1f ms",
+            sorted.size(), percentile(0.5), percentile(0.9), percentile(0.99),
+            sorted.back() * 1000.0);
+    }
+
+    // Logs how frames were actually shown, so a low-latency request can be
+    // checked against what the compositor did with it.
+    void reportPresentationModes() const {
+        if (modeFrames_ == 0) {
+            LOG_INFO("presentation mode: not reported by the window system");
+            return;
+        }
+        LOG_INFO(
+            "presentation mode over %zu frames: %zu torn (async), %zu "
+            "zero-copy (compositor bypassed)",
+            modeFrames_, tornFrames_, zeroCopyFrames_);
+    }
+
+private:
+    struct Swap {
+        std::uint64_t swap;
+        double swapTime;
+        double inputTime;
+    };
+
+    std::uint64_t swaps_ = 0;
+    std::deque<Swap> pending_;
+    std::vector<double> latencies_;
+    double presentDelay_ = 0.0;
+    bool hasDelay_ = false;
+    size_t modeFrames_ = 0;
+    size_t tornFrames_ = 0;
+    size_t zeroCopyFrames_ = 0;
+};
+
+}  // namespace coomer
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+
+namespace coomer {
+
+// Pointer speed from the timing of motion events. Used for the release
+// speed of a drag, so a flick keeps the speed the hand had, and to
+// extrapolate the pointer.
+class MotionVelocity {
+public:
+    void reset() {
+        samples_.clear();
+    }
+
+    void add(double time, float dx, float dy) {
+        samples_.push_back(Sample{time, dx, dy});
+        // Keep one sample older than the window as the start of the span
+        while (samples_.size() > 2 && time - samples_[1].time > kWindow) {
+            samples_.pop_front();
+        }
+    }
+
+    // Time of the latest sample, 0 if there is none.
+    double lastTime() const {
+        return samples_.empty() ? 0.0 : samples_.back().time;
+    }
+
+    // Average speed in px/s over the motion that ended at most kWindow
+    // before `time`; zero when the pointer had come to rest.
+    void velocity(double time, float* vx, float* vy) const {
+        *vx = 0.0f;
+        *vy = 0.0f;
+        if (samples_.size() < 2 || time - samples_.back().time > kWindow) {
+            return;
+        }
+        double span = samples_.back().time - samples_.front().time;
+        if (span <= 0.0) {
+            return;
+        }
+        float sumX = 0.0f;
+        float sumY = 0.0f;
+        for (size_t i = 1; i < samples_.size(); ++i) {
+            sumX += samples_[i].dx;
+            sumY += samples_[i].dy;
+        }
+        *vx = static_cast<float>(sumX / span);
+        *vy = static_cast<float>(sumY / span);
+    }
+
+private:
+    struct Sample {
+        double time;
+        float dx;
+        float dy;
+    };
+    static constexpr double kWindow = 0.06;
+    std::deque<Sample> samples_;
+};
+
+}  // namespace coomer
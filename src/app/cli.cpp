@@ -23,16 +23,38 @@ static void printUsage(const char* exe) {
                  "(wlr/portal only)\n"
               << "  --portal-interactive   Enable interactive mode for portal "
                  "(show selection dialog)\n"
+              << "  --filter <mode>        Filter used once the view is at "
+                 "rest: nearest|bilinear|bicubic|lanczos (default: bicubic)\n"
+              << "  --software             Render on the CPU without OpenGL "
+                 "(nearest/bilinear only)\n"
+              << "  --gles                 Use an OpenGL ES 3.0 context "
+                 "(Wayland only)\n"
+              << "  --viewporter           Let the compositor zoom via "
+                 "wp_viewporter, no GL (Wayland only)\n"
+              << "  --latency              Report input-to-photon latency "
+                 "on exit\n"
+              << "  --predict              Extrapolate the pointer to the "
+                 "expected presentation time\n"
+              << "  --low-latency          Allow tearing and compositor "
+                 "bypass to cut latency\n"
+              << "  --hud                  Show the performance HUD (toggle "
+                 "with H)\n"
+              << "  --stats                Report frame time percentiles and "
+                 "missed frames on exit\n"
+              << "  --stats-json <file>    Like --stats, and write them to "
+                 "<file> as JSON\n"
               << "  --no-spotlight         Disable spotlight mode\n"
               << "  --version              Show version\n"
-              << "  --debug                Enable debug logging\n"
+              << "  --debug                Enable debug logging (DEBUG_LOG=1 "
+                 "builds)\n"
               << "  --help, -h             Show this help message\n"
               << "\n"
               << "Hotkeys:\n"
               << "  Q or A or Right click: quit\n"
               << "  Hold Left click: pan\n"
               << "  Scroll wheel: zoom\n"
-              << "  Hold Ctrl: spotlight (Ctrl + wheel to resize)\n";
+              << "  Hold Ctrl: spotlight (Ctrl + wheel to resize)\n"
+              << "  H: toggle performance HUD\n";
 }
 
 static void printVersion() {
@@ -53,6 +75,20 @@ std::string backendKindToString(BackendKind kind) {
     return "auto";
 }
 
+std::string filterModeToString(FilterMode mode) {
+    switch (mode) {
+        case FilterMode::Nearest:
+            return "nearest";
+        case FilterMode::Bilinear:
+            return "bilinear";
+        case FilterMode::Bicubic:
+            return "bicubic";
+        case FilterMode::Lanczos:
+            return "lanczos";
+    }
+    return "bilinear";
+}
+
 bool parseCli(int argc, char** argv, CliOptions& out, std::string& err) {
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -80,10 +116,51 @@ bool parseCli(int argc, char** argv, CliOptions& out, std::string& err) {
                 return false;
             }
             out.monitor = argv[++i];
+        } else if (arg == "--filter") {
+            if (i + 1 >= argc) {
+                err = "--filter requires a value";
+                return false;
+            }
+            std::string val = argv[++i];
+            if (val == "nearest") {
+                out.filter = FilterMode::Nearest;
+            } else if (val == "bilinear") {
+                out.filter = FilterMode::Bilinear;
+            } else if (val == "bicubic") {
+                out.filter = FilterMode::Bicubic;
+            } else if (val == "lanczos") {
+                out.filter = FilterMode::Lanczos;
+            } else {
+                err = "unknown filter: " + val;
+                return false;
+            }
         } else if (arg == "--list-monitors") {
             out.listMonitors = true;
         } else if (arg == "--debug") {
             out.debug = true;
+        } else if (arg == "--software") {
+            out.software = true;
+        } else if (arg == "--gles") {
+            out.gles = true;
+        } else if (arg == "--viewporter") {
+            out.viewporter = true;
+        } else if (arg == "--latency") {
+            out.latency = true;
+        } else if (arg == "--predict") {
+            out.predict = true;
+        } else if (arg == "--low-latency") {
+            out.lowLatency = true;
+        } else if (arg == "--hud") {
+            out.hud = true;
+        } else if (arg == "--stats") {
+            out.stats = true;
+        } else if (arg == "--stats-json") {
+            if (i + 1 >= argc) {
+                err = "--stats-json requires a file";
+                return false;
+            }
+            out.stats = true;
+            out.statsJson = argv[++i];
         } else if (arg == "--no-spotlight") {
             out.noSpotlight = true;
         } else if (arg == "--overlay") {
@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "capture/BackendFactory.hpp"
+#include "render/IRenderer.hpp"
 
 namespace coomer {
 
@@ -16,9 +17,21 @@ struct CliOptions {
     bool noSpotlight = false;
     bool overlay = false;
     bool portalInteractive = false;
+    FilterMode filter = FilterMode::Bicubic;
+    bool software = false;
+    bool gles = false;
+    bool viewporter = false;
+    bool latency = false;
+    bool predict = false;
+    bool lowLatency = false;
+    bool stats = false;
+    bool hud = false;
+    // Also write the frame stats as JSON to this file
+    std::string statsJson;
 };
 
 bool parseCli(int argc, char** argv, CliOptions& out, std::string& err);
 std::string backendKindToString(BackendKind kind);
+std::string filterModeToString(FilterMode mode);
 
 }  // namespace coomer
@@ -4,12 +4,23 @@
 #include <iostream>
 #include <memory>
 
+#include "app/FrameStats.hpp"
+#include "app/Hud.hpp"
+#include "app/LatencyTracker.hpp"
+#include "app/MotionVelocity.hpp"
 #include "app/cli.hpp"
 #include "capture/BackendFactory.hpp"
 #include "capture/CaptureTypes.hpp"
+#include "platform/DisplayConnection.hpp"
 #include "platform/Log.hpp"
+#include "platform/Memory.hpp"
 #include "platform/Time.hpp"
+#include "platform/Trace.hpp"
+#include "render/Damage.hpp"
+#include "render/IRenderer.hpp"
 #include "render/RendererGL.hpp"
+#include "render/RendererSoftware.hpp"
+#include "render/RendererViewport.hpp"
 #include "window/IWindow.hpp"
 
 #if defined(COOMER_HAS_X11)
@@ -42,16 +53,41 @@ void printMonitorList(const std::string& backendName,
     }
 }
 
+bool sameCamera(const CameraState& a, const CameraState& b) {
+    return a.zoom == b.zoom && a.panX == b.panX && a.panY == b.panY &&
+           a.screenW == b.screenW && a.screenH == b.screenH;
+}
+
+bool sameSpotlight(const SpotlightState& a, const SpotlightState& b) {
+    if (a.enabled != b.enabled) {
+        return false;
+    }
+    if (!a.enabled) {
+        return true;
+    }
+    return a.cursorX == b.cursorX && a.cursorY == b.cursorY &&
+           a.radiusPx == b.radiusPx && a.tintR == b.tintR &&
+           a.tintG == b.tintG && a.tintB == b.tintB && a.tintA == b.tintA;
+}
+
+// True when the frame only differs from the presented one by where the
+// spotlight circle is, so everything outside the two circles is unchanged.
+bool onlySpotlightMoved(const SpotlightState& a, const SpotlightState& b) {
+    return a.enabled && b.enabled && a.tintR == b.tintR &&
+           a.tintG == b.tintG && a.tintB == b.tintB && a.tintA == b.tintA;
+}
+
 std::unique_ptr<IWindow> createWindowForSession(const WindowConfig& cfg,
                                                 const std::string& backendName,
-                                                bool overlay) {
+                                                bool overlay,
+                                                DisplayConnection& connection) {
     bool waylandSession = std::getenv("WAYLAND_DISPLAY") != nullptr;
     bool forceX11 = (backendName == "x11");
     if (waylandSession && !forceX11) {
 #if defined(COOMER_HAS_WAYLAND)
         if (overlay) {
             LOG_DEBUG("window: requested layer-shell overlay");
-            auto layer = CreateWaylandWindowLayerShellEgl(cfg);
+            auto layer = CreateWaylandWindowLayerShellEgl(cfg, connection);
             if (layer) {
                 LOG_DEBUG("window: layer-shell surface created");
                 return layer;
@@ -59,7 +95,7 @@ std::unique_ptr<IWindow> createWindowForSession(const WindowConfig& cfg,
             LOG_WARN("layer-shell unavailable, falling back to xdg-shell");
         }
         LOG_DEBUG("window: using xdg-shell fullscreen");
-        return CreateWaylandWindowXdgEgl(cfg);
+        return CreateWaylandWindowXdgEgl(cfg, connection);
 #else
         LOG_ERROR("Wayland window support disabled at build time");
         return nullptr;
@@ -71,13 +107,101 @@ std::unique_ptr<IWindow> createWindowForSession(const WindowConfig& cfg,
         LOG_WARN("overlay ignored on X11");
     }
     LOG_DEBUG("window: using X11 fullscreen");
-    return CreateX11WindowGlx(cfg);
+    return CreateX11WindowGlx(cfg, connection);
 #else
     LOG_ERROR("X11 window support disabled at build time");
     return nullptr;
 #endif
 }
 
+void logMemory(const char* when, const IRenderer& renderer) {
+    MemoryUsage usage = readMemoryUsage();
+    LOG_DEBUG(
+        "memory %s: rss %.1f MiB (peak %.1f MiB), renderer image %.1f MiB, "
+        "textures ~%.1f MiB",
+        when, toMiB(usage.rss), toMiB(usage.peakRss),
+        toMiB(renderer.imageBytes()), toMiB(renderer.textureBytes()));
+}
+
+// Per-view presentation state. Views of a multi-output window render
+// their own part of the desk and are paced independently.
+struct ViewState {
+    // Bottom-left corner of the view on the desk, in camera pixels.
+    float offsetX = 0.0f;
+    float offsetY = 0.0f;
+    bool hasPresented = false;
+    CameraState presentedCamera;
+    SpotlightState presentedSpotlight;
+    FilterMode presentedFilter = FilterMode::Bilinear;
+    DamageHistory damageHistory;
+};
+
+// Places a view showing `mon` on the desk the screenshot covers. Returns
+// false when the monitor layout does not match the stitched image (e.g.
+// scaled outputs), in which case the view shows the image unshifted.
+bool placeView(const CaptureResult& capture, const MonitorInfo& mon,
+               ViewState& view) {
+    bool hasBounds = false;
+    int minX = 0;
+    int minY = 0;
+    int maxX = 0;
+    int maxY = 0;
+    for (const auto& m : capture.monitors) {
+        if (m.w <= 0 || m.h <= 0) {
+            continue;
+        }
+        if (!hasBounds) {
+            minX = m.x;
+            minY = m.y;
+            maxX = m.x + m.w;
+            maxY = m.y + m.h;
+            hasBounds = true;
+        } else {
+            minX = std::min(minX, m.x);
+            minY = std::min(minY, m.y);
+            maxX = std::max(maxX, m.x + m.w);
+            maxY = std::max(maxY, m.y + m.h);
+        }
+    }
+    if (!hasBounds || maxX - minX != capture.image.w ||
+        maxY - minY != capture.image.h) {
+        return false;
+    }
+    view.offsetX = static_cast<float>(mon.x - minX);
+    view.offsetY = static_cast<float>(maxY - (mon.y + mon.h));
+    return true;
+}
+
+std::unique_ptr<IRenderer> createRenderer(IWindow& window,
+                                          const WindowConfig& cfg) {
+    if (cfg.viewporter) {
+        auto renderer = std::make_unique<RendererViewport>();
+        if (!renderer->init(
+                [&window](int w, int h) { return window.viewportImage(w, h); },
+                [&window](const ViewportSource& source) {
+                    window.setViewportSource(source);
+                })) {
+            return nullptr;
+        }
+        return renderer;
+    }
+    if (cfg.software) {
+        auto renderer = std::make_unique<RendererSoftware>();
+        if (!renderer->init(
+                [&window]() { return window.softwareFramebuffer(); })) {
+            return nullptr;
+        }
+        return renderer;
+    }
+    auto renderer = std::make_unique<RendererGL>();
+    if (!renderer->initGL([&window](const char* name) -> void* {
+            return window.glGetProcAddress(name);
+        })) {
+        return nullptr;
+    }
+    return renderer;
+}
+
 }  // namespace
 
 }  // namespace coomer
@@ -86,6 +210,8 @@ int main(int argc, char** argv) {
     using namespace coomer;
 
     initFileLogging();
+    initTracing();
+    TRACE_THREAD("main");
 
     CliOptions options;
     std::string err;
@@ -96,8 +222,17 @@ int main(int argc, char** argv) {
     }
 
     setDebugLogging(options.debug);
+#if !defined(COOMER_HAS_DEBUG_LOG)
+    if (options.debug) {
+        LOG_WARN("debug messages are compiled out; rebuild with DEBUG_LOG=1");
+    }
+#endif
 
-    auto backend = CreateBackend(options.backend, options.portalInteractive);
+    // Capture and window share the display connections; declared first so
+    // it is closed last.
+    DisplayConnection connection;
+    auto backend =
+        CreateBackend(options.backend, connection, options.portalInteractive);
     if (!backend) {
         LOG_ERROR("failed to create backend");
         closeFileLogging();
@@ -126,7 +261,10 @@ int main(int argc, char** argv) {
         return 0;
     }
 
+    double captureStart = nowSeconds();
     CaptureResult capture = backend->captureOnce(options.monitor);
+    Hud hud(options.hud);
+    hud.setCapture(backend->name(), capture, nowSeconds() - captureStart);
     if (capture.image.rgba.empty() || capture.image.w <= 0 ||
         capture.image.h <= 0) {
         LOG_ERROR("capture failed on backend '%s'", backend->name().c_str());
@@ -143,104 +281,204 @@ int main(int argc, char** argv) {
     cfg.width = capture.image.w;
     cfg.height = capture.image.h;
     cfg.overlay = options.overlay;
+    cfg.software = options.software;
+    cfg.gles = options.gles;
+    cfg.viewporter = options.viewporter;
+    cfg.lowLatency = options.lowLatency;
     cfg.title = "coomer";
 
+    const MonitorInfo* selectedMonitor = nullptr;
     if (capture.selectedMonitorIndex >= 0 &&
         capture.selectedMonitorIndex <
             static_cast<int>(capture.monitors.size())) {
-        const auto& mon = capture.monitors[capture.selectedMonitorIndex];
-        cfg.x = mon.x;
-        cfg.y = mon.y;
-        cfg.width = mon.w;
-        cfg.height = mon.h;
+        selectedMonitor = &capture.monitors[capture.selectedMonitorIndex];
+        cfg.x = selectedMonitor->x;
+        cfg.y = selectedMonitor->y;
+        cfg.width = selectedMonitor->w;
+        cfg.height = selectedMonitor->h;
+    }
+    // The overlay opens on the captured output, or on every output with
+    // --monitor all
+    const bool allMonitors = options.monitor && *options.monitor == "all";
+    if (options.overlay && allMonitors) {
+        for (const auto& mon : capture.monitors) {
+            cfg.outputs.push_back(mon.name);
+        }
+    } else if (options.overlay && options.monitor && selectedMonitor) {
+        cfg.outputs.push_back(selectedMonitor->name);
     }
 
-    auto window = createWindowForSession(cfg, backend->name(), options.overlay);
+    auto window = createWindowForSession(cfg, backend->name(),
+                                         options.overlay, connection);
+    std::unique_ptr<IRenderer> renderer =
+        window ? createRenderer(*window, cfg) : nullptr;
+    if (!renderer && !cfg.software) {
+        // No usable GL 3.3 or GLES 3.0 context; draw on the CPU instead
+        LOG_WARN("%s renderer unavailable, falling back to software",
+                 cfg.viewporter ? "viewporter" : "OpenGL");
+        window.reset();
+        cfg.software = true;
+        cfg.viewporter = false;
+        window = createWindowForSession(cfg, backend->name(),
+                                        options.overlay, connection);
+        renderer = window ? createRenderer(*window, cfg) : nullptr;
+    }
     if (!window) {
         LOG_ERROR("failed to create window");
         closeFileLogging();
         return 1;
     }
-
-    RendererGL renderer;
-    if (!renderer.initGL([&window](const char* name) -> void* {
-            return window->glGetProcAddress(name);
-        })) {
+    if (!renderer) {
         LOG_ERROR("failed to initialize renderer");
         closeFileLogging();
         return 1;
     }
-    if (!renderer.uploadScreenshotTexture(capture.image)) {
+    // Before the first upload, so it is timed as well
+    bool gpuTiming = options.stats || options.hud || tracing();
+    renderer->setGpuTiming(gpuTiming);
+    double uploadStart = nowSeconds();
+    if (!renderer->uploadScreenshotTexture(capture.image)) {
         LOG_ERROR("failed to upload screenshot texture");
         closeFileLogging();
         return 1;
     }
+    hud.setUpload(nowSeconds() - uploadStart);
+    // The renderer keeps its own copy (a texture, converted pixels or the
+    // viewport buffer); only the image size is used from here on.
+    size_t captureBytes = releasePixels(capture.image);
+    // Nothing is captured after this, so pooled blocks would only pin memory
+    trimImageBufferPool();
+    if (options.debug) {
+        LOG_DEBUG("capture buffer: %.1f MiB, released after upload",
+                  toMiB(captureBytes));
+        logMemory("after upload", *renderer);
+    }
 
     CameraState camera;
     camera.zoom = 1.0f;
     camera.panX = 0.0f;
     camera.panY = 0.0f;
-    if (options.monitor && *options.monitor == "all" &&
-        capture.selectedMonitorIndex >= 0 &&
-        capture.selectedMonitorIndex <
-            static_cast<int>(capture.monitors.size())) {
-        bool hasBounds = false;
-        int minX = 0;
-        int minY = 0;
-        int maxX = 0;
-        int maxY = 0;
-        for (const auto& mon : capture.monitors) {
-            if (mon.w <= 0 || mon.h <= 0) {
-                continue;
-            }
-            int left = mon.x;
-            int top = mon.y;
-            int right = left + mon.w;
-            int bottom = top + mon.h;
-            if (!hasBounds) {
-                minX = left;
-                minY = top;
-                maxX = right;
-                maxY = bottom;
-                hasBounds = true;
-            } else {
-                minX = std::min(minX, left);
-                minY = std::min(minY, top);
-                maxX = std::max(maxX, right);
-                maxY = std::max(maxY, bottom);
+
+    // Camera coordinates cover the whole desk with a bottom-left origin;
+    // each view shows the part under its monitor.
+    std::vector<ViewState> views(
+        static_cast<size_t>(std::max(1, window->viewCount())));
+    for (size_t i = 0; i < views.size(); ++i) {
+        std::string output = window->view(static_cast<int>(i)).output;
+        const MonitorInfo* mon = allMonitors ? selectedMonitor : nullptr;
+        for (const auto& candidate : capture.monitors) {
+            if (!output.empty() && candidate.name == output) {
+                mon = &candidate;
             }
         }
-        int totalW = hasBounds ? (maxX - minX) : 0;
-        int totalH = hasBounds ? (maxY - minY) : 0;
-        if (hasBounds && totalW == capture.image.w &&
-            totalH == capture.image.h) {
-            const auto& mon = capture.monitors[capture.selectedMonitorIndex];
-            camera.panX = static_cast<float>(minX - mon.x);
-            camera.panY = static_cast<float>(minY - mon.y);
+        if (mon && placeView(capture, *mon, views[i])) {
+            LOG_DEBUG("view %zu: %s at %.0f,%.0f", i, mon->name.c_str(),
+                      views[i].offsetX, views[i].offsetY);
         }
     }
-
     float panVelX = 0.0f;
     float panVelY = 0.0f;
     float zoomVel = 0.0f;
     float spotlightRadiusMulTarget = 1.0f;
     float spotlightRadiusMulCurrent = 1.0f;
-    bool prevLeft = false;
+    bool dragging = false;
+    MotionVelocity dragVelocity;
+    MotionVelocity pointerVelocity;
     bool prevSpotlight = false;
     bool spotlightAnimating = false;
     double spotlightAnimStart = 0.0;
     float spotlightAnimFrom = 0.0f;
     float spotlightAnimTo = 0.0f;
 
+    // While the view is moving we render with a cheap filter; once a frame
+    // comes out identical to the previous one we re-render it a single time
+    // with the requested filter and then sleep until something changes.
+    // The software renderer only implements nearest and bilinear; with
+    // viewporter the compositor picks the filter.
+    FilterMode restFilter = options.filter;
+    if (cfg.viewporter) {
+        restFilter = FilterMode::Bilinear;
+    } else if (cfg.software && options.filter != FilterMode::Nearest) {
+        restFilter = FilterMode::Bilinear;
+    }
+    const FilterMode motionFilter = (restFilter == FilterMode::Nearest)
+                                        ? FilterMode::Nearest
+                                        : FilterMode::Bilinear;
+    const int idleWaitMs = 100;
+    // Never extrapolate the pointer further than this many seconds
+    const double maxPredictionLead = 0.05;
+    const bool trackPresentation = options.latency || options.predict ||
+                                   options.lowLatency || options.stats;
+    LatencyTracker latency;
+    FrameStats stats;
+    // End of the last frame, 0 after the loop went idle
+    double lastFrameEnd = 0.0;
+    // Newest input event that is not on screen yet
+    double unshownInputTime = 0.0;
+    bool idle = false;
+    bool waitingForFrame = false;
+    for (ViewState& view : views) {
+        view.presentedFilter = motionFilter;
+    }
+
     double lastTime = nowSeconds();
 
     while (!window->shouldClose()) {
-        window->pollEvents();
+        {
+            TRACE_ZONE("wait events");
+            if (idle) {
+                window->waitEvents(idleWaitMs);
+            } else if (waitingForFrame) {
+                // Every view with something to draw is still waiting for its
+                // frame callback
+                window->waitEvents(16);
+            } else {
+                window->pollEvents();
+            }
+        }
+        TRACE_ZONE("frame");
+        const double frameStart = nowSeconds();
         InputState input = window->input();
+        if (trackPresentation) {
+            std::vector<FramePresentation> presented =
+                window->takePresentations();
+            for (const FramePresentation& frame : presented) {
+                stats.setRefresh(frame.refresh);
+                hud.setRefresh(frame.refresh);
+            }
+            latency.presented(presented);
+        }
+        if (gpuTiming) {
+            // Also writes them to the trace
+            for (const GpuTiming& timing : renderer->takeGpuTimings()) {
+                hud.addGpuTiming(timing);
+                double seconds = timing.end - timing.start;
+                if (timing.stage == GpuTiming::Stage::Upload) {
+                    stats.addGpuUpload(seconds);
+                } else {
+                    stats.addGpuDraw(seconds);
+                }
+            }
+        }
 
-        if (input.keyQ || input.keyA || input.mouseRight) {
+        bool quit = input.keyQ || input.keyA || input.mouseRight;
+        for (const InputEvent& event : input.events) {
+            quit = quit || (event.type == InputEvent::Type::Button &&
+                            event.button == PointerButton::Right &&
+                            event.pressed);
+        }
+        if (quit) {
             break;
         }
+        if (input.keyHPresses % 2 != 0) {
+            hud.toggle();
+            if (hud.visible() && !gpuTiming) {
+                gpuTiming = true;
+                renderer->setGpuTiming(true);
+            }
+            // The HUD lives on the first view
+            views[0].hasPresented = false;
+        }
 
         double now = nowSeconds();
         float dt = static_cast<float>(now - lastTime);
@@ -249,19 +487,47 @@ int main(int argc, char** argv) {
         }
         lastTime = now;
 
-        float cursorX = static_cast<float>(input.mouseX);
-        float cursorY = static_cast<float>(window->height() - input.mouseY);
-        float deltaX = static_cast<float>(input.deltaX);
-        float deltaY = static_cast<float>(-input.deltaY);
-
-        if (input.mouseLeft) {
-            camera.panX += deltaX;
-            camera.panY += deltaY;
-            if (dt > 0.0f) {
-                panVelX = deltaX / dt;
-                panVelY = deltaY / dt;
+        // The cursor in desk coordinates, from the view under the pointer
+        int pointerView = std::clamp(input.view, 0,
+                                     static_cast<int>(views.size()) - 1);
+        WindowView pointerInfo = window->view(pointerView);
+        const ViewState& pointerState = views[pointerView];
+        float cursorX =
+            pointerState.offsetX + static_cast<float>(input.mouseX);
+        float cursorY =
+            pointerState.offsetY +
+            static_cast<float>(pointerInfo.height - input.mouseY);
+
+        // Replay pointer events in order, so a drag shorter than a frame
+        // still pans and the release velocity uses real event timing
+        bool released = false;
+        for (const InputEvent& event : input.events) {
+            unshownInputTime = std::max(unshownInputTime, event.time);
+            if (event.type == InputEvent::Type::Button &&
+                event.button == PointerButton::Left) {
+                if (event.pressed) {
+                    dragging = true;
+                    dragVelocity.reset();
+                    panVelX = 0.0f;
+                    panVelY = 0.0f;
+                } else if (dragging) {
+                    dragging = false;
+                    released = true;
+                    dragVelocity.velocity(event.time, &panVelX, &panVelY);
+                }
+            } else if (event.type == InputEvent::Type::Motion) {
+                float dx = static_cast<float>(event.dx);
+                float dy = static_cast<float>(-event.dy);
+                pointerVelocity.add(event.time, dx, dy);
+                if (dragging) {
+                    camera.panX += dx;
+                    camera.panY += dy;
+                    dragVelocity.add(event.time, dx, dy);
+                }
             }
-        } else if (!prevLeft) {
+        }
+
+        if (!dragging && !released) {
             camera.panX += panVelX * dt;
             camera.panY += panVelY * dt;
             float decay = std::exp(-6.0f * dt);
@@ -275,7 +541,6 @@ int main(int argc, char** argv) {
                 panVelY = 0.0f;
             }
         }
-        prevLeft = input.mouseLeft;
 
         if (input.wheelDelta != 0.0) {
             float wheel = static_cast<float>(-input.wheelDelta);
@@ -306,27 +571,62 @@ int main(int argc, char** argv) {
             }
         }
 
-        camera.screenW = window->width();
-        camera.screenH = window->height();
+        if (cfg.viewporter) {
+            // The viewport source must stay inside the screenshot, so keep
+            // the image covering the screen instead of showing black edges.
+            // Viewporter mode always has a single view.
+            WindowView info = window->view(0);
+            float offX = views[0].offsetX;
+            float offY = views[0].offsetY;
+            float minPanX = std::min(
+                0.0f, info.width - capture.image.w * camera.zoom);
+            float minPanY = std::min(
+                0.0f, info.height - capture.image.h * camera.zoom);
+            camera.panX = std::clamp(camera.panX, minPanX + offX, offX);
+            camera.panY = std::clamp(camera.panY, minPanY + offY, offY);
+        }
 
         float follow = 1.0f - std::exp(-14.0f * dt);
         spotlightRadiusMulCurrent +=
             (spotlightRadiusMulTarget - spotlightRadiusMulCurrent) * follow;
         spotlightRadiusMulCurrent =
             std::clamp(spotlightRadiusMulCurrent, 0.3f, 10.0f);
+        // Snap once the difference is invisible so the view can settle
+        if (std::abs(spotlightRadiusMulTarget - spotlightRadiusMulCurrent) <
+            0.001f) {
+            spotlightRadiusMulCurrent = spotlightRadiusMulTarget;
+        }
 
         SpotlightState spotlight;
-        spotlight.enabled = (!options.noSpotlight) && input.keyCtrl;
-        spotlight.cursorX = cursorX;
-        spotlight.cursorY = cursorY;
-        float baseRadius = std::min(camera.screenW, camera.screenH) * 0.2f;
+        spotlight.enabled =
+            !options.noSpotlight && !cfg.viewporter && input.keyCtrl;
+
+        // With --predict, draw what follows the pointer where the pointer
+        // will be once the frame is on screen
+        float predictX = 0.0f;
+        float predictY = 0.0f;
+        if (options.predict && (dragging || spotlight.enabled)) {
+            float vx = 0.0f;
+            float vy = 0.0f;
+            pointerVelocity.velocity(now, &vx, &vy);
+            double lead = now + latency.presentDelay() -
+                          pointerVelocity.lastTime();
+            lead = std::clamp(lead, 0.0, maxPredictionLead);
+            predictX = static_cast<float>(vx * lead);
+            predictY = static_cast<float>(vy * lead);
+        }
+        bool predicting = predictX != 0.0f || predictY != 0.0f;
+        spotlight.cursorX = cursorX + predictX;
+        spotlight.cursorY = cursorY + predictY;
+        float pointerMin = static_cast<float>(
+            std::min(pointerInfo.width, pointerInfo.height));
+        float baseRadius = pointerMin * 0.2f;
         float targetRadius = baseRadius * spotlightRadiusMulCurrent;
         if (spotlight.enabled && !prevSpotlight) {
             spotlightAnimating = true;
             spotlightAnimStart = now;
             spotlightAnimFrom =
-                std::max(targetRadius * 1.5f,
-                         std::min(camera.screenW, camera.screenH) * 0.6f);
+                std::max(targetRadius * 1.5f, pointerMin * 0.6f);
             spotlightAnimTo = targetRadius;
         }
         if (!spotlight.enabled) {
@@ -354,10 +654,147 @@ int main(int argc, char** argv) {
         spotlight.tintA = 190.0f / 255.0f;
         prevSpotlight = spotlight.enabled;
 
-        renderer.renderFrame(camera, spotlight);
-        window->swap();
+        if (input.exposed) {
+            for (ViewState& view : views) {
+                view.hasPresented = false;
+            }
+        }
+
+        CameraState shownCamera = camera;
+        if (dragging) {
+            shownCamera.panX += predictX;
+            shownCamera.panY += predictY;
+        }
+
+        bool pending = spotlightAnimating || predicting || panVelX != 0.0f ||
+                       panVelY != 0.0f || zoomVel != 0.0f;
+        bool swapped = false;
+        double swapTime = 0.0;
+        waitingForFrame = false;
+        for (size_t i = 0; i < views.size(); ++i) {
+            ViewState& view = views[i];
+            int index = static_cast<int>(i);
+            WindowView info = window->view(index);
+
+            // Shift the desk so this view's monitor sits at its origin
+            CameraState viewCamera = shownCamera;
+            viewCamera.screenW = info.width;
+            viewCamera.screenH = info.height;
+            viewCamera.panX -= view.offsetX;
+            viewCamera.panY -= view.offsetY;
+            SpotlightState viewSpotlight = spotlight;
+            viewSpotlight.cursorX -= view.offsetX;
+            viewSpotlight.cursorY -= view.offsetY;
+
+            bool sceneChanged =
+                !view.hasPresented ||
+                !sameCamera(viewCamera, view.presentedCamera) ||
+                !sameSpotlight(viewSpotlight, view.presentedSpotlight);
+            bool moving = sceneChanged || spotlightAnimating || predicting ||
+                          panVelX != 0.0f || panVelY != 0.0f ||
+                          zoomVel != 0.0f;
+            FilterMode filter = moving ? motionFilter : restFilter;
+            bool drawHud = hud.visible() && i == 0;
+            if (!sceneChanged && filter == view.presentedFilter) {
+                continue;
+            }
+            pending = true;
+            if (!window->viewReady(index)) {
+                waitingForFrame = true;
+                continue;
+            }
+            window->selectView(index);
+
+            // Spotlight-only motion damages the old and new circle; any
+            // other change repaints the whole view.
+            DamageRect fullRect{0, 0, viewCamera.screenW,
+                                viewCamera.screenH};
+            DamageRect frameDamage = fullRect;
+            if (!drawHud && view.hasPresented &&
+                filter == view.presentedFilter &&
+                sameCamera(viewCamera, view.presentedCamera) &&
+                onlySpotlightMoved(viewSpotlight, view.presentedSpotlight)) {
+                frameDamage = intersectDamage(
+                    uniteDamage(spotlightDamageRect(view.presentedSpotlight),
+                                spotlightDamageRect(viewSpotlight)),
+                    fullRect);
+                if (frameDamage.empty()) {
+                    // The spotlight moved on another monitor
+                    view.presentedSpotlight = viewSpotlight;
+                    continue;
+                }
+            }
+            DamageRect repair = view.damageHistory.repairRegion(
+                frameDamage, window->bufferAge(), fullRect);
+            bool partial = repair.w < fullRect.w || repair.h < fullRect.h;
+
+            renderer->renderFrame(viewCamera, viewSpotlight, filter,
+                                 partial ? &repair : nullptr);
+            if (drawHud &&
+                !renderer->renderHud(
+                    hud.build(camera.zoom, filter, renderer->textureBytes()),
+                    viewCamera.screenW, viewCamera.screenH)) {
+                LOG_WARN("the HUD needs the OpenGL renderer");
+                hud.toggle();
+            }
+            double swapStart = nowSeconds();
+            {
+                TRACE_ZONE("swap");
+                window->swapWithDamage(frameDamage);
+            }
+            double swapEnd = nowSeconds();
+            swapTime += swapEnd - swapStart;
+            if (trackPresentation) {
+                latency.swapped(swapEnd, unshownInputTime);
+            }
+            swapped = true;
+            view.damageHistory.push(frameDamage);
+            view.hasPresented = true;
+            view.presentedCamera = viewCamera;
+            view.presentedSpotlight = viewSpotlight;
+            view.presentedFilter = filter;
+        }
+        idle = !pending;
+        if (swapped && (options.stats || hud.visible())) {
+            double frameEnd = nowSeconds();
+            FrameStats::Frame frame;
+            frame.cpu = frameEnd - frameStart - swapTime;
+            frame.swap = swapTime;
+            frame.interval = lastFrameEnd > 0.0 ? frameEnd - lastFrameEnd : 0.0;
+            if (options.stats) {
+                stats.add(frame);
+            }
+            hud.addFrame(frame.cpu + frame.swap, frame.interval);
+            lastFrameEnd = frameEnd;
+        }
+        if (idle) {
+            lastFrameEnd = 0.0;
+        }
+        // Input that changed nothing never reaches the screen
+        if (swapped || idle) {
+            unshownInputTime = 0.0;
+        }
     }
 
+    if (options.debug) {
+        logMemory("at exit", *renderer);
+    }
+    if (options.latency) {
+        latency.report();
+    }
+    if (options.lowLatency) {
+        latency.reportPresentationModes();
+    }
+    if (options.stats) {
+        stats.report();
+        if (!options.statsJson.empty()) {
+            stats.writeJson(options.statsJson);
+        }
+    }
+    // Stop the window's input threads before the log and trace files close
+    renderer.reset();
+    window.reset();
+    closeTracing();
     closeFileLogging();
     return 0;
 }
@@ -18,18 +18,20 @@ namespace coomer {
 
 namespace {
 
-std::unique_ptr<ICaptureBackend> createX11() {
+std::unique_ptr<ICaptureBackend> createX11(DisplayConnection& connection) {
 #if defined(COOMER_HAS_X11)
-    return CreateBackendX11();
+    return CreateBackendX11(connection);
 #else
+    (void)connection;
     return nullptr;
 #endif
 }
 
-std::unique_ptr<ICaptureBackend> createWlr() {
+std::unique_ptr<ICaptureBackend> createWlr(DisplayConnection& connection) {
 #if defined(COOMER_HAS_WAYLAND)
-    return CreateBackendWlrScreencopy();
+    return CreateBackendWlrScreencopy(connection);
 #else
+    (void)connection;
     return nullptr;
 #endif
 }
@@ -47,8 +49,8 @@ std::unique_ptr<ICaptureBackend> createPortal(bool interactive = false) {
 
 class BackendAuto final : public ICaptureBackend {
 public:
-    explicit BackendAuto(bool portalInteractive)
-        : portalInteractive_(portalInteractive) {}
+    BackendAuto(DisplayConnection& connection, bool portalInteractive)
+        : connection_(connection), portalInteractive_(portalInteractive) {}
 
     std::string name() const override {
         auto backend = selectBackend();
@@ -86,7 +88,7 @@ private:
         bool hasX11 = std::getenv("DISPLAY") != nullptr;
 
         if (hasX11 && !hasWayland) {
-            auto backend = createX11();
+            auto backend = createX11(connection_);
             if (backend && backend->isAvailable()) {
                 selected_ = std::move(backend);
                 selectedKind_ = BackendKind::X11;
@@ -96,7 +98,7 @@ private:
         }
 
         if (hasWayland) {
-            auto backend = createWlr();
+            auto backend = createWlr(connection_);
             if (backend && backend->isAvailable()) {
                 selected_ = std::move(backend);
                 selectedKind_ = BackendKind::Wlr;
@@ -117,7 +119,7 @@ private:
         }
 
         if (hasX11) {
-            auto backend = createX11();
+            auto backend = createX11(connection_);
             if (backend && backend->isAvailable()) {
                 selected_ = std::move(backend);
                 selectedKind_ = BackendKind::X11;
@@ -132,23 +134,26 @@ private:
 
     mutable std::unique_ptr<ICaptureBackend> selected_;
     mutable BackendKind selectedKind_ = BackendKind::Auto;
+    DisplayConnection& connection_;
     bool portalInteractive_;
 };
 
 std::unique_ptr<ICaptureBackend> CreateBackend(BackendKind kind,
+                                               DisplayConnection& connection,
                                                bool portalInteractive) {
     switch (kind) {
         case BackendKind::Auto:
-            return std::make_unique<BackendAuto>(portalInteractive);
+            return std::make_unique<BackendAuto>(connection,
+                                                 portalInteractive);
         case BackendKind::X11: {
-            auto backend = createX11();
+            auto backend = createX11(connection);
             if (!backend) {
                 LOG_ERROR("x11 backend disabled at build time");
             }
             return backend;
         }
         case BackendKind::Wlr: {
-            auto backend = createWlr();
+            auto backend = createWlr(connection);
             if (!backend) {
                 LOG_ERROR("wlr backend disabled at build time");
             }
@@ -3,12 +3,15 @@
 #include <memory>
 
 #include "capture/ICaptureBackend.hpp"
+#include "platform/DisplayConnection.hpp"
 
 namespace coomer {
 
 enum class BackendKind { Auto, X11, Wlr, Portal };
 
+// The backend connects through `connection`, which must outlive it.
 std::unique_ptr<ICaptureBackend> CreateBackend(BackendKind kind,
+                                               DisplayConnection& connection,
                                                bool portalInteractive = false);
 
 }  // namespace coomer
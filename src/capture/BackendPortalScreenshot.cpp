@@ -14,6 +14,8 @@
 
 #include "platform/FileUtil.hpp"
 #include "platform/Log.hpp"
+#include "platform/Time.hpp"
+#include "platform/Trace.hpp"
 
 namespace coomer {
 
@@ -114,7 +116,10 @@ public:
     }
 
     CaptureResult captureOnce(std::optional<std::string> monitorHint) override {
+        TRACE_ZONE("portal capture");
         CaptureResult result;
+        // The portal's dialog, if any, counts as grab time
+        double grabStart = nowSeconds();
         if (monitorHint) {
             LOG_WARN(
                 "portal: monitor selection not supported; system dialog "
@@ -238,7 +243,10 @@ public:
         }
 
         dbus_connection_unref(conn);
+        result.grabSeconds = nowSeconds() - grabStart;
 
+        TRACE_ZONE("portal load");
+        double decodeStart = nowSeconds();
         std::string path = fileUrlToPath(uri);
         int w = 0;
         int h = 0;
@@ -251,15 +259,18 @@ public:
         }
         (void)n;
 
-        result.image.w = w;
-        result.image.h = h;
-        result.image.rgba.assign(
-            data, data + static_cast<size_t>(w) * static_cast<size_t>(h) * 4u);
+        size_t bytes = static_cast<size_t>(w) * static_cast<size_t>(h) * 4u;
+        if (result.image.rgba.allocate(bytes)) {
+            result.image.w = w;
+            result.image.h = h;
+            std::memcpy(result.image.rgba.data(), data, bytes);
+        }
         stbi_image_free(data);
 
         // Delete the temporary file created by portal
         std::remove(path.c_str());
 
+        result.decodeSeconds = nowSeconds() - decodeStart;
         return result;
     }
 
@@ -13,48 +13,42 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "capture/Resample.hpp"
+#include "platform/DisplayConnection.hpp"
 #include "platform/Log.hpp"
+#include "platform/Trace.hpp"
+#include "platform/ShmFile.hpp"
+#include "platform/ThreadPool.hpp"
+#include "platform/Time.hpp"
 #include "wlr-screencopy-unstable-v1-client-protocol.h"
-#include "xdg-output-unstable-v1-client-protocol.h"
 
 namespace coomer {
 
 namespace {
 
-struct OutputInfo {
-    wl_output* output = nullptr;
-    zxdg_output_v1* xdg = nullptr;
-    MonitorInfo info;
-    bool gotMode = false;
-};
+// Rows go to the thread pool in ranges of at least this many pixels.
+constexpr int kMinPixelsPerRange = 256 * 1024;
 
+// Proxies bound for one capture; the display and outputs belong to the
+// shared connection.
 struct WlrContext {
     wl_display* display = nullptr;
-    wl_registry* registry = nullptr;
     wl_shm* shm = nullptr;
     zwlr_screencopy_manager_v1* manager = nullptr;
-    zxdg_output_manager_v1* xdgOutputManager = nullptr;
-    std::vector<std::unique_ptr<OutputInfo>> outputs;
+    // Summed over the outputs captured with this context
+    double grabSeconds = 0.0;
+    double decodeSeconds = 0.0;
 };
 
-int createShmFile(size_t size) {
-    for (int attempt = 0; attempt < 8; ++attempt) {
-        std::string name = "/coomer-shm-" + std::to_string(getpid()) + "-" +
-                           std::to_string(rand());
-        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_EXCL, 0600);
-        if (fd >= 0) {
-            shm_unlink(name.c_str());
-            if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
-                return fd;
-            }
-            close(fd);
-        }
-    }
-    return -1;
-}
-
 struct ShmBuffer {
     wl_buffer* buffer = nullptr;
     void* data = nullptr;
@@ -118,75 +112,6 @@ struct FrameCapture {
     uint32_t stride = 0;
 };
 
-ImageRGBA scaleImageBilinear(const ImageRGBA& src, int dstW, int dstH) {
-    ImageRGBA dst;
-    dst.w = dstW;
-    dst.h = dstH;
-    if (dstW <= 0 || dstH <= 0 || src.w <= 0 || src.h <= 0 ||
-        src.rgba.empty()) {
-        return dst;
-    }
-    dst.rgba.resize(static_cast<size_t>(dstW) * static_cast<size_t>(dstH) *
-                    4u);
-
-    float scaleX = 0.0f;
-    float scaleY = 0.0f;
-    if (dstW > 1 && src.w > 1) {
-        scaleX = static_cast<float>(src.w - 1) / static_cast<float>(dstW - 1);
-    }
-    if (dstH > 1 && src.h > 1) {
-        scaleY = static_cast<float>(src.h - 1) / static_cast<float>(dstH - 1);
-    }
-
-    for (int y = 0; y < dstH; ++y) {
-        float srcYf = scaleY * static_cast<float>(y);
-        int y0 = static_cast<int>(srcYf);
-        int y1 = std::min(y0 + 1, src.h - 1);
-        float fy = srcYf - static_cast<float>(y0);
-        for (int x = 0; x < dstW; ++x) {
-            float srcXf = scaleX * static_cast<float>(x);
-            int x0 = static_cast<int>(srcXf);
-            int x1 = std::min(x0 + 1, src.w - 1);
-            float fx = srcXf - static_cast<float>(x0);
-
-            size_t dstIdx =
-                (static_cast<size_t>(y) * static_cast<size_t>(dstW) +
-                 static_cast<size_t>(x)) *
-                4u;
-            size_t idx00 =
-                (static_cast<size_t>(y0) * static_cast<size_t>(src.w) +
-                 static_cast<size_t>(x0)) *
-                4u;
-            size_t idx10 =
-                (static_cast<size_t>(y0) * static_cast<size_t>(src.w) +
-                 static_cast<size_t>(x1)) *
-                4u;
-            size_t idx01 =
-                (static_cast<size_t>(y1) * static_cast<size_t>(src.w) +
-                 static_cast<size_t>(x0)) *
-                4u;
-            size_t idx11 =
-                (static_cast<size_t>(y1) * static_cast<size_t>(src.w) +
-                 static_cast<size_t>(x1)) *
-                4u;
-
-            for (int c = 0; c < 4; ++c) {
-                float v00 = static_cast<float>(src.rgba[idx00 + c]);
-                float v10 = static_cast<float>(src.rgba[idx10 + c]);
-                float v01 = static_cast<float>(src.rgba[idx01 + c]);
-                float v11 = static_cast<float>(src.rgba[idx11 + c]);
-                float v0 = v00 + (v10 - v00) * fx;
-                float v1 = v01 + (v11 - v01) * fx;
-                float v = v0 + (v1 - v0) * fy;
-                int vi = static_cast<int>(v + 0.5f);
-                dst.rgba[dstIdx + c] =
-                    static_cast<uint8_t>(std::clamp(vi, 0, 255));
-            }
-        }
-    }
-    return dst;
-}
-
 void frameBuffer(void* data, zwlr_screencopy_frame_v1*, uint32_t format,
                  uint32_t width, uint32_t height, uint32_t stride) {
     auto* capture = static_cast<FrameCapture*>(data);
@@ -249,234 +174,311 @@ const zwlr_screencopy_frame_v1_listener kFrameListener = {
     frameBuffer, frameFlags,       frameReady,     frameFailed,
     frameDamage, frameLinuxDmabuf, frameBufferDone};
 
-void outputGeometry(void* data, wl_output*, int32_t x, int32_t y, int32_t,
-                    int32_t, int32_t, const char*, const char*, int32_t) {
-    auto* output = static_cast<OutputInfo*>(data);
-    output->info.x = x;
-    output->info.y = y;
-}
-
-void outputMode(void* data, wl_output*, uint32_t flags, int32_t width,
-                int32_t height, int32_t) {
-    if (flags & WL_OUTPUT_MODE_CURRENT) {
-        auto* output = static_cast<OutputInfo*>(data);
-        output->info.w = width;
-        output->info.h = height;
-        output->gotMode = true;
+bool initContext(DisplayConnection& connection, WlrContext& ctx) {
+    ctx.display = connection.wayland();
+    if (!ctx.display) {
+        LOG_ERROR("wlr: failed to connect to Wayland display");
+        return false;
+    }
+    wl_registry* registry = connection.waylandRegistry();
+    if (const auto* global = connection.waylandGlobal(wl_shm_interface.name)) {
+        ctx.shm = static_cast<wl_shm*>(
+            wl_registry_bind(registry, global->name, &wl_shm_interface, 1));
+    }
+    if (const auto* global = connection.waylandGlobal(
+            zwlr_screencopy_manager_v1_interface.name)) {
+        ctx.manager =
+            static_cast<zwlr_screencopy_manager_v1*>(wl_registry_bind(
+                registry, global->name, &zwlr_screencopy_manager_v1_interface,
+                std::min(global->version, 3u)));
     }
+    return true;
 }
 
-void outputDone(void* data, wl_output*) {
-    auto* output = static_cast<OutputInfo*>(data);
-    if (output->info.name.empty()) {
-        output->info.name = "wl_output";
+void cleanupContext(WlrContext& ctx) {
+    if (ctx.manager) {
+        zwlr_screencopy_manager_v1_destroy(ctx.manager);
+    }
+    if (ctx.shm) {
+        wl_shm_destroy(ctx.shm);
     }
 }
 
-void outputScale(void* data, wl_output*, int32_t factor) {
-    auto* output = static_cast<OutputInfo*>(data);
-    output->info.scale = static_cast<float>(factor);
+// Asks for a copy of output; the frame completes on later dispatches.
+void startFrameCapture(WlrContext& ctx, wl_output* output,
+                       FrameCapture& capture) {
+    capture.shm = ctx.shm;
+    capture.frame =
+        zwlr_screencopy_manager_v1_capture_output(ctx.manager, 0, output);
+    zwlr_screencopy_frame_v1_add_listener(capture.frame, &kFrameListener,
+                                          &capture);
 }
 
-void outputName(void* data, wl_output*, const char* name) {
-    auto* output = static_cast<OutputInfo*>(data);
-    if (name) {
-        output->info.name = name;
+// Dispatches until every frame is copied or has failed, so the outputs
+// are grabbed concurrently. Frames in a format we cannot convert are
+// marked failed.
+void waitFrameCaptures(WlrContext& ctx, std::vector<FrameCapture>& captures) {
+    TRACE_ZONE("wlr screencopy wait");
+    double grabStart = nowSeconds();
+    auto pending = [&captures] {
+        for (const FrameCapture& capture : captures) {
+            if (!capture.ready && !capture.failed) {
+                return true;
+            }
+        }
+        return false;
+    };
+    while (pending() && wl_display_dispatch(ctx.display) >= 0) {
+    }
+    ctx.grabSeconds += nowSeconds() - grabStart;
+    for (FrameCapture& capture : captures) {
+        if (capture.ready && capture.format != WL_SHM_FORMAT_ARGB8888 &&
+            capture.format != WL_SHM_FORMAT_XRGB8888) {
+            LOG_ERROR("wlr: unsupported shm format %u", capture.format);
+            capture.failed = true;
+        }
     }
 }
 
-void outputDescription(void*, wl_output*, const char*) {}
-
-const wl_output_listener kOutputListener = {outputGeometry, outputMode,
-                                            outputDone,     outputScale,
-                                            outputName,     outputDescription};
-
-void xdgOutputLogicalPosition(void* data, zxdg_output_v1*, int32_t x,
-                              int32_t y) {
-    auto* output = static_cast<OutputInfo*>(data);
-    output->info.x = x;
-    output->info.y = y;
+void finishFrameCapture(FrameCapture& capture) {
+    if (capture.buffer.buffer) {
+        wl_buffer_destroy(capture.buffer.buffer);
+    }
+    if (capture.buffer.data) {
+        munmap(capture.buffer.data, capture.buffer.size);
+    }
+    if (capture.frame) {
+        zwlr_screencopy_frame_v1_destroy(capture.frame);
+    }
+    capture = FrameCapture{};
 }
 
-void xdgOutputLogicalSize(void* data, zxdg_output_v1*, int32_t width,
-                          int32_t height) {
-    auto* output = static_cast<OutputInfo*>(data);
-    output->info.w = width;
-    output->info.h = height;
+bool frameUsable(const FrameCapture& capture) {
+    return capture.ready && !capture.failed && capture.buffer.data;
 }
 
-void xdgOutputDone(void*, zxdg_output_v1*) {}
-
-void xdgOutputName(void* data, zxdg_output_v1*, const char* name) {
-    auto* output = static_cast<OutputInfo*>(data);
-    if (name) {
-        output->info.name = name;
-    }
+// Row y of the frame counted from the top, whatever its y-invert flag.
+const uint32_t* frameRow(const FrameCapture& capture, int y) {
+    int srcY = capture.yInvert ? static_cast<int>(capture.height) - 1 - y : y;
+    return reinterpret_cast<const uint32_t*>(
+        static_cast<const uint8_t*>(capture.buffer.data) +
+        static_cast<size_t>(capture.stride) * srcY);
 }
 
-void xdgOutputDescription(void*, zxdg_output_v1*, const char*) {}
-
-const zxdg_output_v1_listener kXdgOutputListener = {
-    xdgOutputLogicalPosition, xdgOutputLogicalSize, xdgOutputDone,
-    xdgOutputName, xdgOutputDescription};
-
-void registryGlobal(void* data, wl_registry* registry, uint32_t name,
-                    const char* interface, uint32_t version) {
-    auto* ctx = static_cast<WlrContext*>(data);
-    if (std::strcmp(interface, wl_shm_interface.name) == 0) {
-        ctx->shm = static_cast<wl_shm*>(
-            wl_registry_bind(registry, name, &wl_shm_interface, 1));
-    } else if (std::strcmp(interface, wl_output_interface.name) == 0) {
-        auto output = std::make_unique<OutputInfo>();
-        output->output = static_cast<wl_output*>(wl_registry_bind(
-            registry, name, &wl_output_interface, std::min(version, 4u)));
-        output->info.scale = 1.0f;
-        wl_output_add_listener(output->output, &kOutputListener, output.get());
-        ctx->outputs.push_back(std::move(output));
-    } else if (std::strcmp(interface,
-                           zwlr_screencopy_manager_v1_interface.name) == 0) {
-        ctx->manager =
-            static_cast<zwlr_screencopy_manager_v1*>(wl_registry_bind(
-                registry, name, &zwlr_screencopy_manager_v1_interface,
-                std::min(version, 3u)));
-    } else if (std::strcmp(interface, zxdg_output_manager_v1_interface.name) ==
-               0) {
-        ctx->xdgOutputManager = static_cast<zxdg_output_manager_v1*>(
-            wl_registry_bind(registry, name, &zxdg_output_manager_v1_interface,
-                             std::min(version, 3u)));
+// ARGB words to RGBA bytes. dst may alias src.
+void convertRow(const uint32_t* src, uint8_t* dst, int count, bool opaque) {
+    for (int x = 0; x < count; ++x) {
+        uint32_t pixel = src[x];
+        uint8_t* out = dst + static_cast<size_t>(x) * 4u;
+        out[0] = static_cast<uint8_t>(pixel >> 16);
+        out[1] = static_cast<uint8_t>(pixel >> 8);
+        out[2] = static_cast<uint8_t>(pixel);
+        out[3] = opaque ? 255 : static_cast<uint8_t>(pixel >> 24);
     }
 }
 
-void registryGlobalRemove(void*, wl_registry*, uint32_t) {}
-
-const wl_registry_listener kRegistryListener = {registryGlobal,
-                                                registryGlobalRemove};
+// Draws the frame into a w x h region of an RGBA image whose rows are
+// stride bytes apart. With output scaling the buffer is in physical pixels
+// while the layout is in logical ones, so frames of another size are
+// resampled first and then converted in place.
+void drawFrame(const FrameCapture& capture, uint8_t* dst, size_t stride,
+               int w, int h) {
+    TRACE_ZONE("wlr convert");
+    const bool opaque = capture.format == WL_SHM_FORMAT_XRGB8888;
+    const int grain = std::max(kMinPixelsPerRange / std::max(w, 1), 1);
+    if (static_cast<int>(capture.width) == w &&
+        static_cast<int>(capture.height) == h) {
+        threadPool().parallelFor(0, h, grain, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                convertRow(frameRow(capture, y), dst + stride * y, w, opaque);
+            }
+        });
+        return;
+    }
+    std::ptrdiff_t srcStride = static_cast<std::ptrdiff_t>(capture.stride);
+    resamplePixels(reinterpret_cast<const uint8_t*>(frameRow(capture, 0)),
+                   capture.yInvert ? -srcStride : srcStride,
+                   static_cast<int>(capture.width),
+                   static_cast<int>(capture.height), dst,
+                   static_cast<std::ptrdiff_t>(stride), w, h);
+    threadPool().parallelFor(0, h, grain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            uint8_t* row = dst + stride * y;
+            convertRow(reinterpret_cast<const uint32_t*>(row), row, w, opaque);
+        }
+    });
+}
 
-bool initContext(WlrContext& ctx) {
-    ctx.display = wl_display_connect(nullptr);
-    if (!ctx.display) {
-        LOG_ERROR("wlr: failed to connect to Wayland display");
-        return false;
+void fillPixels(uint32_t* dst, size_t count, uint32_t value) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128i v = _mm_set1_epi32(static_cast<int>(value));
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
     }
-    ctx.registry = wl_display_get_registry(ctx.display);
-    wl_registry_add_listener(ctx.registry, &kRegistryListener, &ctx);
-    wl_display_roundtrip(ctx.display);
-
-    if (ctx.xdgOutputManager) {
-        // xdg-output provides stable names and logical coordinates for
-        // wl_output.
-        for (auto& outputPtr : ctx.outputs) {
-            auto& output = *outputPtr;
-            output.xdg = zxdg_output_manager_v1_get_xdg_output(
-                ctx.xdgOutputManager, output.output);
-            zxdg_output_v1_add_listener(output.xdg, &kXdgOutputListener,
-                                        &output);
-        }
-        wl_display_roundtrip(ctx.display);
+#elif defined(__ARM_NEON)
+    uint32x4_t v = vdupq_n_u32(value);
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u32(dst + i, v);
     }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = value;
+    }
+}
 
-    if (!ctx.outputs.empty()) {
-        ctx.outputs[0]->info.primary = true;
+bool captureOutputImage(WlrContext& ctx, wl_output* output, ImageRGBA& out) {
+    TRACE_ZONE("wlr capture output");
+    std::vector<FrameCapture> captures(1);
+    startFrameCapture(ctx, output, captures[0]);
+    waitFrameCaptures(ctx, captures);
+
+    const FrameCapture& capture = captures[0];
+    bool ok = false;
+    if (!frameUsable(capture)) {
+        LOG_ERROR("wlr: capture failed");
+    } else if (out.rgba.allocate(static_cast<size_t>(capture.width) *
+                                 static_cast<size_t>(capture.height) * 4u)) {
+        double decodeStart = nowSeconds();
+        out.w = static_cast<int>(capture.width);
+        out.h = static_cast<int>(capture.height);
+        drawFrame(capture, out.rgba.data(), static_cast<size_t>(out.w) * 4u,
+                  out.w, out.h);
+        ctx.decodeSeconds += nowSeconds() - decodeStart;
+        ok = true;
     }
-    return true;
+    finishFrameCapture(captures[0]);
+    return ok;
 }
 
-void cleanupContext(WlrContext& ctx) {
-    for (auto& outputPtr : ctx.outputs) {
-        auto& output = *outputPtr;
-        if (output.xdg) {
-            zxdg_output_v1_destroy(output.xdg);
+// Composites every output into one image at its layout position, each
+// frame converted straight from its shm buffer. Gaps between outputs are
+// opaque black.
+bool stitchOutputs(WlrContext& ctx, std::vector<FrameCapture>& captures,
+                   std::vector<MonitorInfo>& monitors, ImageRGBA& out) {
+    struct Placement {
+        size_t capture;
+        int x;
+        int y;
+        int w;
+        int h;
+    };
+
+    bool hasBounds = false;
+    int minX = 0;
+    int minY = 0;
+    int maxX = 0;
+    int maxY = 0;
+    for (size_t i = 0; i < monitors.size(); ++i) {
+        MonitorInfo& mon = monitors[i];
+        if ((mon.w <= 0 || mon.h <= 0) && frameUsable(captures[i])) {
+            mon.w = mon.w > 0 ? mon.w : static_cast<int>(captures[i].width);
+            mon.h = mon.h > 0 ? mon.h : static_cast<int>(captures[i].height);
         }
-        if (output.output) {
-            wl_output_destroy(output.output);
+        if (mon.w <= 0 || mon.h <= 0) {
+            continue;
+        }
+        if (!hasBounds) {
+            minX = mon.x;
+            minY = mon.y;
+            maxX = mon.x + mon.w;
+            maxY = mon.y + mon.h;
+            hasBounds = true;
+        } else {
+            minX = std::min(minX, mon.x);
+            minY = std::min(minY, mon.y);
+            maxX = std::max(maxX, mon.x + mon.w);
+            maxY = std::max(maxY, mon.y + mon.h);
         }
     }
-    if (ctx.xdgOutputManager) {
-        zxdg_output_manager_v1_destroy(ctx.xdgOutputManager);
-    }
-    if (ctx.manager) {
-        zwlr_screencopy_manager_v1_destroy(ctx.manager);
-    }
-    if (ctx.shm) {
-        wl_shm_destroy(ctx.shm);
-    }
-    if (ctx.registry) {
-        wl_registry_destroy(ctx.registry);
-    }
-    if (ctx.display) {
-        wl_display_disconnect(ctx.display);
+    if (!hasBounds || maxX <= minX || maxY <= minY) {
+        LOG_ERROR("wlr: failed to compute output bounds");
+        return false;
     }
-}
 
-bool captureOutputImage(WlrContext& ctx, wl_output* output, ImageRGBA& out) {
-    FrameCapture capture;
-    capture.shm = ctx.shm;
-    capture.frame =
-        zwlr_screencopy_manager_v1_capture_output(ctx.manager, 0, output);
-    zwlr_screencopy_frame_v1_add_listener(capture.frame, &kFrameListener,
-                                          &capture);
+    TRACE_ZONE("wlr stitch");
+    double stitchStart = nowSeconds();
+    int totalW = maxX - minX;
+    int totalH = maxY - minY;
+    size_t stride = static_cast<size_t>(totalW) * 4u;
+    if (!out.rgba.allocate(stride * static_cast<size_t>(totalH))) {
+        return false;
+    }
+    out.w = totalW;
+    out.h = totalH;
 
-    while (!capture.ready && !capture.failed) {
-        wl_display_dispatch(ctx.display);
+    std::vector<Placement> placements;
+    for (size_t i = 0; i < monitors.size(); ++i) {
+        const MonitorInfo& mon = monitors[i];
+        if (mon.w > 0 && mon.h > 0 && frameUsable(captures[i])) {
+            placements.push_back(
+                Placement{i, mon.x - minX, mon.y - minY, mon.w, mon.h});
+        }
     }
 
-    bool ok = false;
-    if (capture.failed || !capture.buffer.data) {
-        LOG_ERROR("wlr: capture failed");
-    } else if (capture.format != WL_SHM_FORMAT_ARGB8888 &&
-               capture.format != WL_SHM_FORMAT_XRGB8888) {
-        LOG_ERROR("wlr: unsupported shm format %u", capture.format);
-    } else {
-        int width = static_cast<int>(capture.width);
-        int height = static_cast<int>(capture.height);
-        out.w = width;
-        out.h = height;
-        out.rgba.resize(static_cast<size_t>(width) *
-                        static_cast<size_t>(height) * 4u);
-
-        const uint32_t* src = static_cast<uint32_t*>(capture.buffer.data);
-        for (int y = 0; y < height; ++y) {
-            int srcY = capture.yInvert ? (height - 1 - y) : y;
-            const uint32_t* row = reinterpret_cast<const uint32_t*>(
-                reinterpret_cast<const uint8_t*>(src) +
-                static_cast<size_t>(capture.stride) * srcY);
-            for (int x = 0; x < width; ++x) {
-                uint32_t pixel = row[x];
-                uint8_t a = (capture.format == WL_SHM_FORMAT_XRGB8888)
-                                ? 255
-                                : ((pixel >> 24) & 0xFF);
-                uint8_t r = (pixel >> 16) & 0xFF;
-                uint8_t g = (pixel >> 8) & 0xFF;
-                uint8_t b = (pixel >> 0) & 0xFF;
-                size_t idx = (static_cast<size_t>(y) *
-                                  static_cast<size_t>(width) +
-                              static_cast<size_t>(x)) *
-                             4u;
-                out.rgba[idx + 0] = r;
-                out.rgba[idx + 1] = g;
-                out.rgba[idx + 2] = b;
-                out.rgba[idx + 3] = a;
+    // Fill only what no output covers
+    const uint8_t kBlack[4] = {0, 0, 0, 255};
+    uint32_t black;
+    std::memcpy(&black, kBlack, sizeof(black));
+    std::vector<std::pair<int, int>> spans;
+    for (int y = 0; y < totalH; ++y) {
+        spans.clear();
+        for (const Placement& placement : placements) {
+            if (y >= placement.y && y < placement.y + placement.h) {
+                spans.emplace_back(placement.x, placement.x + placement.w);
             }
         }
-        ok = true;
+        std::sort(spans.begin(), spans.end());
+        auto* row = reinterpret_cast<uint32_t*>(out.rgba.data() + stride * y);
+        int x = 0;
+        for (const auto& span : spans) {
+            if (span.first > x) {
+                fillPixels(row + x, static_cast<size_t>(span.first - x),
+                           black);
+            }
+            x = std::max(x, span.second);
+        }
+        if (x < totalW) {
+            fillPixels(row + x, static_cast<size_t>(totalW - x), black);
+        }
     }
 
-    if (capture.buffer.buffer) {
-        wl_buffer_destroy(capture.buffer.buffer);
-    }
-    if (capture.buffer.data) {
-        munmap(capture.buffer.data, capture.buffer.size);
-    }
-    if (capture.frame) {
-        zwlr_screencopy_frame_v1_destroy(capture.frame);
-    }
-    return ok;
+    // One task per output. Where outputs overlap (mirrored outputs) a task
+    // waits for those listed before it, so the last one still ends on top.
+    ThreadPool& pool = threadPool();
+    std::vector<TaskHandle> tasks;
+    for (size_t i = 0; i < placements.size(); ++i) {
+        const Placement& p = placements[i];
+        std::vector<TaskHandle> after;
+        for (size_t j = 0; j < i; ++j) {
+            const Placement& q = placements[j];
+            if (p.x < q.x + q.w && q.x < p.x + p.w && p.y < q.y + q.h &&
+                q.y < p.y + p.h) {
+                after.push_back(tasks[j]);
+            }
+        }
+        uint8_t* dst = out.rgba.data() + stride * p.y +
+                       static_cast<size_t>(p.x) * 4u;
+        tasks.push_back(pool.submit(
+            [&captures, p, dst, stride] {
+                drawFrame(captures[p.capture], dst, stride, p.w, p.h);
+            },
+            after));
+    }
+    for (const TaskHandle& task : tasks) {
+        pool.wait(task);
+    }
+    ctx.decodeSeconds += nowSeconds() - stitchStart;
+    return true;
 }
 
 }  // namespace
 
 class WlrScreencopyBackend final : public ICaptureBackend {
 public:
+    explicit WlrScreencopyBackend(DisplayConnection& connection)
+        : connection_(connection) {}
+
     std::string name() const override {
         return "wlr-screencopy";
     }
@@ -485,33 +487,29 @@ public:
         if (!std::getenv("WAYLAND_DISPLAY")) {
             return false;
         }
-        WlrContext ctx;
-        if (!initContext(ctx)) {
-            return false;
-        }
-        bool ok = ctx.manager != nullptr;
-        cleanupContext(ctx);
-        return ok;
+        return connection_.wayland() &&
+               connection_.waylandGlobal(
+                   zwlr_screencopy_manager_v1_interface.name);
     }
 
     std::vector<MonitorInfo> listMonitors() override {
         std::vector<MonitorInfo> result;
-        WlrContext ctx;
-        if (!initContext(ctx)) {
+        if (!connection_.wayland()) {
+            LOG_ERROR("wlr: failed to connect to Wayland display");
             return result;
         }
-        for (auto& output : ctx.outputs) {
+        for (const auto& output : connection_.waylandOutputs()) {
             result.push_back(output->info);
         }
-        cleanupContext(ctx);
         return result;
     }
 
     CaptureResult captureOnce(
         std::optional<std::string> monitorNameHint) override {
+        TRACE_ZONE("wlr capture");
         CaptureResult result;
         WlrContext ctx;
-        if (!initContext(ctx)) {
+        if (!initContext(connection_, ctx)) {
             return result;
         }
         if (!ctx.manager || !ctx.shm) {
@@ -519,171 +517,85 @@ public:
             cleanupContext(ctx);
             return result;
         }
-        result.monitors.reserve(ctx.outputs.size());
-        for (auto& output : ctx.outputs) {
+        const auto& outputs = connection_.waylandOutputs();
+        result.monitors.reserve(outputs.size());
+        for (auto& output : outputs) {
             result.monitors.push_back(output->info);
         }
 
         int selected = -1;
         bool captureAll = monitorNameHint && (*monitorNameHint == "all");
         if (monitorNameHint && !captureAll) {
-            for (size_t i = 0; i < ctx.outputs.size(); ++i) {
-                if (ctx.outputs[i]->info.name == *monitorNameHint) {
+            for (size_t i = 0; i < outputs.size(); ++i) {
+                if (outputs[i]->info.name == *monitorNameHint) {
                     selected = static_cast<int>(i);
                     break;
                 }
             }
         }
-        if (selected < 0 && !ctx.outputs.empty()) {
+        if (selected < 0 && !outputs.empty()) {
             selected = 0;
         }
         result.selectedMonitorIndex = selected;
 
         if (captureAll) {
-            if (ctx.outputs.empty()) {
+            if (outputs.empty()) {
                 LOG_ERROR("wlr: no outputs available for capture");
                 cleanupContext(ctx);
                 return result;
             }
-            if (ctx.outputs.size() == 1) {
-                if (!captureOutputImage(ctx, ctx.outputs[0]->output,
+            if (outputs.size() == 1) {
+                if (!captureOutputImage(ctx, outputs[0]->output,
                                         result.image)) {
                     LOG_ERROR("wlr: capture failed");
                 }
+                result.grabSeconds = ctx.grabSeconds;
+                result.decodeSeconds = ctx.decodeSeconds;
                 cleanupContext(ctx);
                 return result;
             }
 
-            std::vector<ImageRGBA> images;
-            images.resize(ctx.outputs.size());
-            for (size_t i = 0; i < ctx.outputs.size(); ++i) {
-                if (!captureOutputImage(ctx, ctx.outputs[i]->output,
-                                        images[i])) {
-                    LOG_ERROR("wlr: capture failed for output %s",
-                              ctx.outputs[i]->info.name.c_str());
-                }
+            std::vector<FrameCapture> captures(outputs.size());
+            for (size_t i = 0; i < outputs.size(); ++i) {
+                startFrameCapture(ctx, outputs[i]->output, captures[i]);
             }
-
-            bool hasBounds = false;
-            int minX = 0;
-            int minY = 0;
-            int maxX = 0;
-            int maxY = 0;
-            std::vector<int> targetW(ctx.outputs.size(), 0);
-            std::vector<int> targetH(ctx.outputs.size(), 0);
-            for (size_t i = 0; i < result.monitors.size(); ++i) {
-                int w = result.monitors[i].w;
-                int h = result.monitors[i].h;
-                if ((w <= 0 || h <= 0) && i < images.size()) {
-                    w = images[i].w;
-                    h = images[i].h;
-                }
-                if (result.monitors[i].w <= 0) {
-                    result.monitors[i].w = w;
-                }
-                if (result.monitors[i].h <= 0) {
-                    result.monitors[i].h = h;
-                }
-                targetW[i] = w;
-                targetH[i] = h;
-                if (w <= 0 || h <= 0) {
-                    continue;
-                }
-                int left = result.monitors[i].x;
-                int top = result.monitors[i].y;
-                int right = left + w;
-                int bottom = top + h;
-                if (!hasBounds) {
-                    minX = left;
-                    minY = top;
-                    maxX = right;
-                    maxY = bottom;
-                    hasBounds = true;
-                } else {
-                    minX = std::min(minX, left);
-                    minY = std::min(minY, top);
-                    maxX = std::max(maxX, right);
-                    maxY = std::max(maxY, bottom);
+            waitFrameCaptures(ctx, captures);
+            for (size_t i = 0; i < captures.size(); ++i) {
+                if (!frameUsable(captures[i])) {
+                    LOG_ERROR("wlr: capture failed for output %s",
+                              outputs[i]->info.name.c_str());
                 }
             }
-
-            if (hasBounds && maxX > minX && maxY > minY) {
-                int totalW = maxX - minX;
-                int totalH = maxY - minY;
-                result.image.w = totalW;
-                result.image.h = totalH;
-                result.image.rgba.assign(
-                    static_cast<size_t>(totalW) * static_cast<size_t>(totalH) *
-                        4u,
-                    0);
-                for (size_t i = 3; i < result.image.rgba.size(); i += 4u) {
-                    result.image.rgba[i] = 255;
-                }
-
-                for (size_t i = 0; i < images.size(); ++i) {
-                    if (images[i].rgba.empty()) {
-                        continue;
-                    }
-                    int w = targetW[i];
-                    int h = targetH[i];
-                    if (w <= 0 || h <= 0) {
-                        continue;
-                    }
-                    ImageRGBA scaled;
-                    const ImageRGBA* src = &images[i];
-                    if (images[i].w != w || images[i].h != h) {
-                        scaled = scaleImageBilinear(images[i], w, h);
-                        src = &scaled;
-                    }
-
-                    int offsetX = result.monitors[i].x - minX;
-                    int offsetY = result.monitors[i].y - minY;
-                    if (offsetX < 0 || offsetY < 0) {
-                        continue;
-                    }
-                    int copyW = std::min(w, totalW - offsetX);
-                    int copyH = std::min(h, totalH - offsetY);
-                    if (copyW <= 0 || copyH <= 0) {
-                        continue;
-                    }
-
-                    for (int y = 0; y < copyH; ++y) {
-                        size_t dstIdx =
-                            (static_cast<size_t>(offsetY + y) *
-                                 static_cast<size_t>(totalW) +
-                             static_cast<size_t>(offsetX)) *
-                            4u;
-                        size_t srcIdx =
-                            (static_cast<size_t>(y) * static_cast<size_t>(w)) *
-                            4u;
-                        std::memcpy(&result.image.rgba[dstIdx],
-                                    &src->rgba[srcIdx],
-                                    static_cast<size_t>(copyW) * 4u);
-                    }
-                }
-            } else {
-                LOG_ERROR("wlr: failed to compute output bounds");
+            stitchOutputs(ctx, captures, result.monitors, result.image);
+            for (FrameCapture& capture : captures) {
+                finishFrameCapture(capture);
             }
         } else {
             if (selected < 0 ||
-                selected >= static_cast<int>(ctx.outputs.size())) {
+                selected >= static_cast<int>(outputs.size())) {
                 LOG_ERROR("wlr: no output selected for capture");
                 cleanupContext(ctx);
                 return result;
             }
 
-            if (!captureOutputImage(ctx, ctx.outputs[selected]->output,
+            if (!captureOutputImage(ctx, outputs[selected]->output,
                                     result.image)) {
                 LOG_ERROR("wlr: capture failed");
             }
         }
+        result.grabSeconds = ctx.grabSeconds;
+        result.decodeSeconds = ctx.decodeSeconds;
         cleanupContext(ctx);
         return result;
     }
+
+private:
+    DisplayConnection& connection_;
 };
 
-std::unique_ptr<ICaptureBackend> CreateBackendWlrScreencopy() {
-    return std::make_unique<WlrScreencopyBackend>();
+std::unique_ptr<ICaptureBackend> CreateBackendWlrScreencopy(
+    DisplayConnection& connection) {
+    return std::make_unique<WlrScreencopyBackend>(connection);
 }
 
 }  // namespace coomer
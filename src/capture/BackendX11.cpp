@@ -10,12 +10,27 @@
 #include <memory>
 #include <optional>
 
+#include "platform/DisplayConnection.hpp"
 #include "platform/Log.hpp"
+#include "platform/ThreadPool.hpp"
+#include "platform/Time.hpp"
+#include "platform/Trace.hpp"
 
 namespace coomer {
 
+namespace {
+
+// Rows go to the thread pool in ranges of at least this many pixels;
+// XGetPixel is slow enough per pixel that small ranges pay off.
+constexpr int kMinPixelsPerRange = 64 * 1024;
+
+}  // namespace
+
 class X11CaptureBackend final : public ICaptureBackend {
 public:
+    explicit X11CaptureBackend(DisplayConnection& connection)
+        : connection_(connection) {}
+
     std::string name() const override {
         return "x11";
     }
@@ -25,17 +40,12 @@ public:
         if (!displayEnv) {
             return false;
         }
-        Display* display = XOpenDisplay(nullptr);
-        if (!display) {
-            return false;
-        }
-        XCloseDisplay(display);
-        return true;
+        return connection_.x11() != nullptr;
     }
 
     std::vector<MonitorInfo> listMonitors() override {
         std::vector<MonitorInfo> result;
-        Display* display = XOpenDisplay(nullptr);
+        Display* display = connection_.x11();
         if (!display) {
             LOG_ERROR("X11: failed to open display for monitor list");
             return result;
@@ -45,7 +55,6 @@ public:
         XRRScreenResources* resources =
             XRRGetScreenResourcesCurrent(display, root);
         if (!resources) {
-            XCloseDisplay(display);
             LOG_ERROR("X11: failed to get screen resources");
             return result;
         }
@@ -78,14 +87,14 @@ public:
         }
 
         XRRFreeScreenResources(resources);
-        XCloseDisplay(display);
         return result;
     }
 
     CaptureResult captureOnce(
         std::optional<std::string> monitorNameHint) override {
+        TRACE_ZONE("x11 capture");
         CaptureResult result;
-        Display* display = XOpenDisplay(nullptr);
+        Display* display = connection_.x11();
         if (!display) {
             LOG_ERROR("X11: failed to open display for capture");
             return result;
@@ -96,7 +105,6 @@ public:
             XRRGetScreenResourcesCurrent(display, root);
         if (!resources) {
             LOG_ERROR("X11: failed to get screen resources");
-            XCloseDisplay(display);
             return result;
         }
 
@@ -130,21 +138,31 @@ public:
             h = monitors[chosen].h;
         }
 
-        XImage* image =
-            XGetImage(display, root, x, y, static_cast<unsigned int>(w),
-                      static_cast<unsigned int>(h), AllPlanes, ZPixmap);
+        XImage* image = nullptr;
+        double grabStart = nowSeconds();
+        {
+            TRACE_ZONE("x11 XGetImage");
+            image = XGetImage(display, root, x, y, static_cast<unsigned int>(w),
+                              static_cast<unsigned int>(h), AllPlanes, ZPixmap);
+        }
+        result.grabSeconds = nowSeconds() - grabStart;
         if (!image) {
             LOG_ERROR("X11: XGetImage failed (permissions or remote session?)");
             XRRFreeScreenResources(resources);
-            XCloseDisplay(display);
             return result;
         }
 
+        if (!result.image.rgba.allocate(static_cast<size_t>(w) *
+                                        static_cast<size_t>(h) * 4u)) {
+            XDestroyImage(image);
+            XRRFreeScreenResources(resources);
+            return result;
+        }
         result.image.w = w;
         result.image.h = h;
-        result.image.rgba.resize(static_cast<size_t>(w) *
-                                 static_cast<size_t>(h) * 4u);
 
+        TRACE_ZONE("x11 convert");
+        double decodeStart = nowSeconds();
         const unsigned long rmask = image->red_mask;
         const unsigned long gmask = image->green_mask;
         const unsigned long bmask = image->blue_mask;
@@ -155,31 +173,32 @@ public:
         const unsigned long gmax = gmask >> gshift;
         const unsigned long bmax = bmask >> bshift;
 
-        for (int iy = 0; iy < h; ++iy) {
-            for (int ix = 0; ix < w; ++ix) {
-                unsigned long pixel = XGetPixel(image, ix, iy);
-                unsigned long r = (pixel & rmask) >> rshift;
-                unsigned long g = (pixel & gmask) >> gshift;
-                unsigned long b = (pixel & bmask) >> bshift;
-                std::uint8_t rr =
-                    static_cast<std::uint8_t>(rmax ? (r * 255ul / rmax) : 0);
-                std::uint8_t gg =
-                    static_cast<std::uint8_t>(gmax ? (g * 255ul / gmax) : 0);
-                std::uint8_t bb =
-                    static_cast<std::uint8_t>(bmax ? (b * 255ul / bmax) : 0);
-                size_t idx = (static_cast<size_t>(iy) * static_cast<size_t>(w) +
-                              static_cast<size_t>(ix)) *
-                             4u;
-                result.image.rgba[idx + 0] = rr;
-                result.image.rgba[idx + 1] = gg;
-                result.image.rgba[idx + 2] = bb;
-                result.image.rgba[idx + 3] = 255;
+        // XGetPixel only reads the image, so rows convert in parallel
+        auto convertRows = [&](int begin, int end) {
+            for (int iy = begin; iy < end; ++iy) {
+                std::uint8_t* out =
+                    result.image.rgba.data() + static_cast<size_t>(iy) * w * 4u;
+                for (int ix = 0; ix < w; ++ix) {
+                    unsigned long pixel = XGetPixel(image, ix, iy);
+                    unsigned long r = (pixel & rmask) >> rshift;
+                    unsigned long g = (pixel & gmask) >> gshift;
+                    unsigned long b = (pixel & bmask) >> bshift;
+                    out[ix * 4 + 0] = static_cast<std::uint8_t>(
+                        rmax ? (r * 255ul / rmax) : 0);
+                    out[ix * 4 + 1] = static_cast<std::uint8_t>(
+                        gmax ? (g * 255ul / gmax) : 0);
+                    out[ix * 4 + 2] = static_cast<std::uint8_t>(
+                        bmax ? (b * 255ul / bmax) : 0);
+                    out[ix * 4 + 3] = 255;
+                }
             }
-        }
+        };
+        threadPool().parallelFor(0, h, std::max(kMinPixelsPerRange / w, 1),
+                                 convertRows);
 
         XDestroyImage(image);
         XRRFreeScreenResources(resources);
-        XCloseDisplay(display);
+        result.decodeSeconds = nowSeconds() - decodeStart;
         return result;
     }
 
@@ -217,10 +236,13 @@ private:
         }
         return result;
     }
+
+    DisplayConnection& connection_;
 };
 
-std::unique_ptr<ICaptureBackend> CreateBackendX11() {
-    return std::make_unique<X11CaptureBackend>();
+std::unique_ptr<ICaptureBackend> CreateBackendX11(
+    DisplayConnection& connection) {
+    return std::make_unique<X11CaptureBackend>(connection);
 }
 
 }  // namespace coomer
@@ -3,9 +3,11 @@
 #include <memory>
 
 #include "capture/ICaptureBackend.hpp"
+#include "platform/DisplayConnection.hpp"
 
 namespace coomer {
 
-std::unique_ptr<ICaptureBackend> CreateBackendX11();
+std::unique_ptr<ICaptureBackend> CreateBackendX11(
+    DisplayConnection& connection);
 
 }  // namespace coomer
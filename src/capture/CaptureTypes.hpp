@@ -1,15 +1,104 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace coomer {
 
+// Pixel storage for captured frames. Unlike a std::vector, allocate()
+// leaves the bytes uninitialized, so callers must write every byte they
+// later read. Blocks are 64-byte aligned; large ones are mapped with
+// transparent huge pages requested. Released blocks go back to a small
+// process-wide pool and are handed out again to later allocations of a
+// similar size, already faulted in.
+class ImageBuffer {
+public:
+    static constexpr size_t kAlignment = 64;
+
+    ImageBuffer() = default;
+    ~ImageBuffer() {
+        release();
+    }
+    ImageBuffer(ImageBuffer&& other) noexcept
+        : data_(other.data_), size_(other.size_), capacity_(other.capacity_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+        other.capacity_ = 0;
+    }
+    ImageBuffer& operator=(ImageBuffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+            std::swap(capacity_, other.capacity_);
+        }
+        return *this;
+    }
+    ImageBuffer(const ImageBuffer&) = delete;
+    ImageBuffer& operator=(const ImageBuffer&) = delete;
+
+    // Resizes to size bytes with unspecified contents, keeping the current
+    // block when it is large enough. Returns false, leaving the buffer
+    // empty, when memory is exhausted.
+    bool allocate(size_t size);
+    // Returns the block to the pool; the buffer is empty afterwards.
+    void release();
+
+    std::uint8_t* data() {
+        return data_;
+    }
+    const std::uint8_t* data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+    size_t capacity() const {
+        return capacity_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+    std::uint8_t& operator[](size_t i) {
+        return data_[i];
+    }
+    const std::uint8_t& operator[](size_t i) const {
+        return data_[i];
+    }
+
+private:
+    std::uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+};
+
+// Frees the blocks kept for reuse, once no further captures are expected.
+void trimImageBufferPool();
+
 struct ImageRGBA {
     int w = 0;
     int h = 0;
-    std::vector<std::uint8_t> rgba;
+    ImageBuffer rgba;
+};
+
+// Frees the pixels of an image whose contents now live elsewhere (in a
+// texture or a renderer's own copy); the size is kept. Returns the bytes
+// given back.
+inline size_t releasePixels(ImageRGBA& image) {
+    size_t bytes = image.rgba.capacity();
+    image.rgba.release();
+    return bytes;
+}
+
+// Rectangle in image pixels, origin at the top-left like ImageRGBA rows.
+struct ImageRect {
+    int x = 0;
+    int y = 0;
+    int w = 0;
+    int h = 0;
 };
 
 struct MonitorInfo {
@@ -26,6 +115,11 @@ struct CaptureResult {
     ImageRGBA image;
     std::vector<MonitorInfo> monitors;
     int selectedMonitorIndex = -1;
+    // Seconds spent waiting for the display server or portal to hand over
+    // the pixels, and turning them into RGBA (conversion, decoding and
+    // stitching).
+    double grabSeconds = 0.0;
+    double decodeSeconds = 0.0;
 };
 
 }  // namespace coomer
@@ -0,0 +1,157 @@
+#include <sys/mman.h>
+
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#include "capture/CaptureTypes.hpp"
+#include "platform/Log.hpp"
+
+namespace coomer {
+
+namespace {
+
+// Blocks this large are mapped on their own and asked to use huge pages;
+// the threshold is the x86-64 huge page size.
+constexpr size_t kHugePageSize = size_t{2} << 20;
+// Upper bound on the bytes kept in the pool.
+constexpr size_t kPoolLimit = size_t{512} << 20;
+
+struct Block {
+    std::uint8_t* data;
+    size_t capacity;
+};
+
+std::mutex g_pool_mutex;
+std::vector<Block> g_pool;
+size_t g_pool_bytes = 0;
+
+size_t roundUp(size_t size, size_t multiple) {
+    return (size + multiple - 1) / multiple * multiple;
+}
+
+size_t blockCapacity(size_t size) {
+    return size >= kHugePageSize ? roundUp(size, kHugePageSize)
+                                 : roundUp(size, ImageBuffer::kAlignment);
+}
+
+std::uint8_t* mapBlock(size_t capacity) {
+    // Over-map by one huge page so the block can start on a huge page
+    // boundary, then give the slack back.
+    size_t mapped = capacity + kHugePageSize;
+    void* base = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+    auto start = reinterpret_cast<uintptr_t>(base);
+    uintptr_t aligned = roundUp(start, kHugePageSize);
+    if (aligned > start) {
+        munmap(base, aligned - start);
+    }
+    size_t tail = start + mapped - (aligned + capacity);
+    if (tail > 0) {
+        munmap(reinterpret_cast<void*>(aligned + capacity), tail);
+    }
+    auto* data = reinterpret_cast<std::uint8_t*>(aligned);
+#if defined(MADV_HUGEPAGE)
+    madvise(data, capacity, MADV_HUGEPAGE);
+#endif
+    return data;
+}
+
+std::uint8_t* allocateBlock(size_t capacity) {
+    if (capacity >= kHugePageSize) {
+        return mapBlock(capacity);
+    }
+    return static_cast<std::uint8_t*>(
+        std::aligned_alloc(ImageBuffer::kAlignment, capacity));
+}
+
+void freeBlock(const Block& block) {
+    if (block.capacity >= kHugePageSize) {
+        munmap(block.data, block.capacity);
+    } else {
+        std::free(block.data);
+    }
+}
+
+// Takes the smallest pooled block that fits without wasting more than
+// half of it.
+bool takePooled(size_t capacity, Block& out) {
+    std::lock_guard<std::mutex> lock(g_pool_mutex);
+    size_t best = g_pool.size();
+    for (size_t i = 0; i < g_pool.size(); ++i) {
+        size_t c = g_pool[i].capacity;
+        if (c >= capacity && c / 2 <= capacity &&
+            (best == g_pool.size() || c < g_pool[best].capacity)) {
+            best = i;
+        }
+    }
+    if (best == g_pool.size()) {
+        return false;
+    }
+    out = g_pool[best];
+    g_pool[best] = g_pool.back();
+    g_pool.pop_back();
+    g_pool_bytes -= out.capacity;
+    return true;
+}
+
+}  // namespace
+
+bool ImageBuffer::allocate(size_t size) {
+    if (size <= capacity_) {
+        size_ = size;
+        return true;
+    }
+    release();
+    if (size == 0) {
+        return true;
+    }
+    Block block{nullptr, blockCapacity(size)};
+    if (!takePooled(block.capacity, block)) {
+        block.data = allocateBlock(block.capacity);
+        if (!block.data) {
+            LOG_ERROR("out of memory allocating %zu byte image", size);
+            return false;
+        }
+    }
+    data_ = block.data;
+    size_ = size;
+    capacity_ = block.capacity;
+    return true;
+}
+
+void ImageBuffer::release() {
+    if (!data_) {
+        return;
+    }
+    Block block{data_, capacity_};
+    data_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_pool_mutex);
+        if (g_pool_bytes + block.capacity <= kPoolLimit) {
+            g_pool.push_back(block);
+            g_pool_bytes += block.capacity;
+            return;
+        }
+    }
+    freeBlock(block);
+}
+
+void trimImageBufferPool() {
+    std::vector<Block> blocks;
+    {
+        std::lock_guard<std::mutex> lock(g_pool_mutex);
+        blocks.swap(g_pool);
+        g_pool_bytes = 0;
+    }
+    for (const Block& block : blocks) {
+        freeBlock(block);
+    }
+}
+
+}  // namespace coomer
@@ -0,0 +1,180 @@
+#include "capture/ImageDiff.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "platform/ThreadPool.hpp"
+
+namespace coomer {
+
+namespace {
+
+// Tile rows go to the thread pool in ranges of at least this many pixels.
+constexpr long long kMinPixelsPerRange = 256 * 1024;
+
+bool spansEqual(const std::uint8_t* a, const std::uint8_t* b, size_t bytes) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 64 <= bytes; i += 64) {
+        __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i a1 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16));
+        __m128i a2 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 32));
+        __m128i a3 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 48));
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i b1 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16));
+        __m128i b2 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 32));
+        __m128i b3 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 48));
+        __m128i eq = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(a0, b0), _mm_cmpeq_epi8(a1, b1)),
+            _mm_and_si128(_mm_cmpeq_epi8(a2, b2), _mm_cmpeq_epi8(a3, b3)));
+        if (_mm_movemask_epi8(eq) != 0xFFFF) {
+            return false;
+        }
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 32 <= bytes; i += 32) {
+        uint8x16_t eq0 = vceqq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        uint8x16_t eq1 = vceqq_u8(vld1q_u8(a + i + 16), vld1q_u8(b + i + 16));
+        uint8x16_t eq = vandq_u8(eq0, eq1);
+        uint64x2_t lanes = vreinterpretq_u64_u8(eq);
+        if ((vgetq_lane_u64(lanes, 0) & vgetq_lane_u64(lanes, 1)) !=
+            ~0ull) {
+            return false;
+        }
+    }
+#endif
+    return std::memcmp(a + i, b + i, bytes - i) == 0;
+}
+
+bool tileEqual(const std::uint8_t* prev, int prevStride,
+               const std::uint8_t* next, int nextStride, int x, int y, int w,
+               int h) {
+    size_t offsetX = static_cast<size_t>(x) * 4u;
+    size_t bytes = static_cast<size_t>(w) * 4u;
+    for (int row = y; row < y + h; ++row) {
+        const std::uint8_t* a =
+            prev + static_cast<size_t>(row) * prevStride + offsetX;
+        const std::uint8_t* b =
+            next + static_cast<size_t>(row) * nextStride + offsetX;
+        if (!spansEqual(a, b, bytes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+long long rectArea(const ImageRect& r) {
+    return static_cast<long long>(r.w) * static_cast<long long>(r.h);
+}
+
+ImageRect unionRect(const ImageRect& a, const ImageRect& b) {
+    int x0 = std::min(a.x, b.x);
+    int y0 = std::min(a.y, b.y);
+    int x1 = std::max(a.x + a.w, b.x + b.w);
+    int y1 = std::max(a.y + a.h, b.y + b.h);
+    return ImageRect{x0, y0, x1 - x0, y1 - y0};
+}
+
+long long overlapArea(const ImageRect& a, const ImageRect& b) {
+    int x0 = std::max(a.x, b.x);
+    int y0 = std::max(a.y, b.y);
+    int x1 = std::min(a.x + a.w, b.x + b.w);
+    int y1 = std::min(a.y + a.h, b.y + b.h);
+    if (x1 <= x0 || y1 <= y0) {
+        return 0;
+    }
+    return static_cast<long long>(x1 - x0) * static_cast<long long>(y1 - y0);
+}
+
+}  // namespace
+
+std::vector<ImageRect> coalesceRects(std::vector<ImageRect> rects) {
+    rects.erase(std::remove_if(rects.begin(), rects.end(),
+                               [](const ImageRect& r) {
+                                   return r.w <= 0 || r.h <= 0;
+                               }),
+                rects.end());
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < rects.size() && !merged; ++i) {
+            for (size_t j = i + 1; j < rects.size(); ++j) {
+                ImageRect u = unionRect(rects[i], rects[j]);
+                // Only merge when the union adds no pixels that were not
+                // already part of one of the two rects.
+                if (rectArea(u) <= rectArea(rects[i]) + rectArea(rects[j]) -
+                                       overlapArea(rects[i], rects[j])) {
+                    rects[i] = u;
+                    rects.erase(rects.begin() + static_cast<long>(j));
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+    return rects;
+}
+
+std::vector<ImageRect> diffImageTiles(const std::uint8_t* prev,
+                                      int prevStride,
+                                      const std::uint8_t* next,
+                                      int nextStride, int width, int height,
+                                      int tileSize) {
+    std::vector<ImageRect> dirty;
+    if (!prev || !next || width <= 0 || height <= 0 || tileSize <= 0) {
+        return dirty;
+    }
+    // Rows of tiles are compared in parallel, each into its own list
+    int tileRows = (height + tileSize - 1) / tileSize;
+    std::vector<std::vector<ImageRect>> rowRuns(tileRows);
+    long long rowPixels = static_cast<long long>(tileSize) * width;
+    int grain = static_cast<int>(
+        std::max<long long>(kMinPixelsPerRange / rowPixels, 1));
+    threadPool().parallelFor(0, tileRows, grain, [&](int begin, int end) {
+        for (int row = begin; row < end; ++row) {
+            int ty = row * tileSize;
+            int th = std::min(tileSize, height - ty);
+            std::vector<ImageRect>& runs = rowRuns[row];
+            // Extend runs of dirty tiles along the row so coalescing has
+            // less to do.
+            ImageRect run;
+            for (int tx = 0; tx < width; tx += tileSize) {
+                int tw = std::min(tileSize, width - tx);
+                if (tileEqual(prev, prevStride, next, nextStride, tx, ty, tw,
+                              th)) {
+                    if (run.w > 0) {
+                        runs.push_back(run);
+                        run = ImageRect{};
+                    }
+                    continue;
+                }
+                if (run.w > 0) {
+                    run.w += tw;
+                } else {
+                    run = ImageRect{tx, ty, tw, th};
+                }
+            }
+            if (run.w > 0) {
+                runs.push_back(run);
+            }
+        }
+    });
+    for (const auto& runs : rowRuns) {
+        dirty.insert(dirty.end(), runs.begin(), runs.end());
+    }
+    return coalesceRects(std::move(dirty));
+}
+
+}  // namespace coomer
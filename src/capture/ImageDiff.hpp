@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "capture/CaptureTypes.hpp"
+
+namespace coomer {
+
+// Compares two RGBA frames of the same size tile by tile and returns the
+// tiles that differ, already coalesced. Used when a backend cannot report
+// damage itself. Strides are in bytes.
+std::vector<ImageRect> diffImageTiles(const std::uint8_t* prev,
+                                      int prevStride,
+                                      const std::uint8_t* next,
+                                      int nextStride, int width, int height,
+                                      int tileSize = 64);
+
+// Merges rectangles whose union covers no extra pixels (adjacent strips with
+// a matching edge, or overlapping/contained rects) to cut per-rect upload
+// calls.
+std::vector<ImageRect> coalesceRects(std::vector<ImageRect> rects);
+
+}  // namespace coomer
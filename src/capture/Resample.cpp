@@ -0,0 +1,369 @@
+#include "capture/Resample.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "platform/ThreadPool.hpp"
+#include "platform/Trace.hpp"
+
+namespace coomer {
+
+namespace {
+
+// Weights are Q14 fixed point: large enough for smooth gradients, small
+// enough that a sum of products of bytes stays well inside 32 bits.
+constexpr int kWeightBits = 14;
+constexpr int kWeightOne = 1 << kWeightBits;
+constexpr int kRound = 1 << (kWeightBits - 1);
+// Destination rows go to the pool in ranges of at least this many pixels.
+constexpr long long kMinPixelsPerRange = 256 * 1024;
+
+// Source taps of every destination pixel along one axis.
+struct Kernel {
+    int maxTaps = 0;
+    std::vector<int> first;
+    std::vector<int> count;
+    // maxTaps per destination pixel, summing to kWeightOne.
+    std::vector<std::int16_t> weights;
+
+    const std::int16_t* weightsAt(int i) const {
+        return weights.data() + static_cast<size_t>(i) * maxTaps;
+    }
+};
+
+double cubic(double x) {
+    // Catmull-Rom: interpolating, so an unscaled axis passes through as is
+    x = std::fabs(x);
+    if (x < 1.0) {
+        return (1.5 * x - 2.5) * x * x + 1.0;
+    }
+    if (x < 2.0) {
+        return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+    }
+    return 0.0;
+}
+
+Kernel buildKernel(int srcSize, int dstSize, ResampleFilter filter) {
+    const double scale =
+        static_cast<double>(srcSize) / static_cast<double>(dstSize);
+    if (filter == ResampleFilter::Auto) {
+        filter = scale > 1.0 ? ResampleFilter::Area : ResampleFilter::Bicubic;
+    }
+    // Interpolating filters are widened when shrinking so every source
+    // pixel still contributes.
+    const double widen = std::max(scale, 1.0);
+    double radius = 0.5 * scale;
+    if (filter == ResampleFilter::Bilinear) {
+        radius = widen;
+    } else if (filter == ResampleFilter::Bicubic) {
+        radius = 2.0 * widen;
+    }
+
+    Kernel kernel;
+    kernel.maxTaps = static_cast<int>(std::ceil(radius)) * 2 + 2;
+    kernel.first.resize(dstSize);
+    kernel.count.resize(dstSize);
+    kernel.weights.assign(static_cast<size_t>(dstSize) * kernel.maxTaps, 0);
+    std::vector<double> taps(kernel.maxTaps);
+    for (int i = 0; i < dstSize; ++i) {
+        const double center = (i + 0.5) * scale;
+        int lo = std::max(static_cast<int>(std::floor(center - radius)), 0);
+        int hi = std::min(static_cast<int>(std::ceil(center + radius)),
+                          srcSize);
+        hi = std::min(hi, lo + kernel.maxTaps);
+        double sum = 0.0;
+        for (int j = lo; j < hi; ++j) {
+            double w = 0.0;
+            if (filter == ResampleFilter::Area) {
+                // Coverage of source pixel j by the destination footprint
+                w = std::min(j + 1.0, center + radius) -
+                    std::max(static_cast<double>(j), center - radius);
+                w = std::max(w, 0.0);
+            } else {
+                double x = (j + 0.5 - center) / widen;
+                w = filter == ResampleFilter::Bilinear
+                        ? std::max(1.0 - std::fabs(x), 0.0)
+                        : cubic(x);
+            }
+            taps[j - lo] = w;
+            sum += w;
+        }
+        // Zero taps at either end cost time without changing anything
+        while (hi - lo > 1 && taps[0] == 0.0) {
+            std::copy(taps.begin() + 1, taps.begin() + (hi - lo),
+                      taps.begin());
+            ++lo;
+        }
+        while (hi - lo > 1 && taps[hi - lo - 1] == 0.0) {
+            --hi;
+        }
+        if (sum == 0.0) {
+            // Cannot happen for sane sizes; fall back to the nearest pixel
+            lo = std::min(static_cast<int>(center), srcSize - 1);
+            hi = lo + 1;
+            taps[0] = sum = 1.0;
+        }
+
+        // Quantize, then put the rounding error on the largest tap so flat
+        // areas come out exactly as they went in.
+        std::int16_t* weights = kernel.weights.data() +
+                                static_cast<size_t>(i) * kernel.maxTaps;
+        int total = 0;
+        int largest = 0;
+        for (int t = 0; t < hi - lo; ++t) {
+            int w = static_cast<int>(std::lround(taps[t] / sum * kWeightOne));
+            weights[t] = static_cast<std::int16_t>(w);
+            total += w;
+            if (taps[t] > taps[largest]) {
+                largest = t;
+            }
+        }
+        weights[largest] =
+            static_cast<std::int16_t>(weights[largest] + kWeightOne - total);
+        kernel.first[i] = lo;
+        kernel.count[i] = hi - lo;
+    }
+    return kernel;
+}
+
+inline std::uint8_t clampByte(int value) {
+    return static_cast<std::uint8_t>(std::clamp(value >> kWeightBits, 0, 255));
+}
+
+#if defined(__SSE2__)
+// Two Q14 weights interleaved for _mm_madd_epi16.
+inline __m128i weightPair(std::int16_t a, std::int16_t b) {
+    return _mm_set1_epi32(static_cast<int>(
+        static_cast<std::uint16_t>(a) |
+        (static_cast<std::uint32_t>(static_cast<std::uint16_t>(b)) << 16)));
+}
+#endif
+
+// Filters one source row into dstW pixels.
+void horizontalRow(const std::uint8_t* src, const Kernel& kernel, int dstW,
+                   std::uint8_t* dst) {
+    for (int x = 0; x < dstW; ++x) {
+        const std::uint8_t* in =
+            src + static_cast<size_t>(kernel.first[x]) * 4u;
+        const std::int16_t* weights = kernel.weightsAt(x);
+        const int count = kernel.count[x];
+        std::uint8_t* out = dst + static_cast<size_t>(x) * 4u;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_set1_epi32(kRound);
+        int t = 0;
+        for (; t + 2 <= count; t += 2) {
+            // Two pixels, widened and interleaved by channel
+            __m128i pixels = _mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + t * 4)),
+                zero);
+            __m128i pairs =
+                _mm_unpacklo_epi16(pixels, _mm_srli_si128(pixels, 8));
+            acc = _mm_add_epi32(
+                acc,
+                _mm_madd_epi16(pairs, weightPair(weights[t], weights[t + 1])));
+        }
+        if (t < count) {
+            int pixel;
+            std::memcpy(&pixel, in + t * 4, sizeof(pixel));
+            __m128i wide = _mm_unpacklo_epi16(
+                _mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero), zero);
+            acc = _mm_add_epi32(acc,
+                                _mm_madd_epi16(wide, weightPair(weights[t], 0)));
+        }
+        acc = _mm_srai_epi32(acc, kWeightBits);
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(acc, acc), zero);
+        int result = _mm_cvtsi128_si32(bytes);
+        std::memcpy(out, &result, sizeof(result));
+#elif defined(__ARM_NEON)
+        int32x4_t acc = vdupq_n_s32(kRound);
+        for (int t = 0; t < count; ++t) {
+            std::uint32_t pixel;
+            std::memcpy(&pixel, in + t * 4, sizeof(pixel));
+            int16x4_t wide = vget_low_s16(vreinterpretq_s16_u16(
+                vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(pixel)))));
+            acc = vmlal_n_s16(acc, wide, weights[t]);
+        }
+        int16x4_t narrow = vqshrn_n_s32(acc, kWeightBits);
+        uint8x8_t bytes = vqmovun_s16(vcombine_s16(narrow, narrow));
+        vst1_lane_u32(reinterpret_cast<std::uint32_t*>(out),
+                      vreinterpret_u32_u8(bytes), 0);
+#else
+        for (int c = 0; c < 4; ++c) {
+            int acc = kRound;
+            for (int t = 0; t < count; ++t) {
+                acc += in[t * 4 + c] * weights[t];
+            }
+            out[c] = clampByte(acc);
+        }
+#endif
+    }
+}
+
+// Blends count rows of bytes into one.
+void verticalRow(const std::uint8_t* const* rows, const std::int16_t* weights,
+                 int count, size_t bytes, std::uint8_t* dst) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i acc[4];
+        for (__m128i& a : acc) {
+            a = _mm_set1_epi32(kRound);
+        }
+        for (int t = 0; t < count; t += 2) {
+            __m128i a =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[t] + i));
+            __m128i b = zero;
+            std::int16_t wb = 0;
+            if (t + 1 < count) {
+                b = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(rows[t + 1] + i));
+                wb = weights[t + 1];
+            }
+            const __m128i w = weightPair(weights[t], wb);
+            const __m128i aLo = _mm_unpacklo_epi8(a, zero);
+            const __m128i aHi = _mm_unpackhi_epi8(a, zero);
+            const __m128i bLo = _mm_unpacklo_epi8(b, zero);
+            const __m128i bHi = _mm_unpackhi_epi8(b, zero);
+            acc[0] = _mm_add_epi32(
+                acc[0], _mm_madd_epi16(_mm_unpacklo_epi16(aLo, bLo), w));
+            acc[1] = _mm_add_epi32(
+                acc[1], _mm_madd_epi16(_mm_unpackhi_epi16(aLo, bLo), w));
+            acc[2] = _mm_add_epi32(
+                acc[2], _mm_madd_epi16(_mm_unpacklo_epi16(aHi, bHi), w));
+            acc[3] = _mm_add_epi32(
+                acc[3], _mm_madd_epi16(_mm_unpackhi_epi16(aHi, bHi), w));
+        }
+        for (__m128i& a : acc) {
+            a = _mm_srai_epi32(a, kWeightBits);
+        }
+        __m128i out =
+            _mm_packus_epi16(_mm_packs_epi32(acc[0], acc[1]),
+                             _mm_packs_epi32(acc[2], acc[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= bytes; i += 8) {
+        int32x4_t lo = vdupq_n_s32(kRound);
+        int32x4_t hi = vdupq_n_s32(kRound);
+        for (int t = 0; t < count; ++t) {
+            int16x8_t wide =
+                vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[t] + i)));
+            lo = vmlal_n_s16(lo, vget_low_s16(wide), weights[t]);
+            hi = vmlal_n_s16(hi, vget_high_s16(wide), weights[t]);
+        }
+        int16x8_t narrow = vcombine_s16(vqshrn_n_s32(lo, kWeightBits),
+                                        vqshrn_n_s32(hi, kWeightBits));
+        vst1_u8(dst + i, vqmovun_s16(narrow));
+    }
+#endif
+    for (; i < bytes; ++i) {
+        int acc = kRound;
+        for (int t = 0; t < count; ++t) {
+            acc += rows[t][i] * weights[t];
+        }
+        dst[i] = clampByte(acc);
+    }
+}
+
+struct ResampleJob {
+    const std::uint8_t* src;
+    std::ptrdiff_t srcStride;
+    std::uint8_t* dst;
+    std::ptrdiff_t dstStride;
+    int dstW;
+    // Empty along an axis that keeps its size.
+    const Kernel* kx;
+    const Kernel* ky;
+};
+
+// Destination rows [rowBegin, rowEnd): the source rows they need are
+// filtered horizontally into a band buffer, then blended vertically.
+void resampleRows(const ResampleJob& job, int rowBegin, int rowEnd) {
+    const std::ptrdiff_t dstStride = job.dstStride;
+    auto srcRow = [&job](int y) { return job.src + job.srcStride * y; };
+    if (!job.ky) {
+        for (int y = rowBegin; y < rowEnd; ++y) {
+            horizontalRow(srcRow(y), *job.kx, job.dstW,
+                          job.dst + dstStride * y);
+        }
+        return;
+    }
+
+    const Kernel& ky = *job.ky;
+    int first = ky.first[rowBegin];
+    int last = first;
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        last = std::max(last, ky.first[y] + ky.count[y]);
+    }
+    const size_t rowBytes = static_cast<size_t>(job.dstW) * 4u;
+    std::vector<std::uint8_t> band;
+    std::vector<const std::uint8_t*> rows(last - first);
+    if (job.kx) {
+        band.resize(rowBytes * (last - first));
+        for (int y = first; y < last; ++y) {
+            std::uint8_t* out = band.data() + rowBytes * (y - first);
+            horizontalRow(srcRow(y), *job.kx, job.dstW, out);
+            rows[y - first] = out;
+        }
+    } else {
+        for (int y = first; y < last; ++y) {
+            rows[y - first] = srcRow(y);
+        }
+    }
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        verticalRow(rows.data() + (ky.first[y] - first), ky.weightsAt(y),
+                    ky.count[y], rowBytes, job.dst + dstStride * y);
+    }
+}
+
+}  // namespace
+
+void resamplePixels(const std::uint8_t* src, std::ptrdiff_t srcStride,
+                    int srcW, int srcH, std::uint8_t* dst,
+                    std::ptrdiff_t dstStride, int dstW, int dstH,
+                    ResampleFilter filter) {
+    if (!src || !dst || srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0) {
+        return;
+    }
+    TRACE_ZONE("resample");
+    if (srcW == dstW && srcH == dstH) {
+        for (int y = 0; y < dstH; ++y) {
+            std::memcpy(dst + dstStride * y, src + srcStride * y,
+                        static_cast<size_t>(dstW) * 4u);
+        }
+        return;
+    }
+
+    Kernel kx;
+    Kernel ky;
+    if (srcW != dstW) {
+        kx = buildKernel(srcW, dstW, filter);
+    }
+    if (srcH != dstH) {
+        ky = buildKernel(srcH, dstH, filter);
+    }
+    ResampleJob job{src,
+                    srcStride,
+                    dst,
+                    dstStride,
+                    dstW,
+                    srcW != dstW ? &kx : nullptr,
+                    srcH != dstH ? &ky : nullptr};
+
+    int grain = std::max(static_cast<int>(kMinPixelsPerRange / dstW), 1);
+    threadPool().parallelFor(0, dstH, grain, [&job](int begin, int end) {
+        resampleRows(job, begin, end);
+    });
+}
+
+}  // namespace coomer
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace coomer {
+
+enum class ResampleFilter {
+    // Area averaging along axes that shrink, bicubic along the others.
+    Auto,
+    Area,
+    Bilinear,
+    Bicubic,
+};
+
+// Scales a w x h image of 4-byte pixels into a dstW x dstH one. Channels
+// are filtered independently, so any channel order works. Strides are in
+// bytes; a negative source stride walks the rows bottom-up. Large images
+// are split into row bands across the thread pool.
+void resamplePixels(const std::uint8_t* src, std::ptrdiff_t srcStride,
+                    int srcW, int srcH, std::uint8_t* dst,
+                    std::ptrdiff_t dstStride, int dstW, int dstH,
+                    ResampleFilter filter = ResampleFilter::Auto);
+
+}  // namespace coomer
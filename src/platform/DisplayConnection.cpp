@@ -0,0 +1,227 @@
+#include "platform/DisplayConnection.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "platform/Log.hpp"
+
+#if defined(COOMER_HAS_WAYLAND)
+#include <wayland-client.h>
+
+#include "xdg-output-unstable-v1-client-protocol.h"
+#endif
+#if defined(COOMER_HAS_X11)
+#include <X11/Xlib.h>
+#endif
+
+namespace coomer {
+
+#if defined(COOMER_HAS_WAYLAND)
+
+namespace {
+
+using WaylandOutput = DisplayConnection::WaylandOutput;
+
+void outputGeometry(void* data, wl_output*, int32_t x, int32_t y, int32_t,
+                    int32_t, int32_t, const char*, const char*, int32_t) {
+    auto* output = static_cast<WaylandOutput*>(data);
+    if (!output->xdg) {
+        output->info.x = x;
+        output->info.y = y;
+    }
+}
+
+void outputMode(void* data, wl_output*, uint32_t flags, int32_t width,
+                int32_t height, int32_t) {
+    auto* output = static_cast<WaylandOutput*>(data);
+    if ((flags & WL_OUTPUT_MODE_CURRENT) && !output->xdg) {
+        output->info.w = width;
+        output->info.h = height;
+    }
+}
+
+void outputDone(void* data, wl_output*) {
+    auto* output = static_cast<WaylandOutput*>(data);
+    if (output->info.name.empty()) {
+        output->info.name = "wl_output";
+    }
+}
+
+void outputScale(void* data, wl_output*, int32_t factor) {
+    auto* output = static_cast<WaylandOutput*>(data);
+    output->info.scale = static_cast<float>(factor);
+}
+
+void outputName(void* data, wl_output*, const char* name) {
+    auto* output = static_cast<WaylandOutput*>(data);
+    // xdg-output names win; they are what capture has always reported
+    if (name && (!output->xdg || output->info.name.empty())) {
+        output->info.name = name;
+    }
+}
+
+void outputDescription(void*, wl_output*, const char*) {}
+
+const wl_output_listener kOutputListener = {outputGeometry, outputMode,
+                                            outputDone,     outputScale,
+                                            outputName,     outputDescription};
+
+void xdgOutputLogicalPosition(void* data, zxdg_output_v1*, int32_t x,
+                              int32_t y) {
+    auto* output = static_cast<WaylandOutput*>(data);
+    output->info.x = x;
+    output->info.y = y;
+}
+
+void xdgOutputLogicalSize(void* data, zxdg_output_v1*, int32_t width,
+                          int32_t height) {
+    auto* output = static_cast<WaylandOutput*>(data);
+    output->info.w = width;
+    output->info.h = height;
+}
+
+void xdgOutputDone(void*, zxdg_output_v1*) {}
+
+void xdgOutputName(void* data, zxdg_output_v1*, const char* name) {
+    auto* output = static_cast<WaylandOutput*>(data);
+    if (name) {
+        output->info.name = name;
+    }
+}
+
+void xdgOutputDescription(void*, zxdg_output_v1*, const char*) {}
+
+const zxdg_output_v1_listener kXdgOutputListener = {
+    xdgOutputLogicalPosition, xdgOutputLogicalSize, xdgOutputDone,
+    xdgOutputName, xdgOutputDescription};
+
+void addXdgOutput(zxdg_output_manager_v1* manager, WaylandOutput& output) {
+    // xdg-output provides stable names and logical coordinates for wl_output
+    output.xdg = zxdg_output_manager_v1_get_xdg_output(manager, output.output);
+    zxdg_output_v1_add_listener(output.xdg, &kXdgOutputListener, &output);
+}
+
+}  // namespace
+
+void DisplayConnection::handleGlobal(void* data, wl_registry*, uint32_t name,
+                                     const char* interface, uint32_t version) {
+    static_cast<DisplayConnection*>(data)->addWaylandGlobal(name, interface,
+                                                            version);
+}
+
+void DisplayConnection::addWaylandGlobal(uint32_t name, const char* interface,
+                                         uint32_t version) {
+    globals_.push_back(WaylandGlobal{name, interface, version});
+    if (std::strcmp(interface, wl_output_interface.name) != 0) {
+        return;
+    }
+    // Version 4 adds the output name
+    auto output = std::make_unique<WaylandOutput>();
+    output->output = static_cast<wl_output*>(wl_registry_bind(
+        registry_, name, &wl_output_interface, std::min(version, 4u)));
+    output->info.scale = 1.0f;
+    wl_output_add_listener(output->output, &kOutputListener, output.get());
+    if (xdgOutputManager_) {
+        // Hotplugged after the initial burst of globals
+        addXdgOutput(xdgOutputManager_, *output);
+    }
+    outputs_.push_back(std::move(output));
+}
+
+void DisplayConnection::connectWayland() {
+    wlDisplay_ = wl_display_connect(nullptr);
+    if (!wlDisplay_) {
+        return;
+    }
+    static const wl_registry_listener kRegistryListener = {handleGlobal,
+                                                           handleGlobalRemove};
+    registry_ = wl_display_get_registry(wlDisplay_);
+    wl_registry_add_listener(registry_, &kRegistryListener, this);
+    wl_display_roundtrip(wlDisplay_);
+
+    if (const WaylandGlobal* global =
+            waylandGlobal(zxdg_output_manager_v1_interface.name)) {
+        xdgOutputManager_ = static_cast<zxdg_output_manager_v1*>(
+            wl_registry_bind(registry_, global->name,
+                             &zxdg_output_manager_v1_interface,
+                             std::min(global->version, 3u)));
+        for (auto& output : outputs_) {
+            addXdgOutput(xdgOutputManager_, *output);
+        }
+    }
+    if (!outputs_.empty()) {
+        // Output names and geometry arrive after binding
+        wl_display_roundtrip(wlDisplay_);
+        outputs_[0]->info.primary = true;
+    }
+    LOG_DEBUG("wayland: %zu globals, %zu outputs", globals_.size(),
+              outputs_.size());
+}
+
+void DisplayConnection::disconnectWayland() {
+    for (auto& output : outputs_) {
+        if (output->xdg) {
+            zxdg_output_v1_destroy(output->xdg);
+        }
+        wl_output_destroy(output->output);
+    }
+    outputs_.clear();
+    if (xdgOutputManager_) {
+        zxdg_output_manager_v1_destroy(xdgOutputManager_);
+    }
+    if (registry_) {
+        wl_registry_destroy(registry_);
+    }
+    if (wlDisplay_) {
+        wl_display_disconnect(wlDisplay_);
+    }
+}
+
+#else
+
+void DisplayConnection::handleGlobal(void*, wl_registry*, uint32_t,
+                                     const char*, uint32_t) {}
+void DisplayConnection::addWaylandGlobal(uint32_t, const char*, uint32_t) {}
+void DisplayConnection::connectWayland() {}
+void DisplayConnection::disconnectWayland() {}
+
+#endif
+
+DisplayConnection::~DisplayConnection() {
+    disconnectWayland();
+#if defined(COOMER_HAS_X11)
+    if (x11Display_) {
+        XCloseDisplay(x11Display_);
+    }
+#endif
+}
+
+wl_display* DisplayConnection::wayland() {
+    if (!waylandTried_) {
+        waylandTried_ = true;
+        connectWayland();
+    }
+    return wlDisplay_;
+}
+
+const DisplayConnection::WaylandGlobal* DisplayConnection::waylandGlobal(
+    const char* interface) const {
+    for (const WaylandGlobal& global : globals_) {
+        if (global.interface == interface) {
+            return &global;
+        }
+    }
+    return nullptr;
+}
+
+Display* DisplayConnection::x11() {
+    if (!x11Tried_) {
+        x11Tried_ = true;
+#if defined(COOMER_HAS_X11)
+        x11Display_ = XOpenDisplay(nullptr);
+#endif
+    }
+    return x11Display_;
+}
+
+}  // namespace coomer
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "capture/CaptureTypes.hpp"
+
+struct wl_display;
+struct wl_registry;
+struct wl_output;
+struct zxdg_output_manager_v1;
+struct zxdg_output_v1;
+typedef struct _XDisplay Display;
+
+namespace coomer {
+
+// Display server connections shared by the capture backend and the window,
+// opened once in main. Each side connects lazily on first use, so only the
+// servers a session actually talks to are contacted. The Wayland side keeps
+// the registry globals and the outputs, named the way capture reports them,
+// so windows match capture monitors by the same names.
+class DisplayConnection {
+public:
+    struct WaylandGlobal {
+        uint32_t name = 0;
+        std::string interface;
+        uint32_t version = 0;
+    };
+
+    struct WaylandOutput {
+        wl_output* output = nullptr;
+        zxdg_output_v1* xdg = nullptr;
+        // xdg-output name and logical geometry when available
+        MonitorInfo info;
+    };
+
+    DisplayConnection() = default;
+    ~DisplayConnection();
+
+    DisplayConnection(const DisplayConnection&) = delete;
+    DisplayConnection& operator=(const DisplayConnection&) = delete;
+
+    // Connects and reads the globals and outputs on first call; null when
+    // no compositor is reachable or Wayland support is disabled.
+    wl_display* wayland();
+    // Valid once wayland() succeeded. Proxies bound from it are owned (and
+    // destroyed) by whoever binds them.
+    wl_registry* waylandRegistry() const {
+        return registry_;
+    }
+    const std::vector<WaylandGlobal>& waylandGlobals() const {
+        return globals_;
+    }
+    // Null when the compositor does not advertise `interface`.
+    const WaylandGlobal* waylandGlobal(const char* interface) const;
+    const std::vector<std::unique_ptr<WaylandOutput>>& waylandOutputs() const {
+        return outputs_;
+    }
+
+    // Opens the display on first call; null when no X server is reachable
+    // or X11 support is disabled.
+    Display* x11();
+
+private:
+    void connectWayland();
+    void disconnectWayland();
+    void addWaylandGlobal(uint32_t name, const char* interface,
+                          uint32_t version);
+
+    static void handleGlobal(void* data, wl_registry* registry, uint32_t name,
+                             const char* interface, uint32_t version);
+    static void handleGlobalRemove(void*, wl_registry*, uint32_t) {}
+
+    bool waylandTried_ = false;
+    wl_display* wlDisplay_ = nullptr;
+    wl_registry* registry_ = nullptr;
+    zxdg_output_manager_v1* xdgOutputManager_ = nullptr;
+    std::vector<WaylandGlobal> globals_;
+    std::vector<std::unique_ptr<WaylandOutput>> outputs_;
+
+    bool x11Tried_ = false;
+    Display* x11Display_ = nullptr;
+};
+
+}  // namespace coomer
@@ -1,9 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 
 namespace coomer {
 
@@ -11,11 +17,238 @@ enum class LogLevel { Info, Warn, Error, Debug };
 
 inline bool g_debug_enabled = false;
 inline FILE* g_log_file = nullptr;
+// Guards g_log_file against closing while another thread writes to it.
+inline std::mutex g_log_file_mutex;
 
 inline void setDebugLogging(bool enabled) {
     g_debug_enabled = enabled;
 }
 
+// Formatted lines waiting for the writer thread. Any thread may push
+// without taking a lock; only the writer pops. Each slot carries a
+// sequence number telling whose turn it is (Vyukov's bounded queue).
+class LogRing {
+public:
+    static constexpr size_t kSlots = 1024;
+    // Longer lines are cut short.
+    static constexpr size_t kLineSize = 512;
+
+    LogRing() {
+        for (size_t i = 0; i < kSlots; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns false, dropping the line, when the ring is full.
+    bool push(LogLevel level, const char* fmt, va_list args) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots_[pos % kSlots];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+            if (diff == 0 &&
+                tail_.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed)) {
+                break;
+            }
+            if (diff < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (diff > 0) {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        slot->level = level;
+        std::vsnprintf(slot->text, kLineSize, fmt, args);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Appends the oldest line, tagged, to out. Single consumer only.
+    bool pop(std::string& out) {
+        Slot& slot = slots_[head_ % kSlots];
+        if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+            return false;
+        }
+        appendLine(out, slot.level, slot.text);
+        slot.sequence.store(head_ + kSlots, std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+    static void appendLine(std::string& out, LogLevel level,
+                           const char* text) {
+        out += "[";
+        out += tag(level);
+        out += "] ";
+        out += text;
+        out += "\n";
+    }
+
+    bool empty() const {
+        const Slot& slot = slots_[head_ % kSlots];
+        return slot.sequence.load(std::memory_order_acquire) != head_ + 1;
+    }
+
+    size_t takeDropped() {
+        return dropped_.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        LogLevel level = LogLevel::Info;
+        char text[kLineSize];
+    };
+
+    static const char* tag(LogLevel level) {
+        switch (level) {
+            case LogLevel::Info:
+                return "INFO";
+            case LogLevel::Warn:
+                return "WARN";
+            case LogLevel::Error:
+                return "ERROR";
+            case LogLevel::Debug:
+                return "DEBUG";
+        }
+        return "INFO";
+    }
+
+    std::unique_ptr<Slot[]> slots_{new Slot[kSlots]};
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) size_t head_ = 0;
+    std::atomic<size_t> dropped_{0};
+};
+
+class LogWriter;
+inline LogWriter& logWriter();
+
+// Writes queued lines to stderr and the log file off the logging threads.
+// Started by the first message; flushLogs() stops it, and lines logged
+// after that are written directly.
+class LogWriter {
+public:
+    void log(LogLevel level, const char* fmt, va_list args) {
+        // Counted before the check so that flush() can wait for lines that
+        // got past it to land in the ring.
+        producers_.fetch_add(1);
+        if (stopped_.load()) {
+            producers_.fetch_sub(1);
+            char text[LogRing::kLineSize];
+            std::vsnprintf(text, sizeof(text), fmt, args);
+            std::string line;
+            LogRing::appendLine(line, level, text);
+            write(line);
+            return;
+        }
+        std::call_once(started_, [this] { start(); });
+        ring_.push(level, fmt, args);
+        producers_.fetch_sub(1);
+        // Pairs with the fence in run(): either the writer sees the line
+        // before sleeping or this sees it asleep and wakes it.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load()) {
+            std::lock_guard<std::mutex> lock(wakeMutex_);
+            wake_.notify_one();
+        }
+    }
+
+    // Stops the writer once everything queued is written.
+    void flush() {
+        std::lock_guard<std::mutex> lock(flushMutex_);
+        if (stopped_.exchange(true)) {
+            return;
+        }
+        // Loggers that passed the check before it flipped are still
+        // pushing, or starting the writer.
+        while (producers_.load() > 0) {
+            std::this_thread::yield();
+        }
+        if (thread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> wakeLock(wakeMutex_);
+            }
+            wake_.notify_one();
+            thread_.join();
+        }
+        writeQueued(ring_);
+    }
+
+private:
+    void start() {
+        thread_ = std::thread([this] { run(); });
+        std::atexit([] { logWriter().flush(); });
+    }
+
+    void run() {
+        while (!stopped_.load(std::memory_order_acquire)) {
+            if (writeQueued(ring_)) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(wakeMutex_);
+            sleeping_.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            wake_.wait(lock, [this] {
+                return stopped_.load() || !ring_.empty();
+            });
+            sleeping_.store(false);
+        }
+        writeQueued(ring_);
+    }
+
+    // Writes one batch per output, flushing the file once. Returns whether
+    // there was anything to write.
+    bool writeQueued(LogRing& ring) {
+        batch_.clear();
+        while (ring.pop(batch_)) {
+        }
+        if (size_t dropped = ring.takeDropped()) {
+            batch_ += "[WARN] log: dropped " + std::to_string(dropped) +
+                      " messages, the queue was full\n";
+        }
+        if (batch_.empty()) {
+            return false;
+        }
+        write(batch_);
+        return true;
+    }
+
+    static void write(const std::string& text) {
+        std::fwrite(text.data(), 1, text.size(), stderr);
+        std::lock_guard<std::mutex> lock(g_log_file_mutex);
+        if (FILE* file = g_log_file) {
+            std::fwrite(text.data(), 1, text.size(), file);
+            std::fflush(file);
+        }
+    }
+
+    LogRing ring_;
+    std::string batch_;
+    std::once_flag started_;
+    std::thread thread_;
+    std::atomic<bool> stopped_{false};
+    // Loggers between their stopped_ check and the end of their push.
+    std::atomic<int> producers_{0};
+    std::atomic<bool> sleeping_{false};
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    std::mutex flushMutex_;
+};
+
+inline LogWriter& logWriter() {
+    static LogWriter writer;
+    return writer;
+}
+
+// Writes out every queued message. Logging keeps working afterwards, but
+// synchronously.
+inline void flushLogs() {
+    logWriter().flush();
+}
+
 inline void initFileLogging() {
     const char* logPath = std::getenv("COOMER_LOG_FILE");
     if (logPath && logPath[0] != '\0') {
@@ -28,53 +261,24 @@ inline void initFileLogging() {
 }
 
 inline void closeFileLogging() {
+    flushLogs();
+    // Other threads may still log, now synchronously
+    std::lock_guard<std::mutex> lock(g_log_file_mutex);
     if (g_log_file) {
         std::fclose(g_log_file);
         g_log_file = nullptr;
     }
 }
 
-inline void logMessage(LogLevel level, const char* fmt, ...) {
+// Formats on the calling thread and queues the line; never blocks on I/O.
+__attribute__((format(printf, 2, 3))) inline void logMessage(
+    LogLevel level, const char* fmt, ...) {
     if (level == LogLevel::Debug && !g_debug_enabled) {
         return;
     }
-    const char* tag = "INFO";
-    switch (level) {
-        case LogLevel::Info:
-            tag = "INFO";
-            break;
-        case LogLevel::Warn:
-            tag = "WARN";
-            break;
-        case LogLevel::Error:
-            tag = "ERROR";
-            break;
-        case LogLevel::Debug:
-            tag = "DEBUG";
-            break;
-    }
-
     va_list args;
     va_start(args, fmt);
-
-    // Log to stderr
-    std::fprintf(stderr, "[%s] ", tag);
-    va_list args_copy;
-    va_copy(args_copy, args);
-    std::vfprintf(stderr, fmt, args_copy);
-    va_end(args_copy);
-    std::fprintf(stderr, "\n");
-
-    // Log to file if enabled
-    if (g_log_file) {
-        std::fprintf(g_log_file, "[%s] ", tag);
-        va_copy(args_copy, args);
-        std::vfprintf(g_log_file, fmt, args_copy);
-        va_end(args_copy);
-        std::fprintf(g_log_file, "\n");
-        std::fflush(g_log_file);
-    }
-
+    logWriter().log(level, fmt, args);
     va_end(args);
 }
 
@@ -86,5 +290,15 @@ inline void logMessage(LogLevel level, const char* fmt, ...) {
     ::coomer::logMessage(::coomer::LogLevel::Warn, __VA_ARGS__)
 #define LOG_ERROR(...) \
     ::coomer::logMessage(::coomer::LogLevel::Error, __VA_ARGS__)
+#if defined(COOMER_HAS_DEBUG_LOG)
 #define LOG_DEBUG(...) \
     ::coomer::logMessage(::coomer::LogLevel::Debug, __VA_ARGS__)
+#else
+// Compiled out, but the arguments are still type-checked.
+#define LOG_DEBUG(...)                                                      \
+    do {                                                                    \
+        if (false) {                                                        \
+            ::coomer::logMessage(::coomer::LogLevel::Debug, __VA_ARGS__); \
+        }                                                                   \
+    } while (0)
+#endif
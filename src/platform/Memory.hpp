@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+
+namespace coomer {
+
+struct MemoryUsage {
+    // Resident set size now and at its peak, in bytes; 0 when unknown.
+    size_t rss = 0;
+    size_t peakRss = 0;
+};
+
+// Reads VmRSS and VmHWM from /proc/self/status.
+inline MemoryUsage readMemoryUsage() {
+    MemoryUsage usage;
+    std::FILE* file = std::fopen("/proc/self/status", "r");
+    if (!file) {
+        return usage;
+    }
+    char line[256];
+    while (std::fgets(line, sizeof(line), file)) {
+        unsigned long kb = 0;
+        if (std::sscanf(line, "VmRSS: %lu kB", &kb) == 1) {
+            usage.rss = static_cast<size_t>(kb) * 1024u;
+        } else if (std::sscanf(line, "VmHWM: %lu kB", &kb) == 1) {
+            usage.peakRss = static_cast<size_t>(kb) * 1024u;
+        }
+    }
+    std::fclose(file);
+    return usage;
+}
+
+inline double toMiB(size_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+}  // namespace coomer
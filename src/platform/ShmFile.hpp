@@ -0,0 +1,29 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+
+namespace coomer {
+
+// Anonymous shared memory file of `size` bytes for wl_shm pools, or -1.
+inline int createShmFile(size_t size) {
+    for (int attempt = 0; attempt < 8; ++attempt) {
+        std::string name = "/coomer-shm-" + std::to_string(getpid()) + "-" +
+                           std::to_string(rand());
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_EXCL, 0600);
+        if (fd >= 0) {
+            shm_unlink(name.c_str());
+            if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+                return fd;
+            }
+            close(fd);
+        }
+    }
+    return -1;
+}
+
+}  // namespace coomer
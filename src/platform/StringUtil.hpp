@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstring>
+
+namespace coomer {
+
+// Checks a space-separated extension list (GL/EGL/GLX style) for an exact
+// token match.
+inline bool hasExtension(const char* list, const char* name) {
+    if (!list || !name || !*name) {
+        return false;
+    }
+    size_t len = std::strlen(name);
+    const char* p = list;
+    while ((p = std::strstr(p, name)) != nullptr) {
+        bool startOk = (p == list) || p[-1] == ' ';
+        bool endOk = p[len] == ' ' || p[len] == '\0';
+        if (startOk && endOk) {
+            return true;
+        }
+        p += len;
+    }
+    return false;
+}
+
+}  // namespace coomer
@@ -0,0 +1,198 @@
+#include "platform/ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "platform/Log.hpp"
+#include "platform/Trace.hpp"
+
+namespace coomer {
+
+namespace {
+
+// Index of the worker running on this thread; kNoWorker elsewhere.
+constexpr size_t kNoWorker = static_cast<size_t>(-1);
+thread_local size_t t_worker = kNoWorker;
+
+// More ranges than threads so that stealing can even out uneven rows.
+constexpr int kRangesPerThread = 4;
+
+}  // namespace
+
+unsigned int ThreadPool::workerCount() {
+    unsigned int cores = std::thread::hardware_concurrency();
+    return std::clamp(cores, 1u, 64u) - 1;
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_.store(true);
+    }
+    workCv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::start() {
+    unsigned int count = workerCount();
+    // Threads outside the pool queue on one of the worker deques too, so
+    // there is at least one deque even without workers.
+    for (unsigned int i = 0; i < std::max(count, 1u); ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+        workers_.emplace_back([this, i] { workerLoop(i); });
+    }
+    LOG_DEBUG("thread pool: %u workers", count);
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    t_worker = index;
+    TRACE_THREAD("worker");
+    while (true) {
+        if (runOne(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        workCv_.wait(lock, [this] {
+            return stopping_.load() || queued_.load() > 0;
+        });
+        if (stopping_.load()) {
+            return;
+        }
+    }
+}
+
+TaskHandle ThreadPool::submit(std::function<void()> fn,
+                              const std::vector<TaskHandle>& after) {
+    std::call_once(started_, [this] { start(); });
+    auto task = std::make_shared<Task>();
+    task->fn_ = std::move(fn);
+    for (const TaskHandle& dependency : after) {
+        if (!dependency) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(dependency->mutex_);
+        if (!dependency->done()) {
+            task->pending_.fetch_add(1);
+            dependency->dependents_.push_back(task);
+        }
+    }
+    if (task->pending_.fetch_sub(1) == 1) {
+        enqueue(task);
+    }
+    return task;
+}
+
+void ThreadPool::enqueue(TaskHandle task) {
+    size_t index = t_worker != kNoWorker
+                       ? t_worker
+                       : nextQueue_.fetch_add(1) % queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        queued_.fetch_add(1);
+    }
+    workCv_.notify_one();
+}
+
+bool ThreadPool::runOne(size_t home) {
+    TaskHandle task;
+    size_t count = queues_.size();
+    for (size_t i = 0; i < count && !task; ++i) {
+        Queue& queue = *queues_[(home + i) % count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    queued_.fetch_sub(1);
+    task->fn_();
+    finish(task);
+    return true;
+}
+
+void ThreadPool::finish(const TaskHandle& task) {
+    task->fn_ = nullptr;
+    std::vector<TaskHandle> dependents;
+    {
+        std::lock_guard<std::mutex> lock(task->mutex_);
+        task->done_.store(true, std::memory_order_release);
+        dependents.swap(task->dependents_);
+    }
+    for (TaskHandle& dependent : dependents) {
+        if (dependent->pending_.fetch_sub(1) == 1) {
+            enqueue(std::move(dependent));
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+    }
+    doneCv_.notify_all();
+}
+
+void ThreadPool::wait(const TaskHandle& task) {
+    size_t home = t_worker != kNoWorker ? t_worker : 0;
+    while (!task->done()) {
+        if (runOne(home)) {
+            continue;
+        }
+        // The task is running elsewhere or waiting on one that is. Tasks
+        // queued meanwhile are picked up after at most a millisecond.
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        doneCv_.wait_for(lock, std::chrono::milliseconds(1),
+                         [&task] { return task->done(); });
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, int minGrain,
+                             const std::function<void(int, int)>& body) {
+    int items = end - begin;
+    if (items <= 0) {
+        return;
+    }
+    int maxRanges = static_cast<int>(workerCount() + 1) * kRangesPerThread;
+    int ranges = std::clamp(items / std::max(minGrain, 1), 1, maxRanges);
+    if (ranges == 1 || workerCount() == 0) {
+        body(begin, end);
+        return;
+    }
+    auto rangeStart = [&](int range) {
+        return begin + static_cast<int>(static_cast<long long>(items) *
+                                        range / ranges);
+    };
+    std::vector<TaskHandle> tasks;
+    tasks.reserve(static_cast<size_t>(ranges - 1));
+    for (int range = 1; range < ranges; ++range) {
+        tasks.push_back(submit([&body, from = rangeStart(range),
+                                to = rangeStart(range + 1)] {
+            body(from, to);
+        }));
+    }
+    body(begin, rangeStart(1));
+    for (const TaskHandle& task : tasks) {
+        wait(task);
+    }
+}
+
+ThreadPool& threadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+}  // namespace coomer
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace coomer {
+
+class ThreadPool;
+
+// A submitted task. It runs once every task it was submitted after is done.
+class Task {
+public:
+    bool done() const {
+        return done_.load(std::memory_order_acquire);
+    }
+
+private:
+    friend class ThreadPool;
+
+    std::function<void()> fn_;
+    // Unfinished dependencies, plus one held by submit() itself.
+    std::atomic<int> pending_{1};
+    std::atomic<bool> done_{false};
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<Task>> dependents_;
+};
+
+using TaskHandle = std::shared_ptr<Task>;
+
+// Workers with a task deque each: a worker takes its newest task and, when
+// out of work, steals the oldest one from another worker. Threads are only
+// started by the first submit, and a thread waiting on a task runs queued
+// tasks meanwhile, so tasks can wait on tasks of their own. On a single
+// core there are no workers and tasks run inside wait().
+class ThreadPool {
+public:
+    // Worker threads besides the calling one; 0 on a single core.
+    static unsigned int workerCount();
+
+    ~ThreadPool();
+
+    TaskHandle submit(std::function<void()> fn,
+                      const std::vector<TaskHandle>& after = {});
+    void wait(const TaskHandle& task);
+
+    // Runs body(rangeBegin, rangeEnd) over [begin, end) in ranges of at
+    // least minGrain items, partly on the calling thread, and returns once
+    // all are done. Ranges too small to share run inline without touching
+    // the pool.
+    void parallelFor(int begin, int end, int minGrain,
+                     const std::function<void(int, int)>& body);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<TaskHandle> tasks;
+    };
+
+    void start();
+    void workerLoop(size_t index);
+    void enqueue(TaskHandle task);
+    bool runOne(size_t home);
+    void finish(const TaskHandle& task);
+
+    std::once_flag started_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> nextQueue_{0};
+    std::atomic<size_t> queued_{0};
+    std::atomic<bool> stopping_{false};
+    // Idle workers sleep on workCv_; waiters are woken through doneCv_
+    // whenever a task finishes.
+    std::mutex sleepMutex_;
+    std::condition_variable workCv_;
+    std::condition_variable doneCv_;
+};
+
+// The process-wide pool shared by capture and rendering.
+ThreadPool& threadPool();
+
+}  // namespace coomer
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 
 namespace coomer {
 
@@ -10,4 +11,19 @@ inline double nowSeconds() {
     return std::chrono::duration<double>(now).count();
 }
 
+// Converts a millisecond input timestamp from the compositor or X server to
+// the nowSeconds() clock. Both normally stamp events with CLOCK_MONOTONIC
+// truncated to 32 bits; a timestamp that does not fit that (older than a
+// second or from the future) is replaced by the time it was received.
+inline double eventTimeSeconds(std::uint32_t ms) {
+    double now = nowSeconds();
+    auto nowMs = static_cast<std::uint32_t>(
+        static_cast<std::uint64_t>(now * 1000.0));
+    std::uint32_t age = nowMs - ms;
+    if (age > 1000u) {
+        return now;
+    }
+    return now - age / 1000.0;
+}
+
 }  // namespace coomer
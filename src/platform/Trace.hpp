@@ -0,0 +1,216 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "platform/Log.hpp"
+#include "platform/Time.hpp"
+
+namespace coomer {
+
+#if defined(COOMER_HAS_TRACE)
+
+// A finished zone. Names are string literals and outlive the trace.
+struct TraceEvent {
+    const char* name;
+    double start;
+    double end;
+};
+
+// Events of one thread. Only the owning thread appends; the count is
+// published after each event so the writer can read while threads run.
+struct TraceBuffer {
+    static constexpr size_t kCapacity = 1 << 16;
+
+    std::unique_ptr<TraceEvent[]> events{new TraceEvent[kCapacity]};
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> dropped{0};
+    std::atomic<const char*> threadName{nullptr};
+    int tid = 0;
+};
+
+inline std::atomic<bool> g_trace_enabled{false};
+inline std::FILE* g_trace_file = nullptr;
+inline double g_trace_start = 0.0;
+// Buffers stay registered until the trace is written, even after their
+// thread exits; the lock is only taken once per thread.
+inline std::mutex g_trace_mutex;
+inline std::vector<std::unique_ptr<TraceBuffer>> g_trace_buffers;
+
+inline TraceBuffer* registerTraceBuffer() {
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    g_trace_buffers.push_back(std::make_unique<TraceBuffer>());
+    TraceBuffer* buffer = g_trace_buffers.back().get();
+    buffer->tid = static_cast<int>(g_trace_buffers.size());
+    return buffer;
+}
+
+inline TraceBuffer& traceBuffer() {
+    thread_local TraceBuffer* buffer = registerTraceBuffer();
+    return *buffer;
+}
+
+inline void traceEvent(TraceBuffer& buffer, const char* name, double start,
+                       double end) {
+    size_t count = buffer.count.load(std::memory_order_relaxed);
+    if (count == TraceBuffer::kCapacity) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer.events[count] = TraceEvent{name, start, end};
+    buffer.count.store(count + 1, std::memory_order_release);
+}
+
+inline bool tracing() {
+    return g_trace_enabled.load(std::memory_order_relaxed);
+}
+
+inline void traceThreadName(const char* name) {
+    if (tracing()) {
+        traceBuffer().threadName.store(name, std::memory_order_relaxed);
+    }
+}
+
+class TraceZone {
+public:
+    explicit TraceZone(const char* name)
+        : name_(tracing() ? name : nullptr),
+          start_(name_ ? nowSeconds() : 0.0) {}
+
+    ~TraceZone() {
+        if (name_) {
+            traceEvent(traceBuffer(), name_, start_, nowSeconds());
+        }
+    }
+
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+    const char* name_;
+    double start_;
+};
+
+// A track of its own for work timed after the fact, such as GPU queries
+// read back frames later. Events must come from one thread at a time.
+class TraceTrack {
+public:
+    explicit TraceTrack(const char* name) : name_(name) {}
+
+    void event(const char* name, double start, double end) {
+        if (!tracing()) {
+            return;
+        }
+        if (!buffer_) {
+            buffer_ = registerTraceBuffer();
+            buffer_->threadName.store(name_, std::memory_order_relaxed);
+        }
+        traceEvent(*buffer_, name, start, end);
+    }
+
+private:
+    const char* name_;
+    TraceBuffer* buffer_ = nullptr;
+};
+
+// Writes everything recorded so far as Chrome trace JSON (chrome://tracing,
+// ui.perfetto.dev) and stops tracing.
+inline void closeTracing() {
+    if (!g_trace_enabled.exchange(false)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    std::FILE* file = g_trace_file;
+    std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    const char* separator = "";
+    size_t events = 0;
+    size_t dropped = 0;
+    for (const auto& buffer : g_trace_buffers) {
+        if (const char* name = buffer->threadName.load()) {
+            std::fprintf(file,
+                         "%s{\"ph\": \"M\", \"name\": \"thread_name\", "
+                         "\"pid\": 1, \"tid\": %d, \"args\": {\"name\": "
+                         "\"%s\"}}",
+                         separator, buffer->tid, name);
+            separator = ",\n";
+        }
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            const TraceEvent& event = buffer->events[i];
+            std::fprintf(file,
+                         "%s{\"ph\": \"X\", \"name\": \"%s\", \"pid\": 1, "
+                         "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                         separator, event.name, buffer->tid,
+                         (event.start - g_trace_start) * 1e6,
+                         (event.end - event.start) * 1e6);
+            separator = ",\n";
+        }
+        events += count;
+        dropped += buffer->dropped.load();
+    }
+    std::fprintf(file, "\n]}\n");
+    std::fclose(file);
+    g_trace_file = nullptr;
+    if (dropped > 0) {
+        LOG_WARN("trace: dropped %zu events, per-thread buffers are full",
+                 dropped);
+    }
+    LOG_DEBUG("trace: wrote %zu events", events);
+}
+
+// Starts tracing when COOMER_TRACE_FILE names a writable file. The trace is
+// written at exit, whichever path main leaves by.
+inline void initTracing() {
+    const char* path = std::getenv("COOMER_TRACE_FILE");
+    if (!path || path[0] == '\0') {
+        return;
+    }
+    g_trace_file = std::fopen(path, "w");
+    if (!g_trace_file) {
+        LOG_WARN("trace: cannot open %s", path);
+        return;
+    }
+    g_trace_start = nowSeconds();
+    g_trace_enabled.store(true);
+    std::atexit(closeTracing);
+}
+
+#else
+
+inline void initTracing() {}
+inline void closeTracing() {}
+inline bool tracing() {
+    return false;
+}
+
+class TraceTrack {
+public:
+    explicit TraceTrack(const char*) {}
+    void event(const char*, double, double) {}
+};
+
+#endif
+
+}  // namespace coomer
+
+#if defined(COOMER_HAS_TRACE)
+#define COOMER_TRACE_CONCAT_(a, b) a##b
+#define COOMER_TRACE_CONCAT(a, b) COOMER_TRACE_CONCAT_(a, b)
+// Times the rest of the enclosing scope.
+#define TRACE_ZONE(name) \
+    ::coomer::TraceZone COOMER_TRACE_CONCAT(traceZone_, __LINE__)(name)
+// Names the calling thread in the trace.
+#define TRACE_THREAD(name) ::coomer::traceThreadName(name)
+#else
+#define TRACE_ZONE(name) \
+    do {                 \
+    } while (0)
+#define TRACE_THREAD(name) \
+    do {                   \
+    } while (0)
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstdint>
+
+namespace coomer {
+
+// eventfd that one thread signals to wake another out of poll().
+class WakeFd {
+public:
+    WakeFd() : fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {}
+    ~WakeFd() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    WakeFd(const WakeFd&) = delete;
+    WakeFd& operator=(const WakeFd&) = delete;
+
+    // Pollable for POLLIN; -1 if the eventfd could not be created.
+    int fd() const {
+        return fd_;
+    }
+    void signal() {
+        std::uint64_t one = 1;
+        if (fd_ >= 0) {
+            (void)!write(fd_, &one, sizeof(one));
+        }
+    }
+    // Resets the fd after a wakeup.
+    void drain() {
+        std::uint64_t count = 0;
+        if (fd_ >= 0) {
+            (void)!read(fd_, &count, sizeof(count));
+        }
+    }
+
+private:
+    int fd_ = -1;
+};
+
+}  // namespace coomer
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+
+namespace coomer {
+
+// Axis-aligned region in framebuffer pixels, origin at the bottom-left like
+// glScissor and EGL_KHR_swap_buffers_with_damage.
+struct DamageRect {
+    int x = 0;
+    int y = 0;
+    int w = 0;
+    int h = 0;
+
+    bool empty() const {
+        return w <= 0 || h <= 0;
+    }
+};
+
+inline DamageRect uniteDamage(const DamageRect& a, const DamageRect& b) {
+    if (a.empty()) {
+        return b;
+    }
+    if (b.empty()) {
+        return a;
+    }
+    int x0 = std::min(a.x, b.x);
+    int y0 = std::min(a.y, b.y);
+    int x1 = std::max(a.x + a.w, b.x + b.w);
+    int y1 = std::max(a.y + a.h, b.y + b.h);
+    return DamageRect{x0, y0, x1 - x0, y1 - y0};
+}
+
+inline DamageRect intersectDamage(const DamageRect& a, const DamageRect& b) {
+    int x0 = std::max(a.x, b.x);
+    int y0 = std::max(a.y, b.y);
+    int x1 = std::min(a.x + a.w, b.x + b.w);
+    int y1 = std::min(a.y + a.h, b.y + b.h);
+    if (x1 <= x0 || y1 <= y0) {
+        return DamageRect{};
+    }
+    return DamageRect{x0, y0, x1 - x0, y1 - y0};
+}
+
+// Remembers the damage of recent frames so a back buffer of known age can be
+// brought up to date by repainting only what changed since it was shown.
+class DamageHistory {
+public:
+    // Region to repaint for a frame with the given damage when the back buffer
+    // is bufferAge frames old (0 means undefined contents).
+    DamageRect repairRegion(const DamageRect& frame, int bufferAge,
+                            const DamageRect& full) const {
+        if (bufferAge <= 0 || bufferAge - 1 > count_) {
+            return full;
+        }
+        DamageRect region = frame;
+        for (int i = 0; i < bufferAge - 1; ++i) {
+            int idx = (head_ + kMaxFrames - 1 - i) % kMaxFrames;
+            region = uniteDamage(region, frames_[idx]);
+        }
+        return intersectDamage(region, full);
+    }
+
+    void push(const DamageRect& frame) {
+        frames_[head_] = frame;
+        head_ = (head_ + 1) % kMaxFrames;
+        count_ = std::min(count_ + 1, kMaxFrames);
+    }
+
+private:
+    static constexpr int kMaxFrames = 4;
+    std::array<DamageRect, kMaxFrames> frames_{};
+    int head_ = 0;
+    int count_ = 0;
+};
+
+}  // namespace coomer
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "capture/CaptureTypes.hpp"
+#include "render/Damage.hpp"
+
+namespace coomer {
+
+// Magnification filter used when sampling the screenshot. Values must match
+// the FILTER_* constants in ShaderSources.hpp.
+enum class FilterMode { Nearest = 0, Bilinear = 1, Bicubic = 2, Lanczos = 3 };
+
+struct CameraState {
+    float zoom = 1.0f;
+    float panX = 0.0f;
+    float panY = 0.0f;
+    int screenW = 0;
+    int screenH = 0;
+};
+
+struct SpotlightState {
+    bool enabled = false;
+    float cursorX = 0.0f;
+    float cursorY = 0.0f;
+    float radiusPx = 160.0f;
+    float tintR = 0.0f;
+    float tintG = 0.0f;
+    float tintB = 0.0f;
+    float tintA = 0.75f;
+};
+
+// Width of the soft spotlight edge; renderers must agree on it so damage
+// rectangles cover what they draw.
+inline float spotlightFeather(float radiusPx) {
+    return std::max(2.0f, radiusPx * 0.08f);
+}
+
+// Screen area whose pixels depend on the spotlight position and radius,
+// including the feathered edge.
+inline DamageRect spotlightDamageRect(const SpotlightState& spotlight) {
+    // Plus a pixel for rounding
+    float extent =
+        spotlight.radiusPx + spotlightFeather(spotlight.radiusPx) + 1.0f;
+    int x0 = static_cast<int>(std::floor(spotlight.cursorX - extent));
+    int y0 = static_cast<int>(std::floor(spotlight.cursorY - extent));
+    int x1 = static_cast<int>(std::ceil(spotlight.cursorX + extent));
+    int y1 = static_cast<int>(std::ceil(spotlight.cursorY + extent));
+    return DamageRect{x0, y0, x1 - x0, y1 - y0};
+}
+
+// GPU execution time of one upload or draw, on the nowSeconds() clock.
+struct GpuTiming {
+    enum class Stage { Upload, Draw };
+    Stage stage = Stage::Draw;
+    double start = 0.0;
+    double end = 0.0;
+};
+
+// Contents of the performance HUD.
+struct HudInfo {
+    // Drawn top to bottom in the top-left corner
+    std::vector<std::string> lines;
+    // Recent frame times in seconds, oldest first, graphed below the text
+    std::vector<float> frameTimes;
+    // Frame time drawn at half the graph height; slower frames stand out
+    float targetFrameTime = 1.0f / 60.0f;
+};
+
+class IRenderer {
+public:
+    virtual ~IRenderer() = default;
+    virtual bool uploadScreenshotTexture(const ImageRGBA& image) = 0;
+    // Re-uploads only the given rectangles of an image the size of the one
+    // last passed to uploadScreenshotTexture. rgba points at the top-left
+    // pixel, strideBytes is the distance between rows.
+    virtual bool updateScreenshotTexture(
+        const std::uint8_t* rgba, int strideBytes,
+        const std::vector<ImageRect>& rects) = 0;
+    // Draws the view. When clip is set only that region is touched; the rest
+    // of the back buffer must already hold the same frame.
+    virtual void renderFrame(const CameraState& camera,
+                             const SpotlightState& spotlight,
+                             FilterMode filter = FilterMode::Bilinear,
+                             const DamageRect* clip = nullptr) = 0;
+    // Starts timing uploads and draws on the GPU, where the renderer can.
+    virtual void setGpuTiming(bool) {}
+    // GPU timings that became available since the last call. Results lag
+    // the work by a few frames.
+    virtual std::vector<GpuTiming> takeGpuTimings() {
+        return {};
+    }
+    // Draws the HUD over the frame just rendered in a view of the given
+    // size; false when the renderer has no HUD. The HUD is not part of any
+    // damage, so its view must be presented in full.
+    virtual bool renderHud(const HudInfo&, int, int) {
+        return false;
+    }
+    // Estimated GPU memory held by textures and staging buffers.
+    virtual size_t textureBytes() const {
+        return 0;
+    }
+    // CPU memory holding the renderer's own copy of the screenshot. After
+    // an upload the caller's image is no longer needed.
+    virtual size_t imageBytes() const {
+        return 0;
+    }
+};
+
+}  // namespace coomer
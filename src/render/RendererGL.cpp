@@ -2,11 +2,17 @@
 
 #include <glad/gl.h>
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <string>
 #include <vector>
 
+#include "capture/ImageDiff.hpp"
 #include "platform/Log.hpp"
+#include "platform/Time.hpp"
+#include "platform/Trace.hpp"
+#include "render/HudFont.hpp"
 #include "render/ShaderSources.hpp"
 
 namespace coomer {
@@ -31,37 +37,139 @@ static GLuint compileShader(GLenum type, const char* source) {
     return shader;
 }
 
-bool RendererGL::compileShaders() {
-    GLuint vs = compileShader(GL_VERTEX_SHADER, kVertexShaderSource);
-    if (!vs) return false;
-    GLuint fs = compileShader(GL_FRAGMENT_SHADER, kFragmentShaderSource);
-    if (!fs) {
-        glDeleteShader(vs);
-        return false;
-    }
-
-    program_ = glCreateProgram();
-    glAttachShader(program_, vs);
-    glAttachShader(program_, fs);
-    glLinkProgram(program_);
-
-    glDeleteShader(vs);
+// Links vs and fs into a program; fs is deleted, vs stays usable for other
+// programs. Returns 0 on failure.
+static GLuint linkProgram(GLuint vs, GLuint fs) {
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDetachShader(program, vs);
     glDeleteShader(fs);
 
     GLint ok = 0;
-    glGetProgramiv(program_, GL_LINK_STATUS, &ok);
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
     if (!ok) {
         GLint len = 0;
-        glGetProgramiv(program_, GL_INFO_LOG_LENGTH, &len);
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len);
         std::vector<char> log(static_cast<size_t>(len));
-        glGetProgramInfoLog(program_, len, nullptr, log.data());
+        glGetProgramInfoLog(program, len, nullptr, log.data());
         LOG_ERROR("shader link failed: %s",
                   log.empty() ? "unknown" : log.data());
-        glDeleteProgram(program_);
-        program_ = 0;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+bool RendererGL::compileShaders() {
+    std::string vertexSource = buildVertexShaderSource(gles_);
+    vertexShader_ = compileShader(GL_VERTEX_SHADER, vertexSource.c_str());
+    if (!vertexShader_) {
         return false;
     }
-    return true;
+    // Build the motion variant up front so a broken driver fails at startup;
+    // everything else is compiled on first use.
+    return programFor(ShaderVariant{}) != nullptr;
+}
+
+const RendererGL::ShaderProgram* RendererGL::programFor(
+    const ShaderVariant& variant) {
+    auto it = programs_.find(variant.key());
+    if (it != programs_.end()) {
+        return it->second.program ? &it->second : nullptr;
+    }
+
+    // A failed variant is cached as program 0 so it is not retried per frame
+    ShaderProgram& entry = programs_[variant.key()];
+    std::string source = buildFragmentShaderSource(variant, gles_);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, source.c_str());
+    if (!fs) {
+        return nullptr;
+    }
+
+    GLuint program = linkProgram(vertexShader_, fs);
+    if (!program) {
+        return nullptr;
+    }
+
+    entry.program = program;
+    entry.locTex = glGetUniformLocation(program, "u_tex");
+    entry.locLut = glGetUniformLocation(program, "u_lut");
+    entry.locImageSize = glGetUniformLocation(program, "u_imageSize");
+    entry.locScreenSize = glGetUniformLocation(program, "u_screenSize");
+    entry.locPan = glGetUniformLocation(program, "u_pan");
+    entry.locZoom = glGetUniformLocation(program, "u_zoom");
+    entry.locCursor = glGetUniformLocation(program, "u_cursor");
+    entry.locRadius = glGetUniformLocation(program, "u_radius");
+    entry.locTint = glGetUniformLocation(program, "u_tint");
+
+    // Sampler bindings never change, so set them once at link time
+    glUseProgram(program);
+    glUniform1i(entry.locTex, 0);
+    glUniform1i(entry.locLut, 1);
+    glUseProgram(0);
+
+    LOG_DEBUG("compiled shader variant 0x%x", variant.key());
+    return &entry;
+}
+
+static float lanczosKernel(float x) {
+    const float a = 3.0f;
+    const float pi = 3.14159265358979f;
+    x = std::fabs(x);
+    if (x < 1e-5f) {
+        return 1.0f;
+    }
+    if (x >= a) {
+        return 0.0f;
+    }
+    float px = pi * x;
+    return a * std::sin(px) * std::sin(px / a) / (px * px);
+}
+
+void RendererGL::createLanczosLut() {
+    // One row per fractional phase, one column per tap. Each row is
+    // normalized so flat areas keep their brightness.
+    std::vector<float> weights(static_cast<size_t>(kLanczosPhases) *
+                               kLanczosTaps);
+    for (int phase = 0; phase < kLanczosPhases; ++phase) {
+        float f = static_cast<float>(phase) /
+                  static_cast<float>(kLanczosPhases - 1);
+        float* row = &weights[static_cast<size_t>(phase) * kLanczosTaps];
+        float sum = 0.0f;
+        for (int tap = 0; tap < kLanczosTaps; ++tap) {
+            row[tap] = lanczosKernel(static_cast<float>(tap - 2) - f);
+            sum += row[tap];
+        }
+        for (int tap = 0; tap < kLanczosTaps; ++tap) {
+            row[tap] /= sum;
+        }
+    }
+
+    glGenTextures(1, &lutTex_);
+    glBindTexture(GL_TEXTURE_2D, lutTex_);
+    // The LUT is only read with texelFetch; on ES half floats are plenty for
+    // the weights and halve the fetch bandwidth.
+    glTexImage2D(GL_TEXTURE_2D, 0, gles_ ? GL_R16F : GL_R32F, kLanczosTaps,
+                 kLanczosPhases, 0, GL_RED, GL_FLOAT, weights.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void RendererGL::createScreenshotTexture() {
+    glGenTextures(1, &tex_);
+    glBindTexture(GL_TEXTURE_2D, tex_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    storageW_ = 0;
+    storageH_ = 0;
 }
 
 bool RendererGL::initGL(std::function<void*(const char*)> loaderProc) {
@@ -83,10 +191,23 @@ bool RendererGL::initGL(std::function<void*(const char*)> loaderProc) {
         LOG_ERROR("gladLoadGL failed");
         return false;
     }
-    if (!GLAD_GL_VERSION_3_3) {
-        LOG_ERROR("OpenGL 3.3 core not available");
+    // glad parses "OpenGL ES 3.x" version strings as GL 3.x, so an ES 3.0
+    // context reports GLAD_GL_VERSION_3_0 and the shared 3.0 entry points.
+    const char* version =
+        reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    gles_ = version && std::strncmp(version, "OpenGL ES", 9) == 0;
+    if (gles_ ? !GLAD_GL_VERSION_3_0 : !GLAD_GL_VERSION_3_3) {
+        LOG_ERROR("%s not available (got %s)",
+                  gles_ ? "OpenGL ES 3.0" : "OpenGL 3.3 core",
+                  version ? version : "unknown");
         return false;
     }
+    LOG_DEBUG("GL version: %s", version);
+    if (gles_ && !glTexStorage2D) {
+        // Core in ES 3.0 but only loaded by glad for the ARB extension
+        glad_glTexStorage2D =
+            reinterpret_cast<PFNGLTEXSTORAGE2DPROC>(wrapper("glTexStorage2D"));
+    }
 
     if (!compileShaders()) {
         return false;
@@ -113,18 +234,14 @@ bool RendererGL::initGL(std::function<void*(const char*)> loaderProc) {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    glGenTextures(1, &tex_);
-    glBindTexture(GL_TEXTURE_2D, tex_);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    createScreenshotTexture();
+    createLanczosLut();
 
     return true;
 }
 
 bool RendererGL::uploadScreenshotTexture(const ImageRGBA& image) {
+    TRACE_ZONE("gl upload");
     if (image.w <= 0 || image.h <= 0 || image.rgba.empty()) {
         LOG_ERROR("invalid screenshot image");
         return false;
@@ -132,57 +249,417 @@ bool RendererGL::uploadScreenshotTexture(const ImageRGBA& image) {
     imageW_ = image.w;
     imageH_ = image.h;
 
+    if (!glTexStorage2D) {
+        glBindTexture(GL_TEXTURE_2D, tex_);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.w, image.h, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, image.rgba.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return true;
+    }
+
+    // Immutable single-level storage lets the driver skip mipmap
+    // completeness tracking; a size change needs a new texture object.
+    if (storageW_ != image.w || storageH_ != image.h) {
+        if (storageW_ > 0) {
+            glDeleteTextures(1, &tex_);
+            createScreenshotTexture();
+        }
+        glBindTexture(GL_TEXTURE_2D, tex_);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, image.w, image.h);
+        storageW_ = image.w;
+        storageH_ = image.h;
+    } else {
+        glBindTexture(GL_TEXTURE_2D, tex_);
+    }
+    GpuQuery* query = beginGpuQuery(GpuTiming::Stage::Upload);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.w, image.h, GL_RGBA,
+                    GL_UNSIGNED_BYTE, image.rgba.data());
+    endGpuQuery(query);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return true;
+}
+
+bool RendererGL::updateScreenshotTexture(const std::uint8_t* rgba,
+                                         int strideBytes,
+                                         const std::vector<ImageRect>& rects) {
+    TRACE_ZONE("gl update");
+    if (!tex_ || imageW_ <= 0 || imageH_ <= 0) {
+        LOG_ERROR("no screenshot texture to update");
+        return false;
+    }
+    if (!rgba || strideBytes < imageW_ * 4 || strideBytes % 4 != 0) {
+        LOG_ERROR("invalid texture update source (stride %d)", strideBytes);
+        return false;
+    }
+
+    std::vector<ImageRect> merged = coalesceRects(rects);
+    if (merged.empty()) {
+        return true;
+    }
+
     glBindTexture(GL_TEXTURE_2D, tex_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.w, image.h, 0, GL_RGBA,
-                 GL_UNSIGNED_BYTE, image.rgba.data());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, strideBytes / 4);
+    GpuQuery* query = beginGpuQuery(GpuTiming::Stage::Upload);
+    for (const ImageRect& rect : merged) {
+        int x0 = std::max(rect.x, 0);
+        int y0 = std::max(rect.y, 0);
+        int x1 = std::min(rect.x + rect.w, imageW_);
+        int y1 = std::min(rect.y + rect.h, imageH_);
+        if (x1 <= x0 || y1 <= y0) {
+            continue;
+        }
+        // Texture rows follow image rows, so the rect maps 1:1
+        const std::uint8_t* src = rgba +
+                                  static_cast<size_t>(y0) * strideBytes +
+                                  static_cast<size_t>(x0) * 4u;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x0, y0, x1 - x0, y1 - y0, GL_RGBA,
+                        GL_UNSIGNED_BYTE, src);
+    }
+    endGpuQuery(query);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     glBindTexture(GL_TEXTURE_2D, 0);
+    LOG_DEBUG("texture update: %zu rects (%zu after merge)", rects.size(),
+              merged.size());
     return true;
 }
 
 void RendererGL::renderFrame(const CameraState& camera,
-                             const SpotlightState& spotlight) {
-    if (!program_ || !tex_) {
+                             const SpotlightState& spotlight,
+                             FilterMode filter, const DamageRect* clip) {
+    TRACE_ZONE("gl render");
+    if (!tex_) {
+        return;
+    }
+    pollGpuQueries();
+
+    ShaderVariant variant;
+    variant.filter = filter;
+    variant.spotlight = spotlight.enabled;
+    // Only pay for the bounds test when part of the screen lies outside the
+    // image.
+    variant.clipBounds =
+        camera.panX > 0.0f || camera.panY > 0.0f ||
+        camera.panX + static_cast<float>(imageW_) * camera.zoom <
+            static_cast<float>(camera.screenW) ||
+        camera.panY + static_cast<float>(imageH_) * camera.zoom <
+            static_cast<float>(camera.screenH);
+    const ShaderProgram* prog = programFor(variant);
+    if (!prog) {
         return;
     }
 
     glViewport(0, 0, camera.screenW, camera.screenH);
     glDisable(GL_DEPTH_TEST);
+    if (clip) {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(clip->x, clip->y, clip->w, clip->h);
+    }
 
+    GpuQuery* query = beginGpuQuery(GpuTiming::Stage::Draw);
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glUseProgram(program_);
-
-    GLint locTex = glGetUniformLocation(program_, "u_tex");
-    GLint locImageSize = glGetUniformLocation(program_, "u_imageSize");
-    GLint locScreenSize = glGetUniformLocation(program_, "u_screenSize");
-    GLint locPan = glGetUniformLocation(program_, "u_pan");
-    GLint locZoom = glGetUniformLocation(program_, "u_zoom");
-    GLint locCursor = glGetUniformLocation(program_, "u_cursor");
-    GLint locRadius = glGetUniformLocation(program_, "u_radius");
-    GLint locTint = glGetUniformLocation(program_, "u_tint");
-    GLint locSpotlight = glGetUniformLocation(program_, "u_spotlight");
+    glUseProgram(prog->program);
 
-    glUniform1i(locTex, 0);
-    glUniform2f(locImageSize, static_cast<float>(imageW_),
+    glUniform2f(prog->locImageSize, static_cast<float>(imageW_),
                 static_cast<float>(imageH_));
-    glUniform2f(locScreenSize, static_cast<float>(camera.screenW),
+    glUniform2f(prog->locScreenSize, static_cast<float>(camera.screenW),
                 static_cast<float>(camera.screenH));
-    glUniform2f(locPan, camera.panX, camera.panY);
-    glUniform1f(locZoom, camera.zoom);
-    glUniform2f(locCursor, spotlight.cursorX, spotlight.cursorY);
-    glUniform1f(locRadius, spotlight.radiusPx);
-    glUniform4f(locTint, spotlight.tintR, spotlight.tintG, spotlight.tintB,
-                spotlight.tintA);
-    glUniform1i(locSpotlight, spotlight.enabled ? 1 : 0);
+    glUniform2f(prog->locPan, camera.panX, camera.panY);
+    glUniform1f(prog->locZoom, camera.zoom);
+    if (spotlight.enabled) {
+        glUniform2f(prog->locCursor, spotlight.cursorX, spotlight.cursorY);
+        glUniform1f(prog->locRadius, spotlight.radiusPx);
+        glUniform4f(prog->locTint, spotlight.tintR, spotlight.tintG,
+                    spotlight.tintB, spotlight.tintA);
+    }
 
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, lutTex_);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, tex_);
     glBindVertexArray(vao_);
     glDrawArrays(GL_TRIANGLES, 0, 6);
+    endGpuQuery(query);
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    if (clip) {
+        glDisable(GL_SCISSOR_TEST);
+    }
+}
+
+void RendererGL::setGpuTiming(bool enabled) {
+    if (enabled && (gles_ || !glQueryCounter)) {
+        // ES only has timestamps through EXT_disjoint_timer_query
+        LOG_DEBUG("GPU timer queries unavailable");
+        return;
+    }
+    if (enabled && gpuQueries_[0].begin == 0) {
+        for (GpuQuery& query : gpuQueries_) {
+            GLuint ids[2] = {0, 0};
+            glGenQueries(2, ids);
+            query.begin = ids[0];
+            query.end = ids[1];
+        }
+        // GL_TIMESTAMP counts nanoseconds on a clock of the GPU's own
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuClockOffset_ = nowSeconds() - static_cast<double>(gpuNow) * 1e-9;
+    }
+    gpuTiming_ = enabled;
+}
+
+std::vector<GpuTiming> RendererGL::takeGpuTimings() {
+    pollGpuQueries();
+    std::vector<GpuTiming> timings;
+    timings.swap(gpuTimings_);
+    return timings;
+}
+
+RendererGL::GpuQuery* RendererGL::beginGpuQuery(GpuTiming::Stage stage) {
+    if (!gpuTiming_ || gpuQueryCount_ == kGpuQueries) {
+        return nullptr;
+    }
+    GpuQuery& query =
+        gpuQueries_[(gpuQueryHead_ + gpuQueryCount_) % kGpuQueries];
+    query.stage = stage;
+    glQueryCounter(query.begin, GL_TIMESTAMP);
+    return &query;
+}
+
+void RendererGL::endGpuQuery(GpuQuery* query) {
+    if (!query) {
+        return;
+    }
+    glQueryCounter(query->end, GL_TIMESTAMP);
+    ++gpuQueryCount_;
+}
+
+void RendererGL::pollGpuQueries() {
+    while (gpuQueryCount_ > 0) {
+        const GpuQuery& query = gpuQueries_[gpuQueryHead_];
+        // Never wait: an unfinished query is retried on a later frame
+        GLint available = 0;
+        glGetQueryObjectiv(query.end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return;
+        }
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(query.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(query.end, GL_QUERY_RESULT, &end);
+        GpuTiming timing;
+        timing.stage = query.stage;
+        timing.start = gpuClockOffset_ + static_cast<double>(begin) * 1e-9;
+        timing.end = gpuClockOffset_ + static_cast<double>(end) * 1e-9;
+        gpuTrack_.event(timing.stage == GpuTiming::Stage::Upload ? "upload"
+                                                                 : "draw",
+                        timing.start, timing.end);
+        gpuTimings_.push_back(timing);
+        gpuQueryHead_ = (gpuQueryHead_ + 1) % kGpuQueries;
+        --gpuQueryCount_;
+    }
+}
+
+namespace {
+
+// The glyphs side by side, then one fully covered cell for solid quads
+constexpr int kHudAtlasWidth = (kHudGlyphCount + 1) * kHudGlyphWidth;
+constexpr float kHudSolidTexel = kHudGlyphCount * kHudGlyphWidth + 0.5f;
+
+struct HudColor {
+    float r, g, b, a;
+};
+
+constexpr HudColor kHudPanel{0.0f, 0.0f, 0.0f, 0.65f};
+constexpr HudColor kHudText{0.95f, 0.95f, 0.95f, 1.0f};
+constexpr HudColor kHudTarget{1.0f, 1.0f, 1.0f, 0.35f};
+constexpr HudColor kHudFastFrame{0.35f, 0.85f, 0.45f, 1.0f};
+constexpr HudColor kHudSlowFrame{0.95f, 0.3f, 0.25f, 1.0f};
+
+// Appends one instance: rect, atlas rect and color, matching the attribute
+// layout set up in initHud().
+void addHudQuad(std::vector<float>& quads, float x, float y, float w, float h,
+                float texX, float texY, float texW, float texH,
+                const HudColor& color) {
+    quads.insert(quads.end(), {x, y, w, h, texX, texY, texW, texH, color.r,
+                               color.g, color.b, color.a});
+}
+
+void addHudSolid(std::vector<float>& quads, float x, float y, float w,
+                 float h, const HudColor& color) {
+    addHudQuad(quads, x, y, w, h, kHudSolidTexel, 0.5f, 0.0f, 0.0f, color);
+}
+
+}  // namespace
+
+bool RendererGL::initHud() {
+    if (hudInitialized_) {
+        return hudProgram_ != 0;
+    }
+    hudInitialized_ = true;
+
+    std::string vsSource = buildHudShaderSource(kHudVertexShaderBody, gles_);
+    std::string fsSource = buildHudShaderSource(kHudFragmentShaderBody, gles_);
+    GLuint vs = compileShader(GL_VERTEX_SHADER, vsSource.c_str());
+    GLuint fs = vs ? compileShader(GL_FRAGMENT_SHADER, fsSource.c_str()) : 0;
+    if (!fs) {
+        glDeleteShader(vs);
+        return false;
+    }
+    hudProgram_ = linkProgram(vs, fs);
+    glDeleteShader(vs);
+    if (!hudProgram_) {
+        return false;
+    }
+    hudLocScreenSize_ = glGetUniformLocation(hudProgram_, "u_screenSize");
+    glUseProgram(hudProgram_);
+    glUniform1i(glGetUniformLocation(hudProgram_, "u_atlas"), 0);
+    glUseProgram(0);
+
+    std::vector<std::uint8_t> atlas(
+        static_cast<size_t>(kHudAtlasWidth) * kHudGlyphHeight, 255);
+    for (int glyph = 0; glyph < kHudGlyphCount; ++glyph) {
+        for (int row = 0; row < kHudGlyphHeight; ++row) {
+            for (int col = 0; col < kHudGlyphWidth; ++col) {
+                bool set = (kHudGlyphs[glyph][row] >>
+                            (kHudGlyphWidth - 1 - col)) &
+                           1u;
+                atlas[static_cast<size_t>(row) * kHudAtlasWidth +
+                      glyph * kHudGlyphWidth + col] = set ? 255 : 0;
+            }
+        }
+    }
+    glGenTextures(1, &hudAtlas_);
+    glBindTexture(GL_TEXTURE_2D, hudAtlas_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, kHudAtlasWidth, kHudGlyphHeight, 0,
+                 GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const float corners[] = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,
+                             0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+    glGenVertexArrays(1, &hudVao_);
+    glGenBuffers(1, &hudCornerVbo_);
+    glGenBuffers(1, &hudInstanceVbo_);
+    glBindVertexArray(hudVao_);
+    glBindBuffer(GL_ARRAY_BUFFER, hudCornerVbo_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float),
+                          reinterpret_cast<void*>(0));
+    glBindBuffer(GL_ARRAY_BUFFER, hudInstanceVbo_);
+    for (GLuint attrib = 1; attrib <= 3; ++attrib) {
+        glEnableVertexAttribArray(attrib);
+        glVertexAttribPointer(
+            attrib, 4, GL_FLOAT, GL_FALSE, 12 * sizeof(float),
+            reinterpret_cast<void*>((attrib - 1) * 4 * sizeof(float)));
+        glVertexAttribDivisor(attrib, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    return true;
+}
+
+bool RendererGL::renderHud(const HudInfo& hud, int screenW, int screenH) {
+    TRACE_ZONE("gl hud");
+    if (screenW <= 0 || screenH <= 0 || !initHud()) {
+        return false;
+    }
+
+    // Whole-pixel glyph scaling keeps the bitmap font sharp
+    const float scale = static_cast<float>(std::max(2, screenH / 540));
+    const float advance = (kHudGlyphWidth + 1) * scale;
+    const float lineHeight = (kHudGlyphHeight + 3) * scale;
+    const float pad = 4.0f * scale;
+    const float graphH = hud.frameTimes.empty() ? 0.0f : 24.0f * scale;
+
+    size_t columns = 0;
+    for (const std::string& line : hud.lines) {
+        columns = std::max(columns, line.size());
+    }
+    float contentW = std::max(static_cast<float>(columns) * advance,
+                              static_cast<float>(hud.frameTimes.size()) *
+                                  scale);
+    float textH = static_cast<float>(hud.lines.size()) * lineHeight;
+    float panelW = contentW + 2.0f * pad;
+    float panelH = textH + graphH + 2.0f * pad;
+
+    hudQuads_.clear();
+    addHudSolid(hudQuads_, pad, pad, panelW, panelH, kHudPanel);
+
+    float y = 2.0f * pad;
+    for (const std::string& line : hud.lines) {
+        float x = 2.0f * pad;
+        for (char c : line) {
+            // Spaces and characters outside the font only advance
+            int glyph = c - kHudFirstGlyph;
+            if (glyph > 0 && glyph < kHudGlyphCount) {
+                addHudQuad(hudQuads_, x, y, kHudGlyphWidth * scale,
+                           kHudGlyphHeight * scale,
+                           static_cast<float>(glyph * kHudGlyphWidth), 0.0f,
+                           kHudGlyphWidth, kHudGlyphHeight, kHudText);
+            }
+            x += advance;
+        }
+        y += lineHeight;
+    }
+
+    if (!hud.frameTimes.empty()) {
+        // The target frame time sits at half height; bars clip at twice it
+        float base = y + graphH;
+        float target = std::max(hud.targetFrameTime, 1e-4f);
+        float x = 2.0f * pad;
+        for (float frameTime : hud.frameTimes) {
+            float h = std::min(frameTime / (2.0f * target), 1.0f) * graphH;
+            addHudSolid(hudQuads_, x, base - h, scale, h,
+                        frameTime > 1.5f * target ? kHudSlowFrame
+                                                  : kHudFastFrame);
+            x += scale;
+        }
+        addHudSolid(hudQuads_, 2.0f * pad, base - graphH * 0.5f, contentW,
+                    std::max(1.0f, scale * 0.5f), kHudTarget);
+    }
+
+    glViewport(0, 0, screenW, screenH);
+    glEnable(GL_BLEND);
+    // Keep the destination alpha so an overlay stays opaque
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);
+    glUseProgram(hudProgram_);
+    glUniform2f(hudLocScreenSize_, static_cast<float>(screenW),
+                static_cast<float>(screenH));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hudAtlas_);
+    glBindVertexArray(hudVao_);
+    glBindBuffer(GL_ARRAY_BUFFER, hudInstanceVbo_);
+    glBufferData(GL_ARRAY_BUFFER,
+                 static_cast<GLsizeiptr>(hudQuads_.size() * sizeof(float)),
+                 hudQuads_.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6,
+                          static_cast<GLsizei>(hudQuads_.size() / 12));
     glBindVertexArray(0);
     glBindTexture(GL_TEXTURE_2D, 0);
     glUseProgram(0);
+    glDisable(GL_BLEND);
+    return true;
+}
+
+size_t RendererGL::textureBytes() const {
+    size_t bytes = static_cast<size_t>(imageW_) * imageH_ * 4u;
+    bytes += static_cast<size_t>(kLanczosTaps) * kLanczosPhases *
+             (gles_ ? 2u : 4u);
+    if (hudAtlas_) {
+        bytes += static_cast<size_t>(kHudAtlasWidth) * kHudGlyphHeight;
+    }
+    return bytes;
 }
 
 }  // namespace coomer
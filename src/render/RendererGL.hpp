@@ -1,46 +1,103 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <unordered_map>
+#include <vector>
 
-#include "capture/CaptureTypes.hpp"
+#include "platform/Trace.hpp"
+#include "render/IRenderer.hpp"
 
 namespace coomer {
 
-struct CameraState {
-    float zoom = 1.0f;
-    float panX = 0.0f;
-    float panY = 0.0f;
-    int screenW = 0;
-    int screenH = 0;
-};
+// Feature combination selecting one specialized fragment shader program.
+struct ShaderVariant {
+    FilterMode filter = FilterMode::Bilinear;
+    bool spotlight = false;
+    bool clipBounds = true;
 
-struct SpotlightState {
-    bool enabled = false;
-    float cursorX = 0.0f;
-    float cursorY = 0.0f;
-    float radiusPx = 160.0f;
-    float tintR = 0.0f;
-    float tintG = 0.0f;
-    float tintB = 0.0f;
-    float tintA = 0.75f;
+    unsigned int key() const {
+        return static_cast<unsigned int>(filter) | (spotlight ? 0x10u : 0u) |
+               (clipBounds ? 0x20u : 0u);
+    }
 };
 
-class RendererGL {
+class RendererGL final : public IRenderer {
 public:
     bool initGL(std::function<void*(const char*)> loaderProc);
-    bool uploadScreenshotTexture(const ImageRGBA& image);
-    void renderFrame(const CameraState& camera,
-                     const SpotlightState& spotlight);
+    bool uploadScreenshotTexture(const ImageRGBA& image) override;
+    bool updateScreenshotTexture(const std::uint8_t* rgba, int strideBytes,
+                                 const std::vector<ImageRect>& rects) override;
+    void renderFrame(const CameraState& camera, const SpotlightState& spotlight,
+                     FilterMode filter = FilterMode::Bilinear,
+                     const DamageRect* clip = nullptr) override;
+    void setGpuTiming(bool enabled) override;
+    std::vector<GpuTiming> takeGpuTimings() override;
+    bool renderHud(const HudInfo& hud, int screenW, int screenH) override;
+    size_t textureBytes() const override;
 
 private:
+    struct ShaderProgram {
+        unsigned int program = 0;
+        int locTex = -1;
+        int locLut = -1;
+        int locImageSize = -1;
+        int locScreenSize = -1;
+        int locPan = -1;
+        int locZoom = -1;
+        int locCursor = -1;
+        int locRadius = -1;
+        int locTint = -1;
+    };
+
     bool compileShaders();
-    unsigned int program_ = 0;
+    const ShaderProgram* programFor(const ShaderVariant& variant);
+    void createScreenshotTexture();
+    void createLanczosLut();
+    // Timestamp query pairs around uploads and draws. A full pool skips
+    // timing rather than waiting for results.
+    struct GpuQuery {
+        unsigned int begin = 0;
+        unsigned int end = 0;
+        GpuTiming::Stage stage = GpuTiming::Stage::Draw;
+    };
+    static constexpr size_t kGpuQueries = 8;
+    GpuQuery* beginGpuQuery(GpuTiming::Stage stage);
+    void endGpuQuery(GpuQuery* query);
+    void pollGpuQueries();
+    bool initHud();
+    unsigned int vertexShader_ = 0;
+    std::unordered_map<unsigned int, ShaderProgram> programs_;
     unsigned int vao_ = 0;
     unsigned int vbo_ = 0;
     unsigned int tex_ = 0;
+    unsigned int lutTex_ = 0;
     int imageW_ = 0;
     int imageH_ = 0;
+    // Size of the immutable texture storage, 0 until first allocated.
+    int storageW_ = 0;
+    int storageH_ = 0;
+    bool gles_ = false;
+    bool gpuTiming_ = false;
+    std::array<GpuQuery, kGpuQueries> gpuQueries_;
+    // Oldest slot; queries are issued and complete in ring order
+    size_t gpuQueryHead_ = 0;
+    size_t gpuQueryCount_ = 0;
+    // Added to GPU timestamps to land on the nowSeconds() clock
+    double gpuClockOffset_ = 0.0;
+    std::vector<GpuTiming> gpuTimings_;
+    TraceTrack gpuTrack_{"gpu"};
+    // HUD program and glyph atlas, created on first use
+    bool hudInitialized_ = false;
+    unsigned int hudProgram_ = 0;
+    int hudLocScreenSize_ = -1;
+    unsigned int hudVao_ = 0;
+    unsigned int hudCornerVbo_ = 0;
+    unsigned int hudInstanceVbo_ = 0;
+    unsigned int hudAtlas_ = 0;
+    std::vector<float> hudQuads_;
 };
 
 }  // namespace coomer
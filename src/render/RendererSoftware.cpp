@@ -0,0 +1,462 @@
+#include "render/RendererSoftware.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "platform/Log.hpp"
+#include "platform/ThreadPool.hpp"
+
+namespace coomer {
+
+namespace {
+
+constexpr std::uint32_t kOpaque = 0xFF000000u;
+constexpr std::uint32_t kOutsideColor = 0xFF000000u;
+// Same constant as GRID_MIN_ZOOM in the fragment shader.
+constexpr float kGridMinZoom = 6.0f;
+// Rows are handed to the pool in ranges of at least this many pixels.
+constexpr long long kMinPixelsPerThread = 128 * 1024;
+
+// Positions along a row are stepped in 32.32 fixed point so that even a 4K
+// row accumulates no visible drift.
+constexpr double kFixedOne = 4294967296.0;
+
+// (a * (256 - w) + b * w + 128) >> 8 per channel, two channels per multiply.
+inline std::uint32_t lerpPixel(std::uint32_t a, std::uint32_t b,
+                               std::uint32_t w) {
+    std::uint32_t iw = 256u - w;
+    std::uint32_t rb = (((a & 0x00FF00FFu) * iw + (b & 0x00FF00FFu) * w +
+                         0x00800080u) >>
+                        8) &
+                       0x00FF00FFu;
+    std::uint32_t ag = (((a >> 8) & 0x00FF00FFu) * iw +
+                        ((b >> 8) & 0x00FF00FFu) * w + 0x00800080u) &
+                       0xFF00FF00u;
+    return rb | ag;
+}
+
+#if defined(__SSE2__)
+// Same rounding as lerpPixel, on 16-bit channel lanes.
+inline __m128i lerpLanes(__m128i a, __m128i b, __m128i w) {
+    __m128i iw = _mm_sub_epi16(_mm_set1_epi16(256), w);
+    __m128i sum = _mm_add_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(a, iw), _mm_mullo_epi16(b, w)),
+        _mm_set1_epi16(128));
+    return _mm_srli_epi16(sum, 8);
+}
+
+#endif
+
+inline float smoothstep(float edge0, float edge1, float x) {
+    float t = std::clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+inline int fixedFloor(long long pos) {
+    return static_cast<int>(pos >> 32);
+}
+
+// Vertically interpolates two source rows for texels [xFirst, xLast],
+// clamping to the image edge like GL_CLAMP_TO_EDGE.
+void blendRows(const std::uint32_t* top, const std::uint32_t* bottom,
+               std::uint32_t fy, int xFirst, int xLast, int width,
+               std::uint32_t* dst) {
+    const int lastX = width - 1;
+    const int innerBegin = std::clamp(xFirst, 0, xLast + 1);
+    const int innerEnd = std::clamp(xLast + 1, innerBegin, width);
+    for (int x = xFirst; x < innerBegin; ++x) {
+        dst[x - xFirst] = lerpPixel(top[0], bottom[0], fy);
+    }
+    for (int x = std::max(innerEnd, xFirst); x <= xLast; ++x) {
+        dst[x - xFirst] = lerpPixel(top[lastX], bottom[lastX], fy);
+    }
+
+    std::uint32_t* out = dst + (innerBegin - xFirst);
+    const int count = innerEnd - innerBegin;
+    top += innerBegin;
+    bottom += innerBegin;
+    if (fy == 0) {
+        std::memcpy(out, top, static_cast<size_t>(count) * sizeof(*out));
+        return;
+    }
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w = _mm_set1_epi16(static_cast<short>(fy));
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + i));
+        __m128i b =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + i));
+        __m128i lo = lerpLanes(_mm_unpacklo_epi8(a, zero),
+                               _mm_unpacklo_epi8(b, zero), w);
+        __m128i hi = lerpLanes(_mm_unpackhi_epi8(a, zero),
+                               _mm_unpackhi_epi8(b, zero), w);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = lerpPixel(top[i], bottom[i], fy);
+    }
+}
+
+// Horizontal pass over a row produced by blendRows. pos is the 32.32 texel
+// coordinate of the first output pixel minus half a texel.
+void sampleRowLinear(const std::uint32_t* row, long long pos, long long inc,
+                     int xFirst, std::uint32_t* out, int count) {
+    int n = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; n + 4 <= count; n += 4) {
+        const long long p1 = pos + inc;
+        const long long p2 = p1 + inc;
+        const long long p3 = p2 + inc;
+        // Each 64-bit load holds a texel and its right neighbour
+        const std::uint32_t* r0 = row + (fixedFloor(pos) - xFirst);
+        const std::uint32_t* r1 = row + (fixedFloor(p1) - xFirst);
+        const std::uint32_t* r2 = row + (fixedFloor(p2) - xFirst);
+        const std::uint32_t* r3 = row + (fixedFloor(p3) - xFirst);
+        __m128i v01 = _mm_unpacklo_epi64(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(r0)),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(r1)));
+        __m128i v23 = _mm_unpacklo_epi64(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(r2)),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(r3)));
+        // (a0, b0, a1, b1) -> (a0, a1, b0, b1)
+        v01 = _mm_shuffle_epi32(v01, _MM_SHUFFLE(3, 1, 2, 0));
+        v23 = _mm_shuffle_epi32(v23, _MM_SHUFFLE(3, 1, 2, 0));
+
+        // Spread the four weights over the channel lanes of their pixel
+        __m128i fx = _mm_set_epi32(static_cast<int>((p3 >> 24) & 0xFF),
+                                   static_cast<int>((p2 >> 24) & 0xFF),
+                                   static_cast<int>((p1 >> 24) & 0xFF),
+                                   static_cast<int>((pos >> 24) & 0xFF));
+        fx = _mm_packs_epi32(fx, fx);
+        fx = _mm_unpacklo_epi16(fx, fx);
+        __m128i w01 = _mm_unpacklo_epi32(fx, fx);
+        __m128i w23 = _mm_unpackhi_epi32(fx, fx);
+
+        __m128i lo = lerpLanes(_mm_unpacklo_epi8(v01, zero),
+                               _mm_unpackhi_epi8(v01, zero), w01);
+        __m128i hi = lerpLanes(_mm_unpacklo_epi8(v23, zero),
+                               _mm_unpackhi_epi8(v23, zero), w23);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n),
+                         _mm_packus_epi16(lo, hi));
+        pos = p3 + inc;
+    }
+#endif
+    for (; n < count; ++n, pos += inc) {
+        int i = fixedFloor(pos) - xFirst;
+        std::uint32_t fx = static_cast<std::uint32_t>((pos >> 24) & 0xFF);
+        out[n] = lerpPixel(row[i], row[i + 1], fx);
+    }
+}
+
+void blendSpan(std::uint32_t* out, int count, std::uint32_t tint,
+               std::uint32_t weight) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i tintLanes =
+        _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(tint)), zero);
+    __m128i w = _mm_set1_epi16(static_cast<short>(weight));
+    for (; i + 4 <= count; i += 4) {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<__m128i*>(out + i));
+        __m128i lo = lerpLanes(_mm_unpacklo_epi8(px, zero), tintLanes, w);
+        __m128i hi = lerpLanes(_mm_unpackhi_epi8(px, zero), tintLanes, w);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = lerpPixel(out[i], tint, weight);
+    }
+}
+
+}  // namespace
+
+struct RendererSoftware::FrameParams {
+    SoftwareFramebuffer fb;
+    CameraState camera;
+    SpotlightState spotlight;
+    std::uint32_t tint = 0;
+    bool nearest = false;
+    int colBegin = 0;
+    int colEnd = 0;
+};
+
+bool RendererSoftware::init(
+    std::function<SoftwareFramebuffer()> acquireFramebuffer) {
+    if (!acquireFramebuffer) {
+        LOG_ERROR("software renderer needs a framebuffer source");
+        return false;
+    }
+    acquireFramebuffer_ = std::move(acquireFramebuffer);
+    LOG_DEBUG("software renderer: %u threads",
+              ThreadPool::workerCount() + 1);
+    return true;
+}
+
+bool RendererSoftware::uploadScreenshotTexture(const ImageRGBA& image) {
+    if (image.w <= 0 || image.h <= 0 || image.rgba.empty()) {
+        LOG_ERROR("invalid screenshot image");
+        return false;
+    }
+    if (!pixels_.allocate(static_cast<size_t>(image.w) * image.h *
+                          sizeof(std::uint32_t))) {
+        return false;
+    }
+    imageW_ = image.w;
+    imageH_ = image.h;
+    int grain = static_cast<int>(
+        std::max<long long>(kMinPixelsPerThread / imageW_, 1));
+    threadPool().parallelFor(0, imageH_, grain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            convertRgbaRow(
+                image.rgba.data() + static_cast<size_t>(y) * imageW_ * 4u,
+                imageRow(y), imageW_);
+        }
+    });
+    return true;
+}
+
+bool RendererSoftware::updateScreenshotTexture(
+    const std::uint8_t* rgba, int strideBytes,
+    const std::vector<ImageRect>& rects) {
+    if (pixels_.empty()) {
+        LOG_ERROR("no screenshot texture to update");
+        return false;
+    }
+    if (!rgba || strideBytes < imageW_ * 4) {
+        LOG_ERROR("invalid texture update source (stride %d)", strideBytes);
+        return false;
+    }
+    for (const ImageRect& rect : rects) {
+        int x0 = std::max(rect.x, 0);
+        int y0 = std::max(rect.y, 0);
+        int x1 = std::min(rect.x + rect.w, imageW_);
+        int y1 = std::min(rect.y + rect.h, imageH_);
+        for (int y = y0; y < y1 && x0 < x1; ++y) {
+            convertRgbaRow(
+                rgba + static_cast<size_t>(y) * strideBytes +
+                    static_cast<size_t>(x0) * 4u,
+                imageRow(y) + x0, x1 - x0);
+        }
+    }
+    return true;
+}
+
+void RendererSoftware::renderFrame(const CameraState& camera,
+                                   const SpotlightState& spotlight,
+                                   FilterMode filter, const DamageRect* clip) {
+    if (pixels_.empty() || !acquireFramebuffer_) {
+        return;
+    }
+    FrameParams params;
+    params.fb = acquireFramebuffer_();
+    if (!params.fb.pixels || params.fb.width <= 0 || params.fb.height <= 0) {
+        return;
+    }
+    params.camera = camera;
+    params.spotlight = spotlight;
+    params.nearest = (filter == FilterMode::Nearest);
+    auto channel = [](float v) {
+        return static_cast<std::uint32_t>(
+            std::lround(std::clamp(v, 0.0f, 1.0f) * 255.0f));
+    };
+    params.tint = kOpaque | (channel(spotlight.tintR) << 16) |
+                  (channel(spotlight.tintG) << 8) | channel(spotlight.tintB);
+
+    // Damage uses a bottom-left origin, the framebuffer is top-down
+    int rowBegin = 0;
+    int rowEnd = params.fb.height;
+    params.colBegin = 0;
+    params.colEnd = params.fb.width;
+    if (clip) {
+        params.colBegin = std::clamp(clip->x, 0, params.fb.width);
+        params.colEnd = std::clamp(clip->x + clip->w, 0, params.fb.width);
+        rowBegin =
+            std::clamp(params.fb.height - (clip->y + clip->h), 0,
+                       params.fb.height);
+        rowEnd = std::clamp(params.fb.height - clip->y, 0, params.fb.height);
+    }
+    int rows = rowEnd - rowBegin;
+    int cols = params.colEnd - params.colBegin;
+    if (rows <= 0 || cols <= 0) {
+        return;
+    }
+
+    int grain = static_cast<int>(
+        std::max<long long>(kMinPixelsPerThread / cols, 1));
+    threadPool().parallelFor(rowBegin, rowEnd, grain,
+                             [this, &params](int begin, int end) {
+                                 renderRows(params, begin, end);
+                             });
+}
+
+void RendererSoftware::renderRows(const FrameParams& params, int rowBegin,
+                                  int rowEnd) const {
+    const SoftwareFramebuffer& fb = params.fb;
+    const CameraState& camera = params.camera;
+    const SpotlightState& spotlight = params.spotlight;
+    const float zoom = camera.zoom > 0.0f ? camera.zoom : 1.0f;
+    const int colBegin = params.colBegin;
+    const int colEnd = params.colEnd;
+
+    // Columns whose pixel centers map inside the image, as in the shader's
+    // bounds test
+    const float imageRight = camera.panX + static_cast<float>(imageW_) * zoom;
+    const int insideBegin = std::clamp(
+        static_cast<int>(std::ceil(camera.panX - 0.5f)), colBegin, colEnd);
+    const int insideEnd = std::clamp(
+        static_cast<int>(std::floor(imageRight - 0.5f)) + 1, insideBegin,
+        colEnd);
+
+    const double step = kFixedOne / static_cast<double>(zoom);
+    const double firstTexelX =
+        (static_cast<double>(insideBegin) + 0.5 - camera.panX) / zoom;
+
+    const float gridStrength =
+        smoothstep(kGridMinZoom, kGridMinZoom * 1.5f, zoom) * 0.35f;
+    const bool grid = gridStrength > 0.0f;
+
+    const float feather = spotlightFeather(spotlight.radiusPx);
+    const float inner = spotlight.radiusPx;
+    const float outer = spotlight.radiusPx + feather;
+    const std::uint32_t fullTint = static_cast<std::uint32_t>(
+        std::lround(std::clamp(spotlight.tintA, 0.0f, 1.0f) * 256.0f));
+    std::vector<std::uint32_t> blended;
+
+    const long long firstPos = std::llround(firstTexelX * kFixedOne);
+    const long long inc = std::llround(step);
+
+    // Texel grid of the nearest filter, as in sampleNearestGrid. The
+    // distance to the closest vertical texel edge only depends on the
+    // column, so it is computed once; pixels further than one screen pixel
+    // from any edge are left alone.
+    std::vector<float> columnEdge;
+    std::vector<int> edgeColumns;
+    if (grid) {
+        columnEdge.resize(static_cast<size_t>(insideEnd - insideBegin));
+        long long pos = firstPos;
+        for (int col = insideBegin; col < insideEnd; ++col, pos += inc) {
+            float cellX = static_cast<float>(pos & 0xFFFFFFFFll) *
+                          static_cast<float>(1.0 / kFixedOne);
+            float edge = std::min(cellX, 1.0f - cellX) * zoom;
+            columnEdge[col - insideBegin] = edge;
+            if (edge < 1.0f) {
+                edgeColumns.push_back(col);
+            }
+        }
+    }
+    auto gridPixel = [gridStrength](std::uint32_t* out, float edge) {
+        std::uint32_t color = *out;
+        float line = 1.0f - edge * edge * (3.0f - 2.0f * edge);
+        // Rec. 601 luma > 0.5, scaled by 1000 * 255
+        std::uint32_t luma = 299u * ((color >> 16) & 0xFFu) +
+                             587u * ((color >> 8) & 0xFFu) +
+                             114u * (color & 0xFFu);
+        std::uint32_t gridColor = luma > 127500u ? kOpaque : 0xFFFFFFFFu;
+        *out = lerpPixel(color, gridColor,
+                         static_cast<std::uint32_t>(
+                             line * gridStrength * 256.0f + 0.5f));
+    };
+    auto drawGridRow = [&](std::uint32_t* out, float edgeY) {
+        if (edgeY < 1.0f) {
+            for (int col = insideBegin; col < insideEnd; ++col) {
+                gridPixel(out + col,
+                          std::min(columnEdge[col - insideBegin], edgeY));
+            }
+            return;
+        }
+        for (int col : edgeColumns) {
+            gridPixel(out + col, columnEdge[col - insideBegin]);
+        }
+    };
+
+    for (int row = rowBegin; row < rowEnd; ++row) {
+        std::uint32_t* out = fb.pixels + static_cast<size_t>(row) * fb.stride;
+        // Pixel center in the bottom-left origin used by the camera
+        const float screenY = static_cast<float>(fb.height - row) - 0.5f;
+        const float texelY =
+            static_cast<float>(imageH_) - (screenY - camera.panY) / zoom;
+
+        if (texelY < 0.0f || texelY > static_cast<float>(imageH_) ||
+            insideBegin >= insideEnd) {
+            std::fill(out + colBegin, out + colEnd, kOutsideColor);
+        } else {
+            std::fill(out + colBegin, out + insideBegin, kOutsideColor);
+            std::fill(out + insideEnd, out + colEnd, kOutsideColor);
+
+            if (params.nearest) {
+                const int y = std::clamp(static_cast<int>(std::floor(texelY)),
+                                         0, imageH_ - 1);
+                const std::uint32_t* src = imageRow(y);
+                long long pos = firstPos;
+                for (int col = insideBegin; col < insideEnd;
+                     ++col, pos += inc) {
+                    out[col] = src[std::clamp(fixedFloor(pos), 0, imageW_ - 1)];
+                }
+                if (grid) {
+                    const float cellY = texelY - std::floor(texelY);
+                    drawGridRow(out, std::min(cellY, 1.0f - cellY) * zoom);
+                }
+            } else {
+                const float py = texelY - 0.5f;
+                const float baseY = std::floor(py);
+                const std::uint32_t fy =
+                    static_cast<std::uint32_t>((py - baseY) * 256.0f);
+                const int y0 =
+                    std::clamp(static_cast<int>(baseY), 0, imageH_ - 1);
+                const int y1 =
+                    std::clamp(static_cast<int>(baseY) + 1, 0, imageH_ - 1);
+                const long long pos = firstPos - (1ll << 31);
+                const int count = insideEnd - insideBegin;
+                // Separable: blend the two source rows once for the texels
+                // this row touches, then interpolate horizontally
+                const int xFirst = fixedFloor(pos);
+                const int xLast = fixedFloor(pos + inc * (count - 1)) + 1;
+                blended.resize(static_cast<size_t>(xLast - xFirst + 1));
+                blendRows(imageRow(y0), imageRow(y1), fy, xFirst, xLast,
+                          imageW_, blended.data());
+                sampleRowLinear(blended.data(), pos, inc, xFirst,
+                                out + insideBegin, count);
+            }
+        }
+
+        if (!spotlight.enabled || fullTint == 0) {
+            continue;
+        }
+        // Outside the feathered circle the tint is constant; only the
+        // columns near the circle need the per-pixel distance.
+        const float dy = screenY - spotlight.cursorY;
+        const float centerX = spotlight.cursorX - 0.5f;
+        const float halfWidth =
+            std::sqrt(std::max(0.0f, outer * outer - dy * dy));
+        const int ringBegin = std::clamp(
+            static_cast<int>(std::ceil(centerX - halfWidth)), colBegin, colEnd);
+        const int ringEnd = std::clamp(
+            static_cast<int>(std::floor(centerX + halfWidth)) + 1, ringBegin,
+            colEnd);
+        blendSpan(out + colBegin, ringBegin - colBegin, params.tint, fullTint);
+        blendSpan(out + ringEnd, colEnd - ringEnd, params.tint, fullTint);
+        for (int col = ringBegin; col < ringEnd; ++col) {
+            float dx = static_cast<float>(col) - centerX;
+            float dist2 = dx * dx + dy * dy;
+            if (dist2 <= inner * inner) {
+                continue;
+            }
+            float edge = smoothstep(inner, outer, std::sqrt(dist2));
+            std::uint32_t weight = static_cast<std::uint32_t>(
+                spotlight.tintA * edge * 256.0f + 0.5f);
+            out[col] = lerpPixel(out[col], params.tint, weight);
+        }
+    }
+}
+
+}  // namespace coomer
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "render/IRenderer.hpp"
+#include "render/SoftwareFramebuffer.hpp"
+
+namespace coomer {
+
+// Renders the zoom/pan/spotlight composite on the CPU into a buffer owned
+// by the window. Only nearest and bilinear sampling are implemented; the
+// higher quality filters fall back to bilinear.
+class RendererSoftware final : public IRenderer {
+public:
+    // acquireFramebuffer returns the buffer the next frame is drawn into.
+    bool init(std::function<SoftwareFramebuffer()> acquireFramebuffer);
+    bool uploadScreenshotTexture(const ImageRGBA& image) override;
+    bool updateScreenshotTexture(const std::uint8_t* rgba, int strideBytes,
+                                 const std::vector<ImageRect>& rects) override;
+    void renderFrame(const CameraState& camera, const SpotlightState& spotlight,
+                     FilterMode filter = FilterMode::Bilinear,
+                     const DamageRect* clip = nullptr) override;
+    size_t imageBytes() const override {
+        return pixels_.capacity();
+    }
+
+private:
+    struct FrameParams;
+
+    void renderRows(const FrameParams& params, int rowBegin,
+                    int rowEnd) const;
+    std::uint32_t* imageRow(int y) {
+        return reinterpret_cast<std::uint32_t*>(pixels_.data()) +
+               static_cast<size_t>(y) * imageW_;
+    }
+    const std::uint32_t* imageRow(int y) const {
+        return reinterpret_cast<const std::uint32_t*>(pixels_.data()) +
+               static_cast<size_t>(y) * imageW_;
+    }
+
+    std::function<SoftwareFramebuffer()> acquireFramebuffer_;
+    // Screenshot converted to the framebuffer pixel format.
+    ImageBuffer pixels_;
+    int imageW_ = 0;
+    int imageH_ = 0;
+};
+
+}  // namespace coomer
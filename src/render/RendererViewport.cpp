@@ -0,0 +1,89 @@
+#include "render/RendererViewport.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "platform/Log.hpp"
+
+namespace coomer {
+
+bool RendererViewport::init(
+    std::function<SoftwareFramebuffer(int, int)> imageBuffer,
+    std::function<void(const ViewportSource&)> setSource) {
+    if (!imageBuffer || !setSource) {
+        LOG_ERROR("viewport renderer needs a window image buffer");
+        return false;
+    }
+    imageBuffer_ = std::move(imageBuffer);
+    setSource_ = std::move(setSource);
+    return true;
+}
+
+bool RendererViewport::uploadScreenshotTexture(const ImageRGBA& image) {
+    if (image.w <= 0 || image.h <= 0 || image.rgba.empty()) {
+        LOG_ERROR("invalid screenshot image");
+        return false;
+    }
+    SoftwareFramebuffer fb = imageBuffer_(image.w, image.h);
+    if (!fb.pixels) {
+        LOG_ERROR("failed to allocate viewport image");
+        return false;
+    }
+    imageW_ = image.w;
+    imageH_ = image.h;
+    for (int y = 0; y < imageH_; ++y) {
+        convertRgbaRow(
+            image.rgba.data() + static_cast<size_t>(y) * imageW_ * 4u,
+            fb.pixels + static_cast<size_t>(y) * fb.stride, imageW_);
+    }
+    return true;
+}
+
+bool RendererViewport::updateScreenshotTexture(
+    const std::uint8_t* rgba, int strideBytes,
+    const std::vector<ImageRect>& rects) {
+    if (imageW_ <= 0 || imageH_ <= 0) {
+        LOG_ERROR("no screenshot texture to update");
+        return false;
+    }
+    if (!rgba || strideBytes < imageW_ * 4) {
+        LOG_ERROR("invalid texture update source (stride %d)", strideBytes);
+        return false;
+    }
+    SoftwareFramebuffer fb = imageBuffer_(imageW_, imageH_);
+    if (!fb.pixels) {
+        return false;
+    }
+    for (const ImageRect& rect : rects) {
+        int x0 = std::max(rect.x, 0);
+        int y0 = std::max(rect.y, 0);
+        int x1 = std::min(rect.x + rect.w, imageW_);
+        int y1 = std::min(rect.y + rect.h, imageH_);
+        for (int y = y0; y < y1 && x0 < x1; ++y) {
+            convertRgbaRow(rgba + static_cast<size_t>(y) * strideBytes +
+                               static_cast<size_t>(x0) * 4u,
+                           fb.pixels + static_cast<size_t>(y) * fb.stride + x0,
+                           x1 - x0);
+        }
+    }
+    return true;
+}
+
+void RendererViewport::renderFrame(const CameraState& camera,
+                                   const SpotlightState&, FilterMode,
+                                   const DamageRect*) {
+    if (imageW_ <= 0 || imageH_ <= 0 || camera.zoom <= 0.0f) {
+        return;
+    }
+    // Invert screen = image * zoom + pan; the camera uses a bottom-left
+    // origin, the viewport source a top-left one.
+    double zoom = camera.zoom;
+    ViewportSource source;
+    source.w = camera.screenW / zoom;
+    source.h = camera.screenH / zoom;
+    source.x = -camera.panX / zoom;
+    source.y = imageH_ - (-camera.panY / zoom + source.h);
+    setSource_(source);
+}
+
+}  // namespace coomer
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "render/IRenderer.hpp"
+#include "render/SoftwareFramebuffer.hpp"
+
+namespace coomer {
+
+// Leaves zoom and pan to the compositor: the screenshot is copied once into
+// a window-owned buffer and each frame only selects the visible crop.
+// Filtering is up to the compositor and the spotlight is not drawn.
+class RendererViewport final : public IRenderer {
+public:
+    // imageBuffer returns the buffer holding the screenshot at the given
+    // size; setSource selects the part shown on the next swap.
+    bool init(std::function<SoftwareFramebuffer(int, int)> imageBuffer,
+              std::function<void(const ViewportSource&)> setSource);
+    bool uploadScreenshotTexture(const ImageRGBA& image) override;
+    bool updateScreenshotTexture(const std::uint8_t* rgba, int strideBytes,
+                                 const std::vector<ImageRect>& rects) override;
+    void renderFrame(const CameraState& camera, const SpotlightState& spotlight,
+                     FilterMode filter = FilterMode::Bilinear,
+                     const DamageRect* clip = nullptr) override;
+    // The window's shared memory buffer, also mapped by the compositor
+    size_t imageBytes() const override {
+        return static_cast<size_t>(imageW_) * imageH_ * 4u;
+    }
+
+private:
+    std::function<SoftwareFramebuffer(int, int)> imageBuffer_;
+    std::function<void(const ViewportSource&)> setSource_;
+    int imageW_ = 0;
+    int imageH_ = 0;
+};
+
+}  // namespace coomer
@@ -1,8 +1,28 @@
 #pragma once
 
+#include <string>
+
+#include "render/RendererGL.hpp"
+
 namespace coomer {
 
-static const char* kVertexShaderSource = R"(#version 330 core
+// Number of fractional phases stored per Lanczos tap in the weight LUT.
+static constexpr int kLanczosPhases = 64;
+// Lanczos-3 needs six taps per axis.
+static constexpr int kLanczosTaps = 6;
+
+// GLSL ES 3.00 defaults to mediump in fragment shaders, which is too coarse
+// for texel coordinates of large screenshots.
+static const char* kGlslHeaderCore = "#version 330 core\n";
+static const char* kGlslHeaderEs =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "precision highp int;\n"
+    "precision highp sampler2D;\n";
+
+// Shader bodies are written in the common subset of GLSL 3.30 and GLSL ES
+// 3.00; the build*Source() helpers prepend the matching #version line.
+static const char* kVertexShaderBody = R"(
 layout(location = 0) in vec2 a_pos;
 layout(location = 1) in vec2 a_uv;
 
@@ -14,10 +34,13 @@ void main() {
 }
 )";
 
-static const char* kFragmentShaderSource = R"(#version 330 core
+// Fragment shader body; buildFragmentShaderSource() prepends the feature
+// #defines of the requested variant.
+static const char* kFragmentShaderBody = R"(
 in vec2 v_uv;
 
 uniform sampler2D u_tex;
+uniform sampler2D u_lut;
 uniform vec2 u_imageSize;
 uniform vec2 u_screenSize;
 uniform vec2 u_pan;
@@ -25,31 +48,205 @@ uniform float u_zoom;
 uniform vec2 u_cursor;
 uniform float u_radius;
 uniform vec4 u_tint;
-uniform int u_spotlight;
 
 out vec4 FragColor;
 
+const float GRID_MIN_ZOOM = 6.0;
+
+#if !defined(FILTER_BILINEAR)
+vec4 fetchClamped(ivec2 p) {
+    ivec2 size = textureSize(u_tex, 0);
+    return texelFetch(u_tex, clamp(p, ivec2(0), size - 1), 0);
+}
+#endif
+
+#if defined(FILTER_NEAREST)
+vec4 sampleNearestGrid(vec2 texel) {
+    vec4 color = fetchClamped(ivec2(floor(texel)));
+    if (u_zoom >= GRID_MIN_ZOOM) {
+        // Distance to the closest texel border, in screen pixels.
+        vec2 cell = fract(texel);
+        vec2 edge = min(cell, 1.0 - cell) * u_zoom;
+        float line = 1.0 - smoothstep(0.0, 1.0, min(edge.x, edge.y));
+        float strength =
+            smoothstep(GRID_MIN_ZOOM, GRID_MIN_ZOOM * 1.5, u_zoom) * 0.35;
+        float luma = dot(color.rgb, vec3(0.299, 0.587, 0.114));
+        vec3 gridColor = vec3(luma > 0.5 ? 0.0 : 1.0);
+        color.rgb = mix(color.rgb, gridColor, line * strength);
+    }
+    return color;
+}
+#endif
+
+#if defined(FILTER_BICUBIC)
+// Catmull-Rom weights for taps at -1, 0, +1, +2.
+vec4 cubicWeights(float t) {
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return vec4(-0.5 * t3 + t2 - 0.5 * t, 1.5 * t3 - 2.5 * t2 + 1.0,
+                -1.5 * t3 + 2.0 * t2 + 0.5 * t, 0.5 * t3 - 0.5 * t2);
+}
+
+vec4 sampleBicubic(vec2 texel) {
+    vec2 p = texel - 0.5;
+    vec2 base = floor(p);
+    vec2 f = p - base;
+    vec4 wx = cubicWeights(f.x);
+    vec4 wy = cubicWeights(f.y);
+    ivec2 origin = ivec2(base) - 1;
+    vec4 sum = vec4(0.0);
+    for (int j = 0; j < 4; ++j) {
+        vec4 row = wx.x * fetchClamped(origin + ivec2(0, j)) +
+                   wx.y * fetchClamped(origin + ivec2(1, j)) +
+                   wx.z * fetchClamped(origin + ivec2(2, j)) +
+                   wx.w * fetchClamped(origin + ivec2(3, j));
+        sum += wy[j] * row;
+    }
+    return clamp(sum, 0.0, 1.0);
+}
+#endif
+
+#if defined(FILTER_LANCZOS)
+vec4 sampleLanczos(vec2 texel) {
+    vec2 p = texel - 0.5;
+    vec2 base = floor(p);
+    vec2 f = p - base;
+    ivec2 phase = ivec2(f * float(LUT_PHASES - 1) + 0.5);
+    float wx[6];
+    float wy[6];
+    for (int i = 0; i < 6; ++i) {
+        wx[i] = texelFetch(u_lut, ivec2(i, phase.x), 0).r;
+        wy[i] = texelFetch(u_lut, ivec2(i, phase.y), 0).r;
+    }
+    ivec2 origin = ivec2(base) - 2;
+    vec4 sum = vec4(0.0);
+    for (int j = 0; j < 6; ++j) {
+        vec4 row = vec4(0.0);
+        for (int i = 0; i < 6; ++i) {
+            row += wx[i] * fetchClamped(origin + ivec2(i, j));
+        }
+        sum += wy[j] * row;
+    }
+    return clamp(sum, 0.0, 1.0);
+}
+#endif
+
 void main() {
     vec2 screen = gl_FragCoord.xy;
     vec2 img = (screen - u_pan) / u_zoom;
     vec2 uv = img / u_imageSize;
     uv.y = 1.0 - uv.y;
+    vec2 texel = uv * u_imageSize;
+
+#if defined(FILTER_NEAREST)
+    vec4 color = sampleNearestGrid(texel);
+#elif defined(FILTER_BICUBIC)
+    vec4 color = sampleBicubic(texel);
+#elif defined(FILTER_LANCZOS)
+    vec4 color = sampleLanczos(texel);
+#else
     vec4 color = texture(u_tex, uv);
+#endif
 
+#if defined(CLIP_BOUNDS)
     if (uv.x < 0.0 || uv.x > 1.0 || uv.y < 0.0 || uv.y > 1.0) {
         color = vec4(0.0, 0.0, 0.0, 1.0);
     }
+#endif
 
-    if (u_spotlight == 1) {
-        float dist = distance(screen, u_cursor);
-        float feather = max(2.0, u_radius * 0.08);
-        float edge = smoothstep(u_radius, u_radius + feather, dist);
-        float tintAmount = u_tint.a * edge;
-        color.rgb = mix(color.rgb, u_tint.rgb, tintAmount);
-    }
+#if defined(SPOTLIGHT)
+    float dist = distance(screen, u_cursor);
+    float feather = max(2.0, u_radius * 0.08);
+    float edge = smoothstep(u_radius, u_radius + feather, dist);
+    float tintAmount = u_tint.a * edge;
+    color.rgb = mix(color.rgb, u_tint.rgb, tintAmount);
+#endif
 
     FragColor = color;
 }
 )";
 
+// HUD quads, one instance each: a rectangle in pixels from the top-left
+// corner, the atlas texels it shows and a color. Solid quads point at a
+// fully covered texel.
+static const char* kHudVertexShaderBody = R"(
+layout(location = 0) in vec2 a_corner;
+layout(location = 1) in vec4 a_rect;
+layout(location = 2) in vec4 a_texRect;
+layout(location = 3) in vec4 a_color;
+
+uniform vec2 u_screenSize;
+
+out vec2 v_texel;
+out vec4 v_color;
+
+void main() {
+    vec2 pos = a_rect.xy + a_corner * a_rect.zw;
+    v_texel = a_texRect.xy + a_corner * a_texRect.zw;
+    v_color = a_color;
+    gl_Position = vec4(pos.x / u_screenSize.x * 2.0 - 1.0,
+                       1.0 - pos.y / u_screenSize.y * 2.0, 0.0, 1.0);
+}
+)";
+
+static const char* kHudFragmentShaderBody = R"(
+in vec2 v_texel;
+in vec4 v_color;
+
+uniform sampler2D u_atlas;
+
+out vec4 FragColor;
+
+void main() {
+    float coverage = texelFetch(u_atlas, ivec2(v_texel), 0).r;
+    FragColor = vec4(v_color.rgb, v_color.a * coverage);
+}
+)";
+
+inline const char* filterDefine(FilterMode filter) {
+    switch (filter) {
+        case FilterMode::Nearest:
+            return "FILTER_NEAREST";
+        case FilterMode::Bilinear:
+            return "FILTER_BILINEAR";
+        case FilterMode::Bicubic:
+            return "FILTER_BICUBIC";
+        case FilterMode::Lanczos:
+            return "FILTER_LANCZOS";
+    }
+    return "FILTER_BILINEAR";
+}
+
+inline std::string buildVertexShaderSource(bool gles) {
+    std::string src = gles ? kGlslHeaderEs : kGlslHeaderCore;
+    src += kVertexShaderBody;
+    return src;
+}
+
+inline std::string buildHudShaderSource(const char* body, bool gles) {
+    std::string src = gles ? kGlslHeaderEs : kGlslHeaderCore;
+    src += body;
+    return src;
+}
+
+// Builds the fragment shader for one feature combination. Features are
+// resolved by the preprocessor, so a program only contains the code its
+// variant actually needs.
+inline std::string buildFragmentShaderSource(const ShaderVariant& variant,
+                                             bool gles) {
+    std::string src = gles ? kGlslHeaderEs : kGlslHeaderCore;
+    src += "#define ";
+    src += filterDefine(variant.filter);
+    src += " 1\n";
+    src += "#define LUT_PHASES " + std::to_string(kLanczosPhases) + "\n";
+    if (variant.spotlight) {
+        src += "#define SPOTLIGHT 1\n";
+    }
+    if (variant.clipBounds) {
+        src += "#define CLIP_BOUNDS 1\n";
+    }
+    src += kFragmentShaderBody;
+    return src;
+}
+
 }  // namespace coomer
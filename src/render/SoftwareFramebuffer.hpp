@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace coomer {
+
+// CPU-visible back buffer used by the software renderer. Pixels are
+// XRGB8888 (0xXXRRGGBB in native byte order), rows top to bottom.
+struct SoftwareFramebuffer {
+    std::uint32_t* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    // Distance between rows, in pixels.
+    int stride = 0;
+};
+
+// Crop of the screenshot shown when the compositor does the scaling, in
+// image pixels with a top-left origin.
+struct ViewportSource {
+    double x = 0.0;
+    double y = 0.0;
+    double w = 0.0;
+    double h = 0.0;
+};
+
+// Converts `width` RGBA8888 pixels to opaque XRGB8888.
+inline void convertRgbaRow(const std::uint8_t* src, std::uint32_t* dst,
+                           int width) {
+    for (int x = 0; x < width; ++x) {
+        std::uint32_t v;
+        std::memcpy(&v, src + static_cast<size_t>(x) * 4u, sizeof(v));
+        // RGBA bytes to 0xXXRRGGBB
+        dst[x] = 0xFF000000u | ((v & 0xFFu) << 16) | (v & 0xFF00u) |
+                 ((v >> 16) & 0xFFu);
+    }
+}
+
+}  // namespace coomer
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <EGL/egl.h>
+
+#include "platform/Log.hpp"
+
+namespace coomer {
+
+// Creates a context for the renderer on an initialized display. Desktop GL
+// 3.3 core is tried first unless `gles` is set; OpenGL ES 3.0 is used when
+// desktop GL is unavailable (e.g. Raspberry Pi and Mali drivers).
+inline bool createEglContext(EGLDisplay display, bool gles,
+                             EGLConfig* outConfig, EGLContext* outContext) {
+    struct Api {
+        EGLenum api;
+        EGLint renderableBit;
+        EGLint minor;
+        const char* name;
+    };
+    static const Api kApis[] = {
+        {EGL_OPENGL_API, EGL_OPENGL_BIT, 3, "OpenGL 3.3 core"},
+        {EGL_OPENGL_ES_API, EGL_OPENGL_ES3_BIT, 0, "OpenGL ES 3.0"},
+    };
+
+    for (const Api& api : kApis) {
+        if (gles && api.api == EGL_OPENGL_API) {
+            continue;
+        }
+        if (!eglBindAPI(api.api)) {
+            LOG_DEBUG("EGL: %s API not supported", api.name);
+            continue;
+        }
+
+        EGLint attribs[] = {EGL_SURFACE_TYPE,
+                            EGL_WINDOW_BIT,
+                            EGL_RED_SIZE,
+                            8,
+                            EGL_GREEN_SIZE,
+                            8,
+                            EGL_BLUE_SIZE,
+                            8,
+                            EGL_ALPHA_SIZE,
+                            8,
+                            EGL_RENDERABLE_TYPE,
+                            api.renderableBit,
+                            EGL_NONE};
+        EGLConfig config = nullptr;
+        EGLint numConfigs = 0;
+        if (!eglChooseConfig(display, attribs, &config, 1, &numConfigs) ||
+            numConfigs == 0) {
+            LOG_DEBUG("EGL: no %s config", api.name);
+            continue;
+        }
+
+        EGLint ctxAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3,
+                               EGL_CONTEXT_MINOR_VERSION, api.minor,
+                               EGL_NONE};
+        EGLContext context =
+            eglCreateContext(display, config, EGL_NO_CONTEXT, ctxAttribs);
+        if (context == EGL_NO_CONTEXT) {
+            LOG_DEBUG("EGL: %s context creation failed: 0x%x", api.name,
+                      eglGetError());
+            continue;
+        }
+
+        LOG_DEBUG("EGL: created %s context", api.name);
+        *outConfig = config;
+        *outContext = context;
+        return true;
+    }
+    LOG_ERROR("failed to create EGL context");
+    return false;
+}
+
+}  // namespace coomer
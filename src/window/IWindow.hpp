@@ -1,9 +1,37 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include "render/Damage.hpp"
+#include "render/SoftwareFramebuffer.hpp"
 
 namespace coomer {
 
+enum class PointerButton { Left, Right };
+
+// One pointer event, in the order the window system reported it.
+struct InputEvent {
+    enum class Type { Motion, Button, Wheel };
+    Type type = Type::Motion;
+    // When the event happened, from the compositor or X server timestamp
+    // converted to the nowSeconds() clock.
+    double time = 0.0;
+    // Motion: new position and movement in buffer pixels, relative to the
+    // view the pointer is over.
+    double x = 0.0;
+    double y = 0.0;
+    double dx = 0.0;
+    double dy = 0.0;
+    int view = 0;
+    // Button
+    PointerButton button = PointerButton::Left;
+    bool pressed = false;
+    // Wheel, in the units of InputState::wheelDelta
+    double wheel = 0.0;
+};
+
 struct InputState {
     double mouseX = 0.0;
     double mouseY = 0.0;
@@ -16,6 +44,20 @@ struct InputState {
     bool keyShift = false;
     bool keyQ = false;
     bool keyA = false;
+    // Presses of H since the previous poll, so a tap between two frames
+    // is not lost.
+    int keyHPresses = 0;
+    // View the pointer is over; mouseX/mouseY are relative to it.
+    int view = 0;
+    // Set when the window contents were lost or resized and must be redrawn
+    // even if nothing else changed.
+    bool exposed = false;
+    // When the latest input event was read (nowSeconds clock). Input is
+    // read on a separate thread and may be newer than the last frame.
+    double eventTime = 0.0;
+    // Pointer events since the previous poll, oldest first. The fields
+    // above are their sum and the resulting state.
+    std::vector<InputEvent> events;
 };
 
 struct WindowConfig {
@@ -25,18 +67,84 @@ struct WindowConfig {
     int y = 0;
     bool fullscreen = true;
     bool overlay = false;
+    // Present CPU-rendered frames through shared memory instead of creating
+    // a GL context.
+    bool software = false;
+    // Ask for an OpenGL ES 3.0 context instead of desktop GL (EGL only).
+    bool gles = false;
+    // Show the screenshot in a wl_shm buffer and let wp_viewporter do zoom
+    // and pan; no GL context is created.
+    bool viewporter = false;
+    // Outputs to cover with one view each (layer-shell only). Empty means a
+    // single view on the output chosen by the compositor.
+    std::vector<std::string> outputs;
+    // Trade tear-free output for latency: ask for async presentation (or
+    // compositor bypass on X11) and do not wait for vblank in swaps.
+    bool lowLatency = false;
     std::string title = "coomer";
 };
 
+// When a swapped frame reached the screen.
+struct FramePresentation {
+    // 1-based count of swaps on the window, including the frame's own.
+    std::uint64_t swap = 0;
+    // nowSeconds() clock.
+    double time = 0.0;
+    // Output refresh period in seconds, 0 if unknown.
+    double refresh = 0.0;
+    // How the frame was shown, when the window system says so: torn means
+    // without waiting for vblank, zeroCopy that the buffer was scanned out
+    // directly instead of being composited.
+    bool modeKnown = false;
+    bool torn = false;
+    bool zeroCopy = false;
+};
+
+struct WindowView {
+    // Output the view covers; empty when the window is not tied to one.
+    std::string output;
+    int width = 0;
+    int height = 0;
+};
+
 class IWindow {
 public:
     virtual ~IWindow() = default;
     virtual void pollEvents() = 0;
+    // Like pollEvents, but blocks up to timeoutMs when no events are queued.
+    virtual void waitEvents(int timeoutMs) = 0;
     virtual bool shouldClose() const = 0;
     virtual InputState input() const = 0;
+    // A window has one view per output it covers. The views share one GL
+    // context; size queries, buffer age, swaps and rendering apply to the
+    // selected view.
+    virtual int viewCount() const = 0;
+    virtual WindowView view(int index) const = 0;
+    virtual void selectView(int index) = 0;
+    // False while the view's last frame is still waiting to be shown, so
+    // each output is paced by its own frame clock.
+    virtual bool viewReady(int index) const = 0;
     virtual int width() const = 0;
     virtual int height() const = 0;
     virtual void swap() = 0;
+    // Presents the frame and tells the compositor only `damage` changed.
+    virtual void swapWithDamage(const DamageRect& damage) = 0;
+    // Age of the current back buffer in frames, or 0 when its contents are
+    // undefined and the whole frame must be redrawn.
+    virtual int bufferAge() = 0;
+    // Presentation times reported since the last call, oldest first. Frames
+    // the window system dropped or does not report on are missing.
+    virtual std::vector<FramePresentation> takePresentations() = 0;
+    // Back buffer to draw into for windows created with
+    // WindowConfig::software; empty otherwise. Valid until the next swap.
+    virtual SoftwareFramebuffer softwareFramebuffer() = 0;
+    // Buffer holding the full screenshot for windows created with
+    // WindowConfig::viewporter, (re)allocated at the given size; empty
+    // otherwise. The contents are sent to the compositor on the next swap.
+    virtual SoftwareFramebuffer viewportImage(int width, int height) = 0;
+    // Part of the viewport image shown on the next swap, scaled to the
+    // window by the compositor.
+    virtual void setViewportSource(const ViewportSource& source) = 0;
     virtual void* glGetProcAddress(const char* name) = 0;
 };
 
@@ -0,0 +1,111 @@
+#include "window/WaylandEventThread.hpp"
+
+#include <poll.h>
+
+#include <cerrno>
+
+#include "platform/Log.hpp"
+#include "platform/Time.hpp"
+#include "platform/Trace.hpp"
+
+namespace coomer {
+
+WaylandEventThread::WaylandEventThread(wl_display* display)
+    : display_(display), queue_(wl_display_create_queue(display)) {}
+
+WaylandEventThread::~WaylandEventThread() {
+    stop();
+    if (queue_) {
+        wl_event_queue_destroy(queue_);
+    }
+}
+
+void WaylandEventThread::start() {
+    if (!thread_.joinable()) {
+        thread_ = std::thread([this] { run(); });
+    }
+}
+
+void WaylandEventThread::stop() {
+    if (thread_.joinable()) {
+        stop_.signal();
+        thread_.join();
+    }
+}
+
+void WaylandEventThread::dispatchInput() {
+    TRACE_ZONE("dispatch input");
+    int count = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        count = wl_display_dispatch_queue_pending(display_, queue_);
+        if (count > 0) {
+            eventTime_ = nowSeconds();
+        }
+    }
+    if (count != 0) {
+        inputReady_.signal();
+    }
+}
+
+void WaylandEventThread::run() {
+    TRACE_THREAD("wayland input");
+    int displayFd = wl_display_get_fd(display_);
+    for (;;) {
+        while (wl_display_prepare_read_queue(display_, queue_) != 0) {
+            dispatchInput();
+        }
+        wl_display_flush(display_);
+
+        pollfd fds[2] = {{displayFd, POLLIN, 0}, {stop_.fd(), POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+            wl_display_cancel_read(display_);
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            wl_display_cancel_read(display_);
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            if (wl_display_read_events(display_) < 0) {
+                LOG_ERROR("Wayland: reading input events failed");
+                break;
+            }
+        } else {
+            wl_display_cancel_read(display_);
+            if (fds[0].revents & (POLLERR | POLLHUP)) {
+                break;
+            }
+        }
+        dispatchInput();
+    }
+    // Let the render thread notice a lost connection
+    inputReady_.signal();
+}
+
+bool WaylandEventThread::dispatchMain(int timeoutMs) {
+    while (wl_display_prepare_read(display_) != 0) {
+        if (wl_display_dispatch_pending(display_) < 0) {
+            return false;
+        }
+        timeoutMs = 0;
+    }
+    wl_display_flush(display_);
+
+    pollfd fds[2] = {{wl_display_get_fd(display_), POLLIN, 0},
+                     {inputReady_.fd(), POLLIN, 0}};
+    int ready = poll(fds, 2, timeoutMs);
+    if (ready > 0 && (fds[0].revents & POLLIN)) {
+        if (wl_display_read_events(display_) < 0) {
+            return false;
+        }
+    } else {
+        wl_display_cancel_read(display_);
+    }
+    if (fds[1].revents & POLLIN) {
+        inputReady_.drain();
+    }
+    return wl_display_dispatch_pending(display_) >= 0;
+}
+
+}  // namespace coomer
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <wayland-client.h>
+
+#include <mutex>
+#include <thread>
+
+#include "platform/WakeFd.hpp"
+
+namespace coomer {
+
+// Reads and dispatches the input event queue on its own thread, so pointer
+// and keyboard events keep flowing while the render thread is blocked in a
+// swap. Seat proxies are moved to queue(); everything else stays on the
+// default queue, which the render thread dispatches with dispatchMain().
+// Input listeners run with mutex() held.
+class WaylandEventThread {
+public:
+    explicit WaylandEventThread(wl_display* display);
+    ~WaylandEventThread();
+
+    WaylandEventThread(const WaylandEventThread&) = delete;
+    WaylandEventThread& operator=(const WaylandEventThread&) = delete;
+
+    wl_event_queue* queue() const {
+        return queue_;
+    }
+    std::mutex& mutex() {
+        return mutex_;
+    }
+    // Time (nowSeconds) the latest input event was dispatched; read with
+    // mutex() held.
+    double eventTime() const {
+        return eventTime_;
+    }
+
+    void start();
+    // Joins the thread; must be called before the seat proxies are
+    // destroyed.
+    void stop();
+    // Dispatches the default queue, waiting up to timeoutMs for events on
+    // it or for new input. Returns false once the connection is lost.
+    bool dispatchMain(int timeoutMs);
+
+private:
+    void run();
+    void dispatchInput();
+
+    wl_display* display_ = nullptr;
+    wl_event_queue* queue_ = nullptr;
+    std::thread thread_;
+    std::mutex mutex_;
+    WakeFd stop_;
+    WakeFd inputReady_;
+    double eventTime_ = 0.0;
+};
+
+}  // namespace coomer
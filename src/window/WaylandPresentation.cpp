@@ -0,0 +1,106 @@
+#include "window/WaylandPresentation.hpp"
+
+#include <time.h>
+
+#include <algorithm>
+
+#include "platform/Log.hpp"
+#include "presentation-time-client-protocol.h"
+
+namespace coomer {
+
+namespace {
+
+// Presentations kept for a caller that never takes them
+constexpr size_t kMaxPresented = 120;
+
+}  // namespace
+
+WaylandPresentation::~WaylandPresentation() {
+    for (auto& pending : pending_) {
+        wp_presentation_feedback_destroy(pending->feedback);
+    }
+    if (presentation_) {
+        wp_presentation_destroy(presentation_);
+    }
+}
+
+void WaylandPresentation::bind(wl_registry* registry, uint32_t name) {
+    presentation_ = static_cast<wp_presentation*>(
+        wl_registry_bind(registry, name, &wp_presentation_interface, 1));
+    static const wp_presentation_listener kListener = {handleClockId};
+    wp_presentation_add_listener(presentation_, &kListener, this);
+}
+
+void WaylandPresentation::handleClockId(void* data, wp_presentation*,
+                                        uint32_t clockId) {
+    auto* self = static_cast<WaylandPresentation*>(data);
+    // nowSeconds() is CLOCK_MONOTONIC
+    self->monotonic_ = (clockId == CLOCK_MONOTONIC);
+    LOG_DEBUG("presentation clock %u%s", clockId,
+              self->monotonic_ ? "" : " (not monotonic, ignored)");
+}
+
+void WaylandPresentation::request(wl_surface* surface) {
+    ++swaps_;
+    if (!presentation_ || !surface) {
+        return;
+    }
+    static const wp_presentation_feedback_listener kFeedbackListener = {
+        handleSyncOutput, handlePresented, handleDiscarded};
+    auto pending = std::make_unique<Pending>();
+    pending->owner = this;
+    pending->swap = swaps_;
+    pending->feedback = wp_presentation_feedback(presentation_, surface);
+    wp_presentation_feedback_add_listener(pending->feedback,
+                                          &kFeedbackListener, pending.get());
+    pending_.push_back(std::move(pending));
+}
+
+std::vector<FramePresentation> WaylandPresentation::take() {
+    std::vector<FramePresentation> out;
+    out.swap(presented_);
+    return out;
+}
+
+void WaylandPresentation::finish(Pending* pending) {
+    wp_presentation_feedback_destroy(pending->feedback);
+    pending_.erase(std::find_if(pending_.begin(), pending_.end(),
+                                [pending](const auto& p) {
+                                    return p.get() == pending;
+                                }));
+}
+
+void WaylandPresentation::handlePresented(void* data,
+                                          struct wp_presentation_feedback*,
+                                          uint32_t secHi, uint32_t secLo,
+                                          uint32_t nsec, uint32_t refresh,
+                                          uint32_t, uint32_t, uint32_t flags) {
+    auto* pending = static_cast<Pending*>(data);
+    WaylandPresentation* self = pending->owner;
+    // Timestamps in another clock domain cannot be compared with input
+    if (self->monotonic_) {
+        double sec = static_cast<double>(
+            (static_cast<std::uint64_t>(secHi) << 32) | secLo);
+        FramePresentation frame;
+        frame.swap = pending->swap;
+        frame.time = sec + nsec * 1e-9;
+        frame.refresh = refresh * 1e-9;
+        frame.modeKnown = true;
+        frame.torn = !(flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC);
+        frame.zeroCopy = (flags & WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY) != 0;
+        if (self->presented_.size() >= kMaxPresented) {
+            self->presented_.erase(self->presented_.begin());
+        }
+        self->presented_.push_back(frame);
+    }
+    self->finish(pending);
+}
+
+void WaylandPresentation::handleDiscarded(void* data,
+                                          struct wp_presentation_feedback*) {
+    auto* pending = static_cast<Pending*>(data);
+    pending->owner->finish(pending);
+}
+
+}  // namespace coomer
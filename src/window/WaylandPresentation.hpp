@@ -0,0 +1,61 @@
+#pragma once
+
+#include <wayland-client.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "window/IWindow.hpp"
+
+struct wp_presentation;
+struct wp_presentation_feedback;
+
+namespace coomer {
+
+// Counts the swaps of a window and collects wp_presentation feedback for
+// them. Works without the global too; take() then stays empty.
+class WaylandPresentation {
+public:
+    WaylandPresentation() = default;
+    ~WaylandPresentation();
+
+    WaylandPresentation(const WaylandPresentation&) = delete;
+    WaylandPresentation& operator=(const WaylandPresentation&) = delete;
+
+    // Binds the wp_presentation global and listens for the clock_id event
+    // sent right after binding; call before the display is dispatched again.
+    void bind(wl_registry* registry, uint32_t name);
+    // Counts a swap and asks for feedback on the next commit of `surface`;
+    // call right before the commit.
+    void request(wl_surface* surface);
+    std::vector<FramePresentation> take();
+
+private:
+    // `struct` is needed below: the protocol header also declares a
+    // function named wp_presentation_feedback.
+    struct Pending {
+        WaylandPresentation* owner = nullptr;
+        struct wp_presentation_feedback* feedback = nullptr;
+        std::uint64_t swap = 0;
+    };
+
+    void finish(Pending* pending);
+
+    static void handleClockId(void* data, wp_presentation*, uint32_t clockId);
+    static void handleSyncOutput(void*, struct wp_presentation_feedback*,
+                                 wl_output*) {}
+    static void handlePresented(void* data, struct wp_presentation_feedback*,
+                                uint32_t secHi, uint32_t secLo, uint32_t nsec,
+                                uint32_t refresh, uint32_t seqHi,
+                                uint32_t seqLo, uint32_t flags);
+    static void handleDiscarded(void* data, struct wp_presentation_feedback*);
+
+    wp_presentation* presentation_ = nullptr;
+    bool monotonic_ = false;
+    std::uint64_t swaps_ = 0;
+    std::vector<std::unique_ptr<Pending>> pending_;
+    std::vector<FramePresentation> presented_;
+};
+
+}  // namespace coomer
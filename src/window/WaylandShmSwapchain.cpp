@@ -0,0 +1,162 @@
+#include "window/WaylandShmSwapchain.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "platform/Log.hpp"
+#include "platform/ShmFile.hpp"
+
+namespace coomer {
+
+WaylandShmSwapchain::WaylandShmSwapchain(wl_display* display, wl_shm* shm)
+    : display_(display), shm_(shm) {}
+
+WaylandShmSwapchain::~WaylandShmSwapchain() {
+    for (auto& buffer : buffers_) {
+        release(buffer);
+    }
+}
+
+void WaylandShmSwapchain::resize(int width, int height) {
+    if (width == width_ && height == height_) {
+        return;
+    }
+    for (auto& buffer : buffers_) {
+        release(buffer);
+    }
+    width_ = width;
+    height_ = height;
+    stride_ = width * 4;
+    current_ = -1;
+}
+
+bool WaylandShmSwapchain::allocate(Buffer& buffer) {
+    size_t size = static_cast<size_t>(stride_) * static_cast<size_t>(height_);
+    int fd = createShmFile(size);
+    if (fd < 0) {
+        LOG_ERROR("shm swapchain: failed to create shm file");
+        return false;
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        LOG_ERROR("shm swapchain: failed to mmap shm");
+        close(fd);
+        return false;
+    }
+    wl_shm_pool* pool = wl_shm_create_pool(shm_, fd, static_cast<int>(size));
+    buffer.buffer = wl_shm_pool_create_buffer(
+        pool, 0, width_, height_, stride_, WL_SHM_FORMAT_XRGB8888);
+    wl_shm_pool_destroy(pool);
+    close(fd);
+    if (!buffer.buffer) {
+        munmap(data, size);
+        LOG_ERROR("shm swapchain: failed to create wl_buffer");
+        return false;
+    }
+    wl_buffer_add_listener(buffer.buffer, &bufferListener_, &buffer);
+    buffer.data = data;
+    buffer.size = size;
+    buffer.busy = false;
+    buffer.frame = 0;
+    return true;
+}
+
+void WaylandShmSwapchain::release(Buffer& buffer) {
+    if (buffer.buffer) {
+        wl_buffer_destroy(buffer.buffer);
+        buffer.buffer = nullptr;
+    }
+    if (buffer.data) {
+        munmap(buffer.data, buffer.size);
+        buffer.data = nullptr;
+    }
+    buffer.size = 0;
+    buffer.busy = false;
+    buffer.frame = 0;
+}
+
+SoftwareFramebuffer WaylandShmSwapchain::acquire() {
+    if (width_ <= 0 || height_ <= 0 || !shm_) {
+        return {};
+    }
+    while (current_ < 0) {
+        // Prefer the most recently presented free buffer: it needs the
+        // smallest repair.
+        int best = -1;
+        for (int i = 0; i < static_cast<int>(buffers_.size()); ++i) {
+            const Buffer& candidate = buffers_[i];
+            if (!candidate.buffer || candidate.busy) {
+                continue;
+            }
+            if (best < 0 || candidate.frame > buffers_[best].frame) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            for (auto& buffer : buffers_) {
+                if (!buffer.buffer) {
+                    if (!allocate(buffer)) {
+                        return {};
+                    }
+                    best = static_cast<int>(&buffer - buffers_.data());
+                    break;
+                }
+            }
+        }
+        if (best >= 0) {
+            current_ = best;
+            break;
+        }
+        // Every buffer is still held by the compositor
+        if (wl_display_dispatch(display_) < 0) {
+            return {};
+        }
+    }
+    Buffer& buffer = buffers_[current_];
+    return SoftwareFramebuffer{static_cast<std::uint32_t*>(buffer.data), width_,
+                               height_, stride_ / 4};
+}
+
+int WaylandShmSwapchain::bufferAge() {
+    if (!acquire().pixels) {
+        return 0;
+    }
+    const Buffer& buffer = buffers_[current_];
+    if (buffer.frame == 0) {
+        return 0;
+    }
+    return static_cast<int>(frameCount_ - buffer.frame + 1);
+}
+
+void WaylandShmSwapchain::present(wl_surface* surface,
+                                  const DamageRect* damage) {
+    if (current_ < 0 || !surface) {
+        return;
+    }
+    Buffer& buffer = buffers_[current_];
+    wl_surface_attach(surface, buffer.buffer, 0, 0);
+    if (damage) {
+        DamageRect full{0, 0, width_, height_};
+        DamageRect rect = intersectDamage(*damage, full);
+        if (!rect.empty()) {
+            wl_surface_damage_buffer(surface, rect.x,
+                                     height_ - (rect.y + rect.h), rect.w,
+                                     rect.h);
+        }
+    } else {
+        wl_surface_damage_buffer(surface, 0, 0, width_, height_);
+    }
+    wl_surface_commit(surface);
+    buffer.busy = true;
+    buffer.frame = ++frameCount_;
+    current_ = -1;
+}
+
+void WaylandShmSwapchain::handleRelease(void* data, wl_buffer*) {
+    auto* buffer = static_cast<Buffer*>(data);
+    buffer->busy = false;
+}
+
+}  // namespace coomer
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <wayland-client.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "render/Damage.hpp"
+#include "render/SoftwareFramebuffer.hpp"
+
+namespace coomer {
+
+// Small set of wl_shm buffers the software renderer draws into. A buffer is
+// reused once the compositor releases it; its age is tracked so only the
+// damaged region has to be redrawn.
+class WaylandShmSwapchain {
+public:
+    WaylandShmSwapchain(wl_display* display, wl_shm* shm);
+    ~WaylandShmSwapchain();
+
+    WaylandShmSwapchain(const WaylandShmSwapchain&) = delete;
+    WaylandShmSwapchain& operator=(const WaylandShmSwapchain&) = delete;
+
+    // Buffers are reallocated lazily at the new size.
+    void resize(int width, int height);
+    // Buffer for the next frame; stays the same until present().
+    SoftwareFramebuffer acquire();
+    // Age of the buffer acquire() returns, 0 when its contents are undefined.
+    int bufferAge();
+    // Attaches and commits the acquired buffer. damage uses a bottom-left
+    // origin like DamageRect elsewhere; nullptr damages the whole buffer.
+    void present(wl_surface* surface, const DamageRect* damage);
+
+private:
+    struct Buffer {
+        wl_buffer* buffer = nullptr;
+        void* data = nullptr;
+        size_t size = 0;
+        bool busy = false;
+        // Frame number of the last present, 0 if never presented
+        std::uint64_t frame = 0;
+    };
+
+    bool allocate(Buffer& buffer);
+    void release(Buffer& buffer);
+    static void handleRelease(void* data, wl_buffer* buffer);
+
+    static inline wl_buffer_listener bufferListener_ = {handleRelease};
+
+    wl_display* display_ = nullptr;
+    wl_shm* shm_ = nullptr;
+    std::array<Buffer, 3> buffers_{};
+    int width_ = 0;
+    int height_ = 0;
+    int stride_ = 0;
+    int current_ = -1;
+    std::uint64_t frameCount_ = 0;
+};
+
+}  // namespace coomer
@@ -0,0 +1,108 @@
+#include "window/WaylandViewportImage.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "platform/Log.hpp"
+#include "platform/ShmFile.hpp"
+#include "viewporter-client-protocol.h"
+
+namespace coomer {
+
+WaylandViewportImage::WaylandViewportImage(wl_shm* shm) : shm_(shm) {}
+
+WaylandViewportImage::~WaylandViewportImage() {
+    release();
+}
+
+bool WaylandViewportImage::allocate(int width, int height) {
+    int stride = width * 4;
+    size_t size = static_cast<size_t>(stride) * static_cast<size_t>(height);
+    int fd = createShmFile(size);
+    if (fd < 0) {
+        LOG_ERROR("viewport image: failed to create shm file");
+        return false;
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        LOG_ERROR("viewport image: failed to mmap shm");
+        close(fd);
+        return false;
+    }
+    wl_shm_pool* pool = wl_shm_create_pool(shm_, fd, static_cast<int>(size));
+    buffer_ = wl_shm_pool_create_buffer(pool, 0, width, height, stride,
+                                        WL_SHM_FORMAT_XRGB8888);
+    wl_shm_pool_destroy(pool);
+    close(fd);
+    if (!buffer_) {
+        munmap(data, size);
+        LOG_ERROR("viewport image: failed to create wl_buffer");
+        return false;
+    }
+    data_ = data;
+    size_ = size;
+    width_ = width;
+    height_ = height;
+    source_ = ViewportSource{0.0, 0.0, static_cast<double>(width),
+                             static_cast<double>(height)};
+    return true;
+}
+
+void WaylandViewportImage::release() {
+    if (buffer_) {
+        wl_buffer_destroy(buffer_);
+        buffer_ = nullptr;
+    }
+    if (data_) {
+        munmap(data_, size_);
+        data_ = nullptr;
+    }
+    size_ = 0;
+    width_ = 0;
+    height_ = 0;
+}
+
+SoftwareFramebuffer WaylandViewportImage::image(int width, int height) {
+    if (width <= 0 || height <= 0 || !shm_) {
+        return {};
+    }
+    if (width != width_ || height != height_) {
+        release();
+        if (!allocate(width, height)) {
+            return {};
+        }
+    }
+    dirty_ = true;
+    return SoftwareFramebuffer{static_cast<std::uint32_t*>(data_), width_,
+                               height_, width_};
+}
+
+void WaylandViewportImage::setSource(const ViewportSource& source) {
+    // The protocol rejects a source rectangle outside the buffer
+    double w = std::clamp(source.w, 1.0, static_cast<double>(width_));
+    double h = std::clamp(source.h, 1.0, static_cast<double>(height_));
+    source_.x = std::clamp(source.x, 0.0, width_ - w);
+    source_.y = std::clamp(source.y, 0.0, height_ - h);
+    source_.w = w;
+    source_.h = h;
+}
+
+void WaylandViewportImage::present(wl_surface* surface, wp_viewport* viewport) {
+    if (!buffer_ || !surface || !viewport) {
+        return;
+    }
+    if (dirty_) {
+        wl_surface_attach(surface, buffer_, 0, 0);
+        dirty_ = false;
+    }
+    wp_viewport_set_source(viewport, wl_fixed_from_double(source_.x),
+                           wl_fixed_from_double(source_.y),
+                           wl_fixed_from_double(source_.w),
+                           wl_fixed_from_double(source_.h));
+    wl_surface_damage_buffer(surface, 0, 0, width_, height_);
+    wl_surface_commit(surface);
+}
+
+}  // namespace coomer
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <wayland-client.h>
+
+#include <cstddef>
+
+#include "render/SoftwareFramebuffer.hpp"
+
+struct wp_viewport;
+
+namespace coomer {
+
+// The whole screenshot in one wl_shm buffer. Zoom and pan only change the
+// wp_viewport source rectangle, so the compositor does all the scaling and
+// the buffer is uploaded once.
+class WaylandViewportImage {
+public:
+    explicit WaylandViewportImage(wl_shm* shm);
+    ~WaylandViewportImage();
+
+    WaylandViewportImage(const WaylandViewportImage&) = delete;
+    WaylandViewportImage& operator=(const WaylandViewportImage&) = delete;
+
+    // Buffer to write the image into; reallocated when the size changes.
+    // The buffer is re-attached on the next present().
+    SoftwareFramebuffer image(int width, int height);
+    void setSource(const ViewportSource& source);
+    // Applies the source rectangle and commits the surface.
+    void present(wl_surface* surface, wp_viewport* viewport);
+
+private:
+    bool allocate(int width, int height);
+    void release();
+
+    wl_shm* shm_ = nullptr;
+    wl_buffer* buffer_ = nullptr;
+    void* data_ = nullptr;
+    size_t size_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    ViewportSource source_;
+    bool dirty_ = false;
+};
+
+}  // namespace coomer
@@ -2,7 +2,6 @@
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
-#include <poll.h>
 #include <sys/mman.h>
 #include <unistd.h>
 #include <wayland-client.h>
@@ -12,10 +11,23 @@
 #include <algorithm>
 #include <cstring>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include "fractional-scale-v1-client-protocol.h"
+#include "platform/DisplayConnection.hpp"
 #include "platform/Log.hpp"
+#include "platform/StringUtil.hpp"
+#include "platform/Time.hpp"
+#include "presentation-time-client-protocol.h"
+#include "tearing-control-v1-client-protocol.h"
 #include "viewporter-client-protocol.h"
+#include "window/EglContext.hpp"
+#include "window/WaylandEventThread.hpp"
+#include "window/WaylandPresentation.hpp"
+#include "window/WaylandShmSwapchain.hpp"
+#include "window/WaylandViewportImage.hpp"
 #define namespace wl_namespace
 #include "wlr-layer-shell-unstable-v1-client-protocol.h"
 #undef namespace
@@ -31,175 +43,89 @@ namespace coomer {
 
 class WaylandWindowLayerShellEgl final : public IWindow {
 public:
-    explicit WaylandWindowLayerShellEgl(const WindowConfig& config) {
-        surfaceWidth_ = std::max(1, config.width);
-        surfaceHeight_ = std::max(1, config.height);
-        width_ = surfaceWidth_;
-        height_ = surfaceHeight_;
-
-        display_ = wl_display_connect(nullptr);
+    WaylandWindowLayerShellEgl(const WindowConfig& config,
+                               DisplayConnection& connection)
+        : connection_(connection) {
+        display_ = connection.wayland();
         if (!display_) {
             LOG_ERROR("failed to connect to Wayland display");
             return;
         }
-
-        registry_ = wl_display_get_registry(display_);
-        wl_registry_add_listener(registry_, &registryListener_, this);
-        wl_display_roundtrip(display_);
+        eventThread_ = std::make_unique<WaylandEventThread>(display_);
+        presentation_ = std::make_unique<WaylandPresentation>();
+        lowLatency_ = config.lowLatency;
+
+        // The connection already holds the globals; no roundtrip needed
+        for (const auto& global : connection.waylandGlobals()) {
+            bindGlobal(connection.waylandRegistry(), global.name,
+                       global.interface.c_str(), global.version);
+        }
 
         if (!compositor_ || !layerShell_) {
             LOG_ERROR("Wayland compositor or layer-shell missing");
             return;
         }
-
-        surface_ = wl_compositor_create_surface(compositor_);
-        if (!surface_) {
-            LOG_ERROR("failed to create Wayland surface");
-            return;
-        }
-        if (viewporter_) {
-            viewport_ = wp_viewporter_get_viewport(viewporter_, surface_);
-        }
-        if (fractionalScaleManager_) {
-            fractionalScale_ = wp_fractional_scale_manager_v1_get_fractional_scale(
-                fractionalScaleManager_, surface_);
-            wp_fractional_scale_v1_add_listener(fractionalScale_,
-                                                &fractionalScaleListener_, this);
-        }
-
-        layerSurface_ = zwlr_layer_shell_v1_get_layer_surface(
-            layerShell_, surface_, nullptr, ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY,
-            "coomer");
-        if (!layerSurface_) {
-            LOG_ERROR("failed to create layer surface");
-            return;
-        }
-        zwlr_layer_surface_v1_add_listener(layerSurface_,
-                                           &layerSurfaceListener_, this);
-        // Let the compositor choose the full output size when anchored to all
-        // edges.
-        zwlr_layer_surface_v1_set_size(layerSurface_, 0, 0);
-        zwlr_layer_surface_v1_set_anchor(
-            layerSurface_, ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP |
-                               ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM |
-                               ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT |
-                               ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT);
-        // Extend underneath panels (e.g. waybar) instead of avoiding their
-        // exclusive zone.
-        zwlr_layer_surface_v1_set_exclusive_zone(layerSurface_, -1);
-        zwlr_layer_surface_v1_set_keyboard_interactivity(
-            layerSurface_,
-            ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_EXCLUSIVE);
-
-        wl_surface_commit(surface_);
-        wl_display_roundtrip(display_);
-        if (!configured_) {
-            wl_display_roundtrip(display_);
+        if (lowLatency_ && !tearingControlManager_) {
+            LOG_WARN("layer-shell: no tearing control, frames stay vsynced");
         }
-        if (!configured_) {
-            LOG_WARN("layer-shell: no initial configure received");
-        }
-        updateBufferGeometry();
-
-        eglWindow_ = wl_egl_window_create(surface_, width_, height_);
-        if (!eglWindow_) {
-            LOG_ERROR("failed to create wl_egl_window");
-            return;
-        }
-
-        eglDisplay_ =
-            eglGetDisplay(reinterpret_cast<EGLNativeDisplayType>(display_));
-        if (eglDisplay_ == EGL_NO_DISPLAY) {
-            LOG_ERROR("failed to get EGL display");
-            return;
-        }
-        if (!eglInitialize(eglDisplay_, nullptr, nullptr)) {
-            LOG_ERROR("failed to initialize EGL");
-            return;
-        }
-        eglBindAPI(EGL_OPENGL_API);
-
-        EGLint attribs[] = {EGL_SURFACE_TYPE,
-                            EGL_WINDOW_BIT,
-                            EGL_RED_SIZE,
-                            8,
-                            EGL_GREEN_SIZE,
-                            8,
-                            EGL_BLUE_SIZE,
-                            8,
-                            EGL_ALPHA_SIZE,
-                            8,
-                            EGL_RENDERABLE_TYPE,
-                            EGL_OPENGL_BIT,
-                            EGL_NONE};
-
-        EGLConfig eglConfig = nullptr;
-        EGLint numConfigs = 0;
-        if (!eglChooseConfig(eglDisplay_, attribs, &eglConfig, 1,
-                             &numConfigs) ||
-            numConfigs == 0) {
-            LOG_ERROR("failed to choose EGL config");
-            return;
-        }
-
-        EGLint ctxAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3,
-                               EGL_CONTEXT_MINOR_VERSION, 3, EGL_NONE};
-        eglContext_ = eglCreateContext(eglDisplay_, eglConfig, EGL_NO_CONTEXT,
-                                       ctxAttribs);
-        if (eglContext_ == EGL_NO_CONTEXT) {
-            LOG_ERROR("failed to create EGL context");
-            return;
+        // The CPU presentation paths draw into a single surface
+        size_t maxViews = (config.software || config.viewporter)
+                              ? 1
+                              : config.outputs.size();
+        for (const std::string& name : config.outputs) {
+            if (views_.size() >= maxViews) {
+                LOG_WARN("layer-shell: one view per output needs GL");
+                break;
+            }
+            wl_output* output = findOutput(name);
+            if (!output) {
+                LOG_WARN("layer-shell: output %s not found", name.c_str());
+                continue;
+            }
+            if (!createView(output, name, config)) {
+                return;
+            }
         }
-
-        eglSurface_ = eglCreateWindowSurface(
-            eglDisplay_, eglConfig,
-            reinterpret_cast<EGLNativeWindowType>(eglWindow_), nullptr);
-        if (eglSurface_ == EGL_NO_SURFACE) {
-            LOG_ERROR("failed to create EGL window surface");
+        if (views_.empty() && !createView(nullptr, std::string(), config)) {
             return;
         }
-
-        if (!eglMakeCurrent(eglDisplay_, eglSurface_, eglSurface_,
-                            eglContext_)) {
-            LOG_ERROR("eglMakeCurrent failed");
-            return;
+        current_ = views_.front().get();
+        createTime_ = nowSeconds();
+
+        // Buffers and the GL context are set up at the requested size while
+        // the configure events are on their way; views report ready through
+        // viewReady() once configured.
+        for (auto& view : views_) {
+            updateBufferGeometry(*view);
         }
 
-        // CRITICAL: Commit an initial frame to ensure the compositor receives a
-        // buffer. Without this, some compositors (e.g., niri) may not schedule
-        // frame callbacks, causing the surface to appear "stuck". We skip
-        // glClear to avoid black flash.
-        if (surface_) {
-            // Damage and request frame callback before swap
-            wl_surface_damage_buffer(surface_, 0, 0, width_, height_);
-            frameCallback_ = wl_surface_frame(surface_);
-            wl_callback_add_listener(frameCallback_, &frameListener_, this);
-
-            // Swap without clearing - EGL provides a valid buffer, first real
-            // frame from main loop will immediately overwrite this
-            if (!eglSwapBuffers(eglDisplay_, eglSurface_)) {
-                EGLint err = eglGetError();
-                LOG_WARN("layer-shell initial eglSwapBuffers failed: 0x%x",
-                         err);
+        if (config.viewporter) {
+            if (!shm_ || !current_->viewport) {
+                LOG_ERROR("layer-shell: wl_shm or wp_viewporter missing");
+                return;
             }
-            wl_display_flush(display_);
-            LOG_DEBUG("layer-shell: initial frame committed");
+            viewportImage_ = std::make_unique<WaylandViewportImage>(shm_);
+        } else if (config.software) {
+            if (!shm_) {
+                LOG_ERROR("layer-shell: wl_shm missing");
+                return;
+            }
+            swapchain_ = std::make_unique<WaylandShmSwapchain>(display_, shm_);
+            swapchain_->resize(current_->width, current_->height);
+        } else if (!initEgl(config.gles)) {
+            return;
         }
+        LOG_DEBUG("layer-shell: %zu view(s)", views_.size());
 
         xkbContext_ = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
 
+        eventThread_->start();
         valid_ = true;
     }
 
     ~WaylandWindowLayerShellEgl() override {
-        if (frameCallback_) {
-            wl_callback_destroy(frameCallback_);
-        }
-        if (fractionalScale_) {
-            wp_fractional_scale_v1_destroy(fractionalScale_);
-        }
-        if (viewport_) {
-            wp_viewport_destroy(viewport_);
+        if (eventThread_) {
+            eventThread_->stop();
         }
         if (keyboard_) {
             wl_keyboard_destroy(keyboard_);
@@ -225,19 +151,17 @@ public:
             if (eglContext_ != EGL_NO_CONTEXT) {
                 eglDestroyContext(eglDisplay_, eglContext_);
             }
-            if (eglSurface_ != EGL_NO_SURFACE) {
-                eglDestroySurface(eglDisplay_, eglSurface_);
+            for (auto& view : views_) {
+                if (view->eglSurface != EGL_NO_SURFACE) {
+                    eglDestroySurface(eglDisplay_, view->eglSurface);
+                }
             }
             eglTerminate(eglDisplay_);
         }
-        if (eglWindow_) {
-            wl_egl_window_destroy(eglWindow_);
-        }
-        if (layerSurface_) {
-            zwlr_layer_surface_v1_destroy(layerSurface_);
-        }
-        if (surface_) {
-            wl_surface_destroy(surface_);
+        swapchain_.reset();
+        viewportImage_.reset();
+        for (auto& view : views_) {
+            destroyView(*view);
         }
         if (layerShell_) {
             zwlr_layer_shell_v1_destroy(layerShell_);
@@ -245,17 +169,23 @@ public:
         if (fractionalScaleManager_) {
             wp_fractional_scale_manager_v1_destroy(fractionalScaleManager_);
         }
+        if (tearingControlManager_) {
+            wp_tearing_control_manager_v1_destroy(tearingControlManager_);
+        }
         if (viewporter_) {
             wp_viewporter_destroy(viewporter_);
         }
+        if (shm_) {
+            wl_shm_destroy(shm_);
+        }
         if (compositor_) {
             wl_compositor_destroy(compositor_);
         }
-        if (registry_) {
-            wl_registry_destroy(registry_);
-        }
+        presentation_.reset();
+        eventThread_.reset();
+        // Flush the destroy requests; the connection outlives the window
         if (display_) {
-            wl_display_disconnect(display_);
+            wl_display_flush(display_);
         }
     }
 
@@ -264,49 +194,348 @@ public:
     }
 
     void pollEvents() override {
-        input_.deltaX = 0.0;
-        input_.deltaY = 0.0;
-        input_.wheelDelta = 0.0;
-
-        if (!display_) {
-            shouldClose_ = true;
-            return;
-        }
-
-        wl_display_dispatch_pending(display_);
-        wl_display_flush(display_);
+        dispatchEvents(0);
+    }
 
-        int fd = wl_display_get_fd(display_);
-        pollfd pfd{fd, POLLIN, 0};
-        if (poll(&pfd, 1, 0) > 0) {
-            wl_display_dispatch(display_);
-        }
+    void waitEvents(int timeoutMs) override {
+        dispatchEvents(timeoutMs);
     }
 
     bool shouldClose() const override {
         return shouldClose_;
     }
     InputState input() const override {
-        return input_;
+        return frameInput_;
+    }
+    int viewCount() const override {
+        return static_cast<int>(views_.size());
+    }
+    WindowView view(int index) const override {
+        if (index < 0 || index >= viewCount()) {
+            return {};
+        }
+        const View& view = *views_[index];
+        return WindowView{view.output, view.width, view.height};
+    }
+    void selectView(int index) override {
+        if (index < 0 || index >= viewCount() ||
+            current_ == views_[index].get()) {
+            return;
+        }
+        current_ = views_[index].get();
+        if (eglContext_ != EGL_NO_CONTEXT) {
+            eglMakeCurrent(eglDisplay_, current_->eglSurface,
+                           current_->eglSurface, eglContext_);
+        }
+    }
+    bool viewReady(int index) const override {
+        if (index < 0 || index >= viewCount() || !views_[index]->configured) {
+            return false;
+        }
+        // A single view keeps the blocking swap as its frame clock
+        return views_.size() <= 1 || !views_[index]->frameCallback;
     }
     int width() const override {
-        return width_;
+        return current_ ? current_->width : 0;
     }
     int height() const override {
-        return height_;
+        return current_ ? current_->height : 0;
     }
 
     void swap() override {
-        if (eglDisplay_ != EGL_NO_DISPLAY && eglSurface_ != EGL_NO_SURFACE) {
-            if (surface_) {
-                wl_surface_damage_buffer(surface_, 0, 0, width_, height_);
-                if (!frameCallback_) {
-                    frameCallback_ = wl_surface_frame(surface_);
-                    wl_callback_add_listener(frameCallback_, &frameListener_,
-                                             this);
-                }
+        present(nullptr);
+    }
+
+    void swapWithDamage(const DamageRect& damage) override {
+        present(&damage);
+    }
+
+    int bufferAge() override {
+        if (swapchain_) {
+            return swapchain_->bufferAge();
+        }
+        if (!hasBufferAge_ || eglDisplay_ == EGL_NO_DISPLAY || !current_ ||
+            current_->eglSurface == EGL_NO_SURFACE) {
+            return 0;
+        }
+        EGLint age = 0;
+        if (!eglQuerySurface(eglDisplay_, current_->eglSurface,
+                             EGL_BUFFER_AGE_EXT, &age)) {
+            return 0;
+        }
+        return age;
+    }
+
+    std::vector<FramePresentation> takePresentations() override {
+        return presentation_ ? presentation_->take()
+                             : std::vector<FramePresentation>();
+    }
+
+    SoftwareFramebuffer softwareFramebuffer() override {
+        return swapchain_ ? swapchain_->acquire() : SoftwareFramebuffer{};
+    }
+
+    SoftwareFramebuffer viewportImage(int width, int height) override {
+        return viewportImage_ ? viewportImage_->image(width, height)
+                              : SoftwareFramebuffer{};
+    }
+
+    void setViewportSource(const ViewportSource& source) override {
+        if (viewportImage_) {
+            viewportImage_->setSource(source);
+        }
+    }
+
+    void* glGetProcAddress(const char* name) override {
+        return reinterpret_cast<void*>(eglGetProcAddress(name));
+    }
+
+private:
+    // One layer surface, placed on a single output (or wherever the
+    // compositor puts it when output is null).
+    struct View {
+        WaylandWindowLayerShellEgl* window = nullptr;
+        int index = 0;
+        std::string output;
+        wl_surface* surface = nullptr;
+        zwlr_layer_surface_v1* layerSurface = nullptr;
+        wp_viewport* viewport = nullptr;
+        wp_fractional_scale_v1* fractionalScale = nullptr;
+        wp_tearing_control_v1* tearingControl = nullptr;
+        wl_egl_window* eglWindow = nullptr;
+        EGLSurface eglSurface = EGL_NO_SURFACE;
+        wl_callback* frameCallback = nullptr;
+        int width = 0;
+        int height = 0;
+        int surfaceWidth = 0;
+        int surfaceHeight = 0;
+        uint32_t preferredScale120 = 120;
+        bool configured = false;
+    };
+
+    wl_output* findOutput(const std::string& name) const {
+        for (const auto& output : connection_.waylandOutputs()) {
+            if (output->info.name == name) {
+                return output->output;
+            }
+        }
+        return nullptr;
+    }
+
+    bool createView(wl_output* output, const std::string& name,
+                    const WindowConfig& config) {
+        auto view = std::make_unique<View>();
+        view->window = this;
+        view->index = static_cast<int>(views_.size());
+        view->output = name;
+        view->surfaceWidth = std::max(1, config.width);
+        view->surfaceHeight = std::max(1, config.height);
+        view->width = view->surfaceWidth;
+        view->height = view->surfaceHeight;
+
+        view->surface = wl_compositor_create_surface(compositor_);
+        if (!view->surface) {
+            LOG_ERROR("failed to create Wayland surface");
+            return false;
+        }
+        if (viewporter_) {
+            view->viewport =
+                wp_viewporter_get_viewport(viewporter_, view->surface);
+        }
+        if (fractionalScaleManager_) {
+            view->fractionalScale =
+                wp_fractional_scale_manager_v1_get_fractional_scale(
+                    fractionalScaleManager_, view->surface);
+            wp_fractional_scale_v1_add_listener(
+                view->fractionalScale, &fractionalScaleListener_, view.get());
+        }
+        if (lowLatency_ && tearingControlManager_) {
+            view->tearingControl =
+                wp_tearing_control_manager_v1_get_tearing_control(
+                    tearingControlManager_, view->surface);
+            wp_tearing_control_v1_set_presentation_hint(
+                view->tearingControl,
+                WP_TEARING_CONTROL_V1_PRESENTATION_HINT_ASYNC);
+        }
+
+        view->layerSurface = zwlr_layer_shell_v1_get_layer_surface(
+            layerShell_, view->surface, output,
+            ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY, "coomer");
+        if (!view->layerSurface) {
+            LOG_ERROR("failed to create layer surface");
+            destroyView(*view);
+            return false;
+        }
+        zwlr_layer_surface_v1_add_listener(view->layerSurface,
+                                           &layerSurfaceListener_, view.get());
+        // Let the compositor choose the full output size when anchored to all
+        // edges.
+        zwlr_layer_surface_v1_set_size(view->layerSurface, 0, 0);
+        zwlr_layer_surface_v1_set_anchor(
+            view->layerSurface, ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP |
+                                    ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM |
+                                    ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT |
+                                    ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT);
+        // Extend underneath panels (e.g. waybar) instead of avoiding their
+        // exclusive zone.
+        zwlr_layer_surface_v1_set_exclusive_zone(view->layerSurface, -1);
+        zwlr_layer_surface_v1_set_keyboard_interactivity(
+            view->layerSurface,
+            ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_EXCLUSIVE);
+
+        wl_surface_commit(view->surface);
+        views_.push_back(std::move(view));
+        return true;
+    }
+
+    void destroyView(View& view) {
+        if (view.eglWindow) {
+            wl_egl_window_destroy(view.eglWindow);
+            view.eglWindow = nullptr;
+        }
+        if (view.frameCallback) {
+            wl_callback_destroy(view.frameCallback);
+            view.frameCallback = nullptr;
+        }
+        if (view.fractionalScale) {
+            wp_fractional_scale_v1_destroy(view.fractionalScale);
+            view.fractionalScale = nullptr;
+        }
+        if (view.tearingControl) {
+            wp_tearing_control_v1_destroy(view.tearingControl);
+            view.tearingControl = nullptr;
+        }
+        if (view.viewport) {
+            wp_viewport_destroy(view.viewport);
+            view.viewport = nullptr;
+        }
+        if (view.layerSurface) {
+            zwlr_layer_surface_v1_destroy(view.layerSurface);
+            view.layerSurface = nullptr;
+        }
+        if (view.surface) {
+            wl_surface_destroy(view.surface);
+            view.surface = nullptr;
+        }
+    }
+
+    bool initEgl(bool gles) {
+        eglDisplay_ =
+            eglGetDisplay(reinterpret_cast<EGLNativeDisplayType>(display_));
+        if (eglDisplay_ == EGL_NO_DISPLAY) {
+            LOG_ERROR("failed to get EGL display");
+            return false;
+        }
+        if (!eglInitialize(eglDisplay_, nullptr, nullptr)) {
+            LOG_ERROR("failed to initialize EGL");
+            return false;
+        }
+        const char* eglExtensions = eglQueryString(eglDisplay_, EGL_EXTENSIONS);
+        hasBufferAge_ = hasExtension(eglExtensions, "EGL_EXT_buffer_age");
+        if (hasExtension(eglExtensions, "EGL_KHR_swap_buffers_with_damage")) {
+            swapBuffersWithDamage_ =
+                reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+                    eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+        } else if (hasExtension(eglExtensions,
+                                "EGL_EXT_swap_buffers_with_damage")) {
+            swapBuffersWithDamage_ =
+                reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+                    eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+        }
+        LOG_DEBUG("layer-shell: buffer age %s, swap with damage %s",
+                  hasBufferAge_ ? "yes" : "no",
+                  swapBuffersWithDamage_ ? "yes" : "no");
+
+        EGLConfig eglConfig = nullptr;
+        if (!createEglContext(eglDisplay_, gles, &eglConfig, &eglContext_)) {
+            return false;
+        }
+
+        // All views render with the one context, so the screenshot texture
+        // is uploaded once.
+        for (auto& view : views_) {
+            view->eglWindow =
+                wl_egl_window_create(view->surface, view->width, view->height);
+            if (!view->eglWindow) {
+                LOG_ERROR("failed to create wl_egl_window");
+                return false;
+            }
+            view->eglSurface = eglCreateWindowSurface(
+                eglDisplay_, eglConfig,
+                reinterpret_cast<EGLNativeWindowType>(view->eglWindow),
+                nullptr);
+            if (view->eglSurface == EGL_NO_SURFACE) {
+                LOG_ERROR("failed to create EGL window surface");
+                return false;
+            }
+            if (!eglMakeCurrent(eglDisplay_, view->eglSurface,
+                                view->eglSurface, eglContext_)) {
+                LOG_ERROR("eglMakeCurrent failed");
+                return false;
+            }
+            if (views_.size() > 1 || lowLatency_) {
+                // Swaps must not block on one output while another waits,
+                // nor on vblank in low-latency mode; frame callbacks pace
+                // multiple views instead.
+                eglSwapInterval(eglDisplay_, 0);
             }
-            if (!eglSwapBuffers(eglDisplay_, eglSurface_)) {
+        }
+
+        current_ = views_.front().get();
+        if (!eglMakeCurrent(eglDisplay_, current_->eglSurface,
+                            current_->eglSurface, eglContext_)) {
+            LOG_ERROR("eglMakeCurrent failed");
+            return false;
+        }
+        return true;
+    }
+
+    void requestFrame(View& view) {
+        if (!view.frameCallback) {
+            view.frameCallback = wl_surface_frame(view.surface);
+            wl_callback_add_listener(view.frameCallback, &frameListener_,
+                                     &view);
+        }
+    }
+
+    void present(const DamageRect* damage) {
+        if (!current_) {
+            return;
+        }
+        View& view = *current_;
+        if (viewportImage_) {
+            requestFrame(view);
+            presentation_->request(view.surface);
+            viewportImage_->present(view.surface, view.viewport);
+            wl_display_flush(display_);
+            return;
+        }
+        if (swapchain_) {
+            requestFrame(view);
+            presentation_->request(view.surface);
+            swapchain_->present(view.surface, damage);
+            wl_display_flush(display_);
+            return;
+        }
+        if (eglDisplay_ != EGL_NO_DISPLAY &&
+            view.eglSurface != EGL_NO_SURFACE) {
+            bool withDamage = damage && swapBuffersWithDamage_;
+            // With swap-with-damage EGL posts the damage itself
+            if (!withDamage) {
+                wl_surface_damage_buffer(view.surface, 0, 0, view.width,
+                                         view.height);
+            }
+            requestFrame(view);
+            presentation_->request(view.surface);
+            EGLBoolean swapped = EGL_FALSE;
+            if (withDamage) {
+                EGLint rect[4] = {damage->x, damage->y, damage->w, damage->h};
+                swapped = swapBuffersWithDamage_(eglDisplay_, view.eglSurface,
+                                                 rect, 1);
+            } else {
+                swapped = eglSwapBuffers(eglDisplay_, view.eglSurface);
+            }
+            if (!swapped) {
                 EGLint err = eglGetError();
                 LOG_WARN("layer-shell eglSwapBuffers failed: 0x%x", err);
             }
@@ -316,109 +545,203 @@ public:
         }
     }
 
-    void* glGetProcAddress(const char* name) override {
-        return reinterpret_cast<void*>(eglGetProcAddress(name));
+    void dispatchEvents(int timeoutMs) {
+        if (!display_) {
+            shouldClose_ = true;
+            return;
+        }
+        if (!eventThread_->dispatchMain(timeoutMs)) {
+            LOG_ERROR("Wayland connection lost");
+            shouldClose_ = true;
+        }
+
+        // Input accumulated by the event thread since the last frame
+        std::lock_guard<std::mutex> lock(eventThread_->mutex());
+        frameInput_ = input_;
+        frameInput_.eventTime = eventThread_->eventTime();
+        input_.deltaX = 0.0;
+        input_.deltaY = 0.0;
+        input_.wheelDelta = 0.0;
+        input_.keyHPresses = 0;
+        input_.exposed = false;
+        input_.events.clear();
+    }
+
+    void queuePointerEvent(const InputEvent& event) {
+        if (pointer_ && wl_pointer_get_version(pointer_) >=
+                            WL_POINTER_FRAME_SINCE_VERSION) {
+            pendingPointerEvents_.push_back(event);
+        } else {
+            input_.events.push_back(event);
+        }
+    }
+
+    bool hasWheelSteps() const {
+        return pointer_ && wl_pointer_get_version(pointer_) >=
+                               WL_POINTER_AXIS_VALUE120_SINCE_VERSION;
+    }
+
+    // Queues the frame's wheel steps, or its axis motion when there were
+    // none (touchpads and other continuous sources send no steps).
+    void queueFrameWheel() {
+        // axis_value120 carries no time of its own
+        double time = hasFrameAxis_ ? eventTimeSeconds(frameAxisTime_)
+                                    : nowSeconds();
+        if (frameWheelSteps_.empty() && hasFrameAxis_) {
+            InputEvent event;
+            event.type = InputEvent::Type::Wheel;
+            event.wheel = frameAxis_ / 120.0;
+            frameWheelSteps_.push_back(event);
+        }
+        for (InputEvent& event : frameWheelSteps_) {
+            event.time = time;
+            pendingPointerEvents_.push_back(event);
+            input_.wheelDelta += event.wheel;
+        }
+        frameWheelSteps_.clear();
+        frameAxis_ = 0.0;
+        hasFrameAxis_ = false;
     }
 
-private:
     static int scaleSurfaceToBuffer(int size, uint32_t scale120) {
         long long scaled = static_cast<long long>(size) *
                            static_cast<long long>(std::max(1u, scale120));
         return std::max(1, static_cast<int>((scaled + 60) / 120));
     }
 
-    double surfaceToBufferX(double x) const {
-        if (surfaceWidth_ <= 0) {
+    static double surfaceToBufferX(const View& view, double x) {
+        if (view.surfaceWidth <= 0) {
             return x;
         }
-        return x * static_cast<double>(width_) /
-               static_cast<double>(surfaceWidth_);
+        return x * static_cast<double>(view.width) /
+               static_cast<double>(view.surfaceWidth);
     }
 
-    double surfaceToBufferY(double y) const {
-        if (surfaceHeight_ <= 0) {
+    static double surfaceToBufferY(const View& view, double y) {
+        if (view.surfaceHeight <= 0) {
             return y;
         }
-        return y * static_cast<double>(height_) /
-               static_cast<double>(surfaceHeight_);
+        return y * static_cast<double>(view.height) /
+               static_cast<double>(view.surfaceHeight);
     }
 
-    void updateBufferGeometry() {
-        surfaceWidth_ = std::max(1, surfaceWidth_);
-        surfaceHeight_ = std::max(1, surfaceHeight_);
+    void updateBufferGeometry(View& view) {
+        std::lock_guard<std::mutex> lock(eventThread_->mutex());
+        view.surfaceWidth = std::max(1, view.surfaceWidth);
+        view.surfaceHeight = std::max(1, view.surfaceHeight);
+
+        int newWidth = view.surfaceWidth;
+        int newHeight = view.surfaceHeight;
+        if (view.viewport) {
+            wp_viewport_set_destination(view.viewport, view.surfaceWidth,
+                                        view.surfaceHeight);
+            newWidth = scaleSurfaceToBuffer(view.surfaceWidth,
+                                            view.preferredScale120);
+            newHeight = scaleSurfaceToBuffer(view.surfaceHeight,
+                                             view.preferredScale120);
+        }
 
-        int newWidth = surfaceWidth_;
-        int newHeight = surfaceHeight_;
-        if (viewport_) {
-            wp_viewport_set_destination(viewport_, surfaceWidth_, surfaceHeight_);
-            newWidth = scaleSurfaceToBuffer(surfaceWidth_, preferredScale120_);
-            newHeight = scaleSurfaceToBuffer(surfaceHeight_, preferredScale120_);
+        view.width = newWidth;
+        view.height = newHeight;
+        input_.exposed = true;
+        if (view.eglWindow) {
+            wl_egl_window_resize(view.eglWindow, view.width, view.height, 0,
+                                 0);
+        }
+        if (swapchain_ && &view == views_.front().get()) {
+            swapchain_->resize(view.width, view.height);
         }
+    }
 
-        width_ = newWidth;
-        height_ = newHeight;
-        if (eglWindow_) {
-            wl_egl_window_resize(eglWindow_, width_, height_, 0, 0);
+    View* viewForSurface(wl_surface* surface) const {
+        for (const auto& view : views_) {
+            if (view->surface == surface) {
+                return view.get();
+            }
         }
+        return nullptr;
     }
 
-    static void handleGlobal(void* data, wl_registry* registry, uint32_t name,
-                             const char* interface, uint32_t version) {
-        auto* self = static_cast<WaylandWindowLayerShellEgl*>(data);
+    // Binds what the window needs from the connection's globals.
+    void bindGlobal(wl_registry* registry, uint32_t name,
+                    const char* interface, uint32_t version) {
         if (std::strcmp(interface, wl_compositor_interface.name) == 0) {
-            self->compositor_ = static_cast<wl_compositor*>(
+            compositor_ = static_cast<wl_compositor*>(
                 wl_registry_bind(registry, name, &wl_compositor_interface,
                                  std::min(version, 4u)));
+        } else if (std::strcmp(interface, wl_shm_interface.name) == 0) {
+            shm_ = static_cast<wl_shm*>(
+                wl_registry_bind(registry, name, &wl_shm_interface, 1));
         } else if (std::strcmp(interface, wl_seat_interface.name) == 0) {
-            self->seat_ = static_cast<wl_seat*>(wl_registry_bind(
-                registry, name, &wl_seat_interface, std::min(version, 5u)));
-            wl_seat_add_listener(self->seat_, &seatListener_, self);
+            seat_ = static_cast<wl_seat*>(wl_registry_bind(
+                registry, name, &wl_seat_interface, std::min(version, 8u)));
+            // Seat, pointer and keyboard events go to the event thread
+            wl_proxy_set_queue(reinterpret_cast<wl_proxy*>(seat_),
+                               eventThread_->queue());
+            wl_seat_add_listener(seat_, &seatListener_, this);
         } else if (std::strcmp(interface, zwlr_layer_shell_v1_interface.name) ==
                    0) {
-            self->layerShell_ =
-                static_cast<zwlr_layer_shell_v1*>(wl_registry_bind(
-                    registry, name, &zwlr_layer_shell_v1_interface, 1));
+            layerShell_ = static_cast<zwlr_layer_shell_v1*>(wl_registry_bind(
+                registry, name, &zwlr_layer_shell_v1_interface, 1));
+        } else if (std::strcmp(interface, wp_presentation_interface.name) ==
+                   0) {
+            presentation_->bind(registry, name);
         } else if (std::strcmp(interface, wp_viewporter_interface.name) == 0) {
-            self->viewporter_ = static_cast<wp_viewporter*>(
+            viewporter_ = static_cast<wp_viewporter*>(
                 wl_registry_bind(registry, name, &wp_viewporter_interface, 1));
         } else if (std::strcmp(interface,
                                wp_fractional_scale_manager_v1_interface.name) ==
                    0) {
-            self->fractionalScaleManager_ =
+            fractionalScaleManager_ =
                 static_cast<wp_fractional_scale_manager_v1*>(wl_registry_bind(
                     registry, name, &wp_fractional_scale_manager_v1_interface,
                     1));
+        } else if (std::strcmp(interface,
+                               wp_tearing_control_manager_v1_interface.name) ==
+                   0) {
+            tearingControlManager_ =
+                static_cast<wp_tearing_control_manager_v1*>(wl_registry_bind(
+                    registry, name, &wp_tearing_control_manager_v1_interface,
+                    1));
         }
     }
 
-    static void handleGlobalRemove(void*, wl_registry*, uint32_t) {}
-
     static void handleLayerSurfaceConfigure(void* data,
                                             zwlr_layer_surface_v1* surface,
                                             uint32_t serial, uint32_t width,
                                             uint32_t height) {
-        auto* self = static_cast<WaylandWindowLayerShellEgl*>(data);
+        auto* view = static_cast<View*>(data);
         zwlr_layer_surface_v1_ack_configure(surface, serial);
-        self->configured_ = true;
+        if (!view->configured) {
+            // The first real frame is the view's first buffer
+            view->configured = true;
+            LOG_DEBUG("layer-shell: view %d configured after %.1f ms",
+                      view->index,
+                      (nowSeconds() - view->window->createTime_) * 1000.0);
+        }
         LOG_DEBUG("layer-shell configure: %ux%u", width, height);
         if (width > 0 && height > 0) {
-            self->surfaceWidth_ = static_cast<int>(width);
-            self->surfaceHeight_ = static_cast<int>(height);
-            self->updateBufferGeometry();
+            {
+                std::lock_guard<std::mutex> lock(
+                    view->window->eventThread_->mutex());
+                view->surfaceWidth = static_cast<int>(width);
+                view->surfaceHeight = static_cast<int>(height);
+            }
+            view->window->updateBufferGeometry(*view);
         }
     }
 
     static void handleLayerSurfaceClosed(void* data, zwlr_layer_surface_v1*) {
-        auto* self = static_cast<WaylandWindowLayerShellEgl*>(data);
-        self->shouldClose_ = true;
+        auto* view = static_cast<View*>(data);
+        view->window->shouldClose_ = true;
     }
 
     static void handleFrameDone(void* data, wl_callback* callback, uint32_t) {
-        auto* self = static_cast<WaylandWindowLayerShellEgl*>(data);
+        auto* view = static_cast<View*>(data);
         if (callback) {
             wl_callback_destroy(callback);
         }
-        self->frameCallback_ = nullptr;
+        view->frameCallback = nullptr;
     }
 
     static void handleSeatCapabilities(void* data, wl_seat* seat,
@@ -450,10 +773,17 @@ private:
     static void handleSeatName(void*, wl_seat*, const char*) {}
 
     static void handlePointerEnter(void* data, wl_pointer*, uint32_t,
-                                   wl_surface*, wl_fixed_t sx, wl_fixed_t sy) {
+                                   wl_surface* surface, wl_fixed_t sx,
+                                   wl_fixed_t sy) {
         auto* self = static_cast<WaylandWindowLayerShellEgl*>(data);
-        double x = self->surfaceToBufferX(wl_fixed_to_double(sx));
-        double y = self->surfaceToBufferY(wl_fixed_to_double(sy));
+        View* view = self->viewForSurface(surface);
+        if (!view) {
+            return;
+        }
+        self->pointerView_ = view;
+        self->input_.view = view->index;
+        double x = surfaceToBufferX(*view, wl_fixed_to_double(sx));
+        double y = surfaceToBufferY(*view, wl_fixed_to_double(sy));
         self->input_.mouseX = x;
         self->input_.mouseY = y;
         self->lastMouseX_ = x;
@@ -467,50 +797,106 @@ private:
         self->hasLastMouse_ = false;
     }
 
-    static void handlePointerMotion(void* data, wl_pointer*, uint32_t,
+    static void handlePointerMotion(void* data, wl_pointer*, uint32_t time,
                                     wl_fixed_t sx, wl_fixed_t sy) {
         auto* self = static_cast<WaylandWindowLayerShellEgl*>(data);
-        double x = self->surfaceToBufferX(wl_fixed_to_double(sx));
-        double y = self->surfaceToBufferY(wl_fixed_to_double(sy));
+        if (!self->pointerView_) {
+            return;
+        }
+        const View& view = *self->pointerView_;
+        double x = surfaceToBufferX(view, wl_fixed_to_double(sx));
+        double y = surfaceToBufferY(view, wl_fixed_to_double(sy));
         if (!self->hasLastMouse_) {
             self->lastMouseX_ = x;
             self->lastMouseY_ = y;
             self->hasLastMouse_ = true;
         }
-        self->input_.deltaX += x - self->lastMouseX_;
-        self->input_.deltaY += y - self->lastMouseY_;
+        InputEvent event;
+        event.type = InputEvent::Type::Motion;
+        event.time = eventTimeSeconds(time);
+        event.x = x;
+        event.y = y;
+        event.dx = x - self->lastMouseX_;
+        event.dy = y - self->lastMouseY_;
+        event.view = view.index;
+        self->queuePointerEvent(event);
+        self->input_.deltaX += event.dx;
+        self->input_.deltaY += event.dy;
         self->lastMouseX_ = x;
         self->lastMouseY_ = y;
         self->input_.mouseX = x;
         self->input_.mouseY = y;
     }
-
-    static void handlePointerButton(void* data, wl_pointer*, uint32_t, uint32_t,
-                                    uint32_t button, uint32_t state) {
+    static void handlePointerButton(void* data, wl_pointer*, uint32_t,
+                                    uint32_t time, uint32_t button,
+                                    uint32_t state) {
         auto* self = static_cast<WaylandWindowLayerShellEgl*>(data);
-        bool pressed = (state == WL_POINTER_BUTTON_STATE_PRESSED);
+        InputEvent event;
+        event.type = InputEvent::Type::Button;
+        event.time = eventTimeSeconds(time);
+        event.pressed = (state == WL_POINTER_BUTTON_STATE_PRESSED);
         if (button == BTN_LEFT) {
-            self->input_.mouseLeft = pressed;
+            event.button = PointerButton::Left;
+            self->input_.mouseLeft = event.pressed;
         } else if (button == BTN_RIGHT) {
-            self->input_.mouseRight = pressed;
+            event.button = PointerButton::Right;
+            self->input_.mouseRight = event.pressed;
+        } else {
+            return;
         }
+        self->queuePointerEvent(event);
     }
 
-    static void handlePointerAxis(void* data, wl_pointer*, uint32_t,
+    static void handlePointerAxis(void* data, wl_pointer*, uint32_t time,
                                   uint32_t axis, wl_fixed_t value) {
         auto* self = static_cast<WaylandWindowLayerShellEgl*>(data);
-        if (axis == WL_POINTER_AXIS_VERTICAL_SCROLL) {
-            double v = wl_fixed_to_double(value);
-            self->input_.wheelDelta += v / 120.0;
+        if (axis != WL_POINTER_AXIS_VERTICAL_SCROLL) {
+            return;
         }
+        if (self->hasWheelSteps()) {
+            // Left to the frame, which prefers the wheel steps
+            self->frameAxis_ += wl_fixed_to_double(value);
+            self->frameAxisTime_ = time;
+            self->hasFrameAxis_ = true;
+            return;
+        }
+        InputEvent event;
+        event.type = InputEvent::Type::Wheel;
+        event.time = eventTimeSeconds(time);
+        event.wheel = wl_fixed_to_double(value) / 120.0;
+        self->queuePointerEvent(event);
+        self->input_.wheelDelta += event.wheel;
     }
 
-    static void handlePointerFrame(void*, wl_pointer*) {}
+    // Events between two frame events belong to one hardware report and
+    // are handed over together.
+    static void handlePointerFrame(void* data, wl_pointer*) {
+        auto* self = static_cast<WaylandWindowLayerShellEgl*>(data);
+        self->queueFrameWheel();
+        auto& events = self->input_.events;
+        events.insert(events.end(), self->pendingPointerEvents_.begin(),
+                      self->pendingPointerEvents_.end());
+        self->pendingPointerEvents_.clear();
+    }
     static void handlePointerAxisSource(void*, wl_pointer*, uint32_t) {}
     static void handlePointerAxisStop(void*, wl_pointer*, uint32_t, uint32_t) {}
     static void handlePointerAxisDiscrete(void*, wl_pointer*, uint32_t,
                                           int32_t) {}
 
+    // One wheel click is 120 here and, with libinput, 15 in axis events;
+    // scale to the axis units so that zoom speed does not depend on the
+    // seat version.
+    static void handlePointerAxisValue120(void* data, wl_pointer*,
+                                          uint32_t axis, int32_t value120) {
+        auto* self = static_cast<WaylandWindowLayerShellEgl*>(data);
+        if (axis == WL_POINTER_AXIS_VERTICAL_SCROLL) {
+            InputEvent event;
+            event.type = InputEvent::Type::Wheel;
+            event.wheel = value120 * (kAxisPerWheelClick / 120.0) / 120.0;
+            self->frameWheelSteps_.push_back(event);
+        }
+    }
+
     static void handleKeyboardKeymap(void* data, wl_keyboard*, uint32_t format,
                                      int fd, uint32_t size) {
         auto* self = static_cast<WaylandWindowLayerShellEgl*>(data);
@@ -558,6 +944,8 @@ private:
             self->input_.keyQ = pressed;
         } else if (sym == XKB_KEY_a || sym == XKB_KEY_A) {
             self->input_.keyA = pressed;
+        } else if ((sym == XKB_KEY_h || sym == XKB_KEY_H) && pressed) {
+            ++self->input_.keyHPresses;
         }
     }
 
@@ -583,16 +971,14 @@ private:
 
     static void handlePreferredScale(void* data, wp_fractional_scale_v1*,
                                      uint32_t scale) {
-        auto* self = static_cast<WaylandWindowLayerShellEgl*>(data);
+        auto* view = static_cast<View*>(data);
         if (scale == 0) {
             return;
         }
-        self->preferredScale120_ = scale;
-        self->updateBufferGeometry();
+        view->preferredScale120 = scale;
+        view->window->updateBufferGeometry(*view);
     }
 
-    static inline wl_registry_listener registryListener_ = {handleGlobal,
-                                                            handleGlobalRemove};
     static inline zwlr_layer_surface_v1_listener layerSurfaceListener_ = {
         handleLayerSurfaceConfigure, handleLayerSurfaceClosed};
     static inline wl_seat_listener seatListener_ = {handleSeatCapabilities,
@@ -602,7 +988,7 @@ private:
         handlePointerMotion,      handlePointerButton,
         handlePointerAxis,        handlePointerFrame,
         handlePointerAxisSource,  handlePointerAxisStop,
-        handlePointerAxisDiscrete};
+        handlePointerAxisDiscrete, handlePointerAxisValue120};
     static inline wl_keyboard_listener keyboardListener_ = {
         handleKeyboardKeymap,    handleKeyboardEnter,
         handleKeyboardLeave,     handleKeyboardKey,
@@ -611,40 +997,52 @@ private:
     static inline wp_fractional_scale_v1_listener fractionalScaleListener_ = {
         handlePreferredScale};
 
+    DisplayConnection& connection_;
     wl_display* display_ = nullptr;
-    wl_registry* registry_ = nullptr;
     wl_compositor* compositor_ = nullptr;
+    wl_shm* shm_ = nullptr;
     zwlr_layer_shell_v1* layerShell_ = nullptr;
     wp_viewporter* viewporter_ = nullptr;
-    wp_viewport* viewport_ = nullptr;
     wp_fractional_scale_manager_v1* fractionalScaleManager_ = nullptr;
-    wp_fractional_scale_v1* fractionalScale_ = nullptr;
-    wl_surface* surface_ = nullptr;
-    zwlr_layer_surface_v1* layerSurface_ = nullptr;
+    wp_tearing_control_manager_v1* tearingControlManager_ = nullptr;
+    bool lowLatency_ = false;
+    double createTime_ = 0.0;
+    std::vector<std::unique_ptr<View>> views_;
+    // View that size queries, rendering and swaps apply to
+    View* current_ = nullptr;
+    View* pointerView_ = nullptr;
 
     wl_seat* seat_ = nullptr;
     wl_pointer* pointer_ = nullptr;
     wl_keyboard* keyboard_ = nullptr;
 
-    wl_egl_window* eglWindow_ = nullptr;
     EGLDisplay eglDisplay_ = EGL_NO_DISPLAY;
     EGLContext eglContext_ = EGL_NO_CONTEXT;
-    EGLSurface eglSurface_ = EGL_NO_SURFACE;
+    bool hasBufferAge_ = false;
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swapBuffersWithDamage_ = nullptr;
+    std::unique_ptr<WaylandShmSwapchain> swapchain_;
+    std::unique_ptr<WaylandViewportImage> viewportImage_;
 
     xkb_context* xkbContext_ = nullptr;
     xkb_keymap* xkbKeymap_ = nullptr;
     xkb_state* xkbState_ = nullptr;
 
+    // Written by input listeners on the event thread, guarded by
+    // eventThread_->mutex(); frameInput_ is the render thread's snapshot.
+    std::unique_ptr<WaylandEventThread> eventThread_;
+    std::unique_ptr<WaylandPresentation> presentation_;
     InputState input_{};
+    InputState frameInput_{};
+    std::vector<InputEvent> pendingPointerEvents_;
+    // Wheel input of the current pointer frame, on seats with
+    // axis_value120.
+    static constexpr double kAxisPerWheelClick = 15.0;
+    std::vector<InputEvent> frameWheelSteps_;
+    double frameAxis_ = 0.0;
+    uint32_t frameAxisTime_ = 0;
+    bool hasFrameAxis_ = false;
     bool valid_ = false;
     bool shouldClose_ = false;
-    int width_ = 0;
-    int height_ = 0;
-    int surfaceWidth_ = 0;
-    int surfaceHeight_ = 0;
-    uint32_t preferredScale120_ = 120;
-    bool configured_ = false;
-    wl_callback* frameCallback_ = nullptr;
 
     bool hasLastMouse_ = false;
     double lastMouseX_ = 0.0;
@@ -652,8 +1050,9 @@ private:
 };
 
 std::unique_ptr<IWindow> CreateWaylandWindowLayerShellEgl(
-    const WindowConfig& config) {
-    auto window = std::make_unique<WaylandWindowLayerShellEgl>(config);
+    const WindowConfig& config, DisplayConnection& connection) {
+    auto window =
+        std::make_unique<WaylandWindowLayerShellEgl>(config, connection);
     if (!window->isValid()) {
         return nullptr;
     }
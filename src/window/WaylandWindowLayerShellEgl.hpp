@@ -2,11 +2,12 @@
 
 #include <memory>
 
+#include "platform/DisplayConnection.hpp"
 #include "window/IWindow.hpp"
 
 namespace coomer {
 
 std::unique_ptr<IWindow> CreateWaylandWindowLayerShellEgl(
-    const WindowConfig& config);
+    const WindowConfig& config, DisplayConnection& connection);
 
 }  // namespace coomer
@@ -2,7 +2,6 @@
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
-#include <poll.h>
 #include <sys/mman.h>
 #include <unistd.h>
 #include <wayland-client.h>
@@ -12,10 +11,22 @@
 #include <algorithm>
 #include <cstring>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "fractional-scale-v1-client-protocol.h"
+#include "platform/DisplayConnection.hpp"
 #include "platform/Log.hpp"
+#include "platform/StringUtil.hpp"
+#include "platform/Time.hpp"
+#include "presentation-time-client-protocol.h"
+#include "tearing-control-v1-client-protocol.h"
 #include "viewporter-client-protocol.h"
+#include "window/EglContext.hpp"
+#include "window/WaylandEventThread.hpp"
+#include "window/WaylandPresentation.hpp"
+#include "window/WaylandShmSwapchain.hpp"
+#include "window/WaylandViewportImage.hpp"
 #include "xdg-shell-client-protocol.h"
 
 #if __has_include(<linux/input-event-codes.h>)
@@ -29,21 +40,27 @@ namespace coomer {
 
 class WaylandWindowXdgEgl final : public IWindow {
 public:
-    explicit WaylandWindowXdgEgl(const WindowConfig& config) {
+    WaylandWindowXdgEgl(const WindowConfig& config,
+                        DisplayConnection& connection) {
         surfaceWidth_ = std::max(1, config.width);
         surfaceHeight_ = std::max(1, config.height);
         width_ = surfaceWidth_;
         height_ = surfaceHeight_;
+        lowLatency_ = config.lowLatency;
 
-        display_ = wl_display_connect(nullptr);
+        display_ = connection.wayland();
         if (!display_) {
             LOG_ERROR("failed to connect to Wayland display");
             return;
         }
+        eventThread_ = std::make_unique<WaylandEventThread>(display_);
+        presentation_ = std::make_unique<WaylandPresentation>();
 
-        registry_ = wl_display_get_registry(display_);
-        wl_registry_add_listener(registry_, &registryListener_, this);
-        wl_display_roundtrip(display_);
+        // The connection already holds the globals; no roundtrip needed
+        for (const auto& global : connection.waylandGlobals()) {
+            bindGlobal(connection.waylandRegistry(), global.name,
+                       global.interface.c_str(), global.version);
+        }
 
         if (!compositor_ || !wmBase_) {
             LOG_ERROR("Wayland compositor or xdg_wm_base missing");
@@ -64,6 +81,15 @@ public:
             wp_fractional_scale_v1_add_listener(fractionalScale_,
                                                 &fractionalScaleListener_, this);
         }
+        if (lowLatency_ && tearingControlManager_) {
+            // Applied with the first commit below
+            tearingControl_ = wp_tearing_control_manager_v1_get_tearing_control(
+                tearingControlManager_, surface_);
+            wp_tearing_control_v1_set_presentation_hint(
+                tearingControl_, WP_TEARING_CONTROL_V1_PRESENTATION_HINT_ASYNC);
+        } else if (lowLatency_) {
+            LOG_WARN("xdg-shell: no tearing control, frames stay vsynced");
+        }
 
         xdgSurface_ = xdg_wm_base_get_xdg_surface(wmBase_, surface_);
         xdg_surface_add_listener(xdgSurface_, &xdgSurfaceListener_, this);
@@ -73,99 +99,41 @@ public:
         xdg_toplevel_set_title(xdgToplevel_, config.title.c_str());
         xdg_toplevel_set_fullscreen(xdgToplevel_, nullptr);
 
+        // Buffers and the GL context are set up at the requested size while
+        // the configure event is on its way; viewReady() turns true once it
+        // has been acked.
         wl_surface_commit(surface_);
-        wl_display_roundtrip(display_);
-
-        if (!configured_) {
-            wl_display_roundtrip(display_);
-        }
+        wl_display_flush(display_);
+        createTime_ = nowSeconds();
         updateBufferGeometry();
 
-        eglWindow_ = wl_egl_window_create(surface_, width_, height_);
-        if (!eglWindow_) {
-            LOG_ERROR("failed to create wl_egl_window");
-            return;
-        }
-
-        eglDisplay_ =
-            eglGetDisplay(reinterpret_cast<EGLNativeDisplayType>(display_));
-        if (eglDisplay_ == EGL_NO_DISPLAY) {
-            LOG_ERROR("failed to get EGL display");
-            return;
-        }
-        if (!eglInitialize(eglDisplay_, nullptr, nullptr)) {
-            LOG_ERROR("failed to initialize EGL");
-            return;
-        }
-        eglBindAPI(EGL_OPENGL_API);
-
-        EGLint attribs[] = {EGL_SURFACE_TYPE,
-                            EGL_WINDOW_BIT,
-                            EGL_RED_SIZE,
-                            8,
-                            EGL_GREEN_SIZE,
-                            8,
-                            EGL_BLUE_SIZE,
-                            8,
-                            EGL_ALPHA_SIZE,
-                            8,
-                            EGL_RENDERABLE_TYPE,
-                            EGL_OPENGL_BIT,
-                            EGL_NONE};
-
-        EGLConfig eglConfig = nullptr;
-        EGLint numConfigs = 0;
-        if (!eglChooseConfig(eglDisplay_, attribs, &eglConfig, 1,
-                             &numConfigs) ||
-            numConfigs == 0) {
-            LOG_ERROR("failed to choose EGL config");
-            return;
-        }
-
-        EGLint ctxAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3,
-                               EGL_CONTEXT_MINOR_VERSION, 3, EGL_NONE};
-        eglContext_ = eglCreateContext(eglDisplay_, eglConfig, EGL_NO_CONTEXT,
-                                       ctxAttribs);
-        if (eglContext_ == EGL_NO_CONTEXT) {
-            LOG_ERROR("failed to create EGL context");
-            return;
-        }
-
-        eglSurface_ = eglCreateWindowSurface(
-            eglDisplay_, eglConfig,
-            reinterpret_cast<EGLNativeWindowType>(eglWindow_), nullptr);
-        if (eglSurface_ == EGL_NO_SURFACE) {
-            LOG_ERROR("failed to create EGL window surface");
-            return;
-        }
-
-        if (!eglMakeCurrent(eglDisplay_, eglSurface_, eglSurface_,
-                            eglContext_)) {
-            LOG_ERROR("eglMakeCurrent failed");
-            return;
-        }
-
-        // Commit an initial frame to ensure the compositor receives a buffer
-        if (surface_) {
-            wl_surface_damage_buffer(surface_, 0, 0, width_, height_);
-            frameCallback_ = wl_surface_frame(surface_);
-            wl_callback_add_listener(frameCallback_, &frameListener_, this);
-
-            // Swap without clearing to avoid visible flash before screenshot
-            // renders
-            if (!eglSwapBuffers(eglDisplay_, eglSurface_)) {
-                EGLint err = eglGetError();
-                LOG_WARN("xdg-shell initial eglSwapBuffers failed: 0x%x", err);
+        if (config.viewporter) {
+            if (!shm_ || !viewport_) {
+                LOG_ERROR("xdg-shell: wl_shm or wp_viewporter missing");
+                return;
             }
-            wl_display_flush(display_);
+            viewportImage_ = std::make_unique<WaylandViewportImage>(shm_);
+        } else if (config.software) {
+            if (!shm_) {
+                LOG_ERROR("xdg-shell: wl_shm missing");
+                return;
+            }
+            swapchain_ = std::make_unique<WaylandShmSwapchain>(display_, shm_);
+            swapchain_->resize(width_, height_);
+        } else if (!initEgl(config.gles)) {
+            return;
         }
 
         xkbContext_ = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
 
+        eventThread_->start();
         valid_ = true;
     }
 
     ~WaylandWindowXdgEgl() override {
+        if (eventThread_) {
+            eventThread_->stop();
+        }
         if (frameCallback_) {
             wl_callback_destroy(frameCallback_);
         }
@@ -207,12 +175,17 @@ public:
         if (eglWindow_) {
             wl_egl_window_destroy(eglWindow_);
         }
+        swapchain_.reset();
+        viewportImage_.reset();
         if (xdgToplevel_) {
             xdg_toplevel_destroy(xdgToplevel_);
         }
         if (xdgSurface_) {
             xdg_surface_destroy(xdgSurface_);
         }
+        if (tearingControl_) {
+            wp_tearing_control_v1_destroy(tearingControl_);
+        }
         if (surface_) {
             wl_surface_destroy(surface_);
         }
@@ -222,17 +195,23 @@ public:
         if (fractionalScaleManager_) {
             wp_fractional_scale_manager_v1_destroy(fractionalScaleManager_);
         }
+        if (tearingControlManager_) {
+            wp_tearing_control_manager_v1_destroy(tearingControlManager_);
+        }
         if (viewporter_) {
             wp_viewporter_destroy(viewporter_);
         }
+        if (shm_) {
+            wl_shm_destroy(shm_);
+        }
         if (compositor_) {
             wl_compositor_destroy(compositor_);
         }
-        if (registry_) {
-            wl_registry_destroy(registry_);
-        }
+        presentation_.reset();
+        eventThread_.reset();
+        // Flush the destroy requests; the connection outlives the window
         if (display_) {
-            wl_display_disconnect(display_);
+            wl_display_flush(display_);
         }
     }
 
@@ -241,30 +220,28 @@ public:
     }
 
     void pollEvents() override {
-        input_.deltaX = 0.0;
-        input_.deltaY = 0.0;
-        input_.wheelDelta = 0.0;
-
-        if (!display_) {
-            shouldClose_ = true;
-            return;
-        }
-
-        wl_display_dispatch_pending(display_);
-        wl_display_flush(display_);
+        dispatchEvents(0);
+    }
 
-        int fd = wl_display_get_fd(display_);
-        pollfd pfd{fd, POLLIN, 0};
-        if (poll(&pfd, 1, 0) > 0) {
-            wl_display_dispatch(display_);
-        }
+    void waitEvents(int timeoutMs) override {
+        dispatchEvents(timeoutMs);
     }
 
     bool shouldClose() const override {
         return shouldClose_;
     }
     InputState input() const override {
-        return input_;
+        return frameInput_;
+    }
+    int viewCount() const override {
+        return 1;
+    }
+    WindowView view(int) const override {
+        return WindowView{std::string(), width_, height_};
+    }
+    void selectView(int) override {}
+    bool viewReady(int) const override {
+        return configured_;
     }
     int width() const override {
         return width_;
@@ -274,16 +251,156 @@ public:
     }
 
     void swap() override {
+        present(nullptr);
+    }
+
+    void swapWithDamage(const DamageRect& damage) override {
+        present(&damage);
+    }
+
+    int bufferAge() override {
+        if (swapchain_) {
+            return swapchain_->bufferAge();
+        }
+        if (!hasBufferAge_ || eglDisplay_ == EGL_NO_DISPLAY ||
+            eglSurface_ == EGL_NO_SURFACE) {
+            return 0;
+        }
+        EGLint age = 0;
+        if (!eglQuerySurface(eglDisplay_, eglSurface_, EGL_BUFFER_AGE_EXT,
+                             &age)) {
+            return 0;
+        }
+        return age;
+    }
+
+    std::vector<FramePresentation> takePresentations() override {
+        return presentation_ ? presentation_->take()
+                             : std::vector<FramePresentation>();
+    }
+
+    SoftwareFramebuffer softwareFramebuffer() override {
+        return swapchain_ ? swapchain_->acquire() : SoftwareFramebuffer{};
+    }
+
+    SoftwareFramebuffer viewportImage(int width, int height) override {
+        return viewportImage_ ? viewportImage_->image(width, height)
+                              : SoftwareFramebuffer{};
+    }
+
+    void setViewportSource(const ViewportSource& source) override {
+        if (viewportImage_) {
+            viewportImage_->setSource(source);
+        }
+    }
+
+    void* glGetProcAddress(const char* name) override {
+        return reinterpret_cast<void*>(eglGetProcAddress(name));
+    }
+
+private:
+    bool initEgl(bool gles) {
+        eglWindow_ = wl_egl_window_create(surface_, width_, height_);
+        if (!eglWindow_) {
+            LOG_ERROR("failed to create wl_egl_window");
+            return false;
+        }
+
+        eglDisplay_ =
+            eglGetDisplay(reinterpret_cast<EGLNativeDisplayType>(display_));
+        if (eglDisplay_ == EGL_NO_DISPLAY) {
+            LOG_ERROR("failed to get EGL display");
+            return false;
+        }
+        if (!eglInitialize(eglDisplay_, nullptr, nullptr)) {
+            LOG_ERROR("failed to initialize EGL");
+            return false;
+        }
+        const char* eglExtensions = eglQueryString(eglDisplay_, EGL_EXTENSIONS);
+        hasBufferAge_ = hasExtension(eglExtensions, "EGL_EXT_buffer_age");
+        if (hasExtension(eglExtensions, "EGL_KHR_swap_buffers_with_damage")) {
+            swapBuffersWithDamage_ =
+                reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+                    eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+        } else if (hasExtension(eglExtensions,
+                                "EGL_EXT_swap_buffers_with_damage")) {
+            swapBuffersWithDamage_ =
+                reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+                    eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+        }
+        LOG_DEBUG("xdg-shell: buffer age %s, swap with damage %s",
+                  hasBufferAge_ ? "yes" : "no",
+                  swapBuffersWithDamage_ ? "yes" : "no");
+
+        EGLConfig eglConfig = nullptr;
+        if (!createEglContext(eglDisplay_, gles, &eglConfig, &eglContext_)) {
+            return false;
+        }
+
+        eglSurface_ = eglCreateWindowSurface(
+            eglDisplay_, eglConfig,
+            reinterpret_cast<EGLNativeWindowType>(eglWindow_), nullptr);
+        if (eglSurface_ == EGL_NO_SURFACE) {
+            LOG_ERROR("failed to create EGL window surface");
+            return false;
+        }
+
+        if (!eglMakeCurrent(eglDisplay_, eglSurface_, eglSurface_,
+                            eglContext_)) {
+            LOG_ERROR("eglMakeCurrent failed");
+            return false;
+        }
+        if (lowLatency_) {
+            // Swaps return at once instead of waiting for a frame callback
+            eglSwapInterval(eglDisplay_, 0);
+        }
+        return true;
+    }
+
+    void present(const DamageRect* damage) {
+        if (viewportImage_) {
+            if (surface_ && !frameCallback_) {
+                frameCallback_ = wl_surface_frame(surface_);
+                wl_callback_add_listener(frameCallback_, &frameListener_, this);
+            }
+            presentation_->request(surface_);
+            viewportImage_->present(surface_, viewport_);
+            wl_display_flush(display_);
+            return;
+        }
+        if (swapchain_) {
+            if (surface_ && !frameCallback_) {
+                frameCallback_ = wl_surface_frame(surface_);
+                wl_callback_add_listener(frameCallback_, &frameListener_, this);
+            }
+            presentation_->request(surface_);
+            swapchain_->present(surface_, damage);
+            wl_display_flush(display_);
+            return;
+        }
         if (eglDisplay_ != EGL_NO_DISPLAY && eglSurface_ != EGL_NO_SURFACE) {
+            bool withDamage = damage && swapBuffersWithDamage_;
             if (surface_) {
-                wl_surface_damage_buffer(surface_, 0, 0, width_, height_);
+                // With swap-with-damage EGL posts the damage itself
+                if (!withDamage) {
+                    wl_surface_damage_buffer(surface_, 0, 0, width_, height_);
+                }
                 if (!frameCallback_) {
                     frameCallback_ = wl_surface_frame(surface_);
                     wl_callback_add_listener(frameCallback_, &frameListener_,
                                              this);
                 }
+                presentation_->request(surface_);
             }
-            if (!eglSwapBuffers(eglDisplay_, eglSurface_)) {
+            EGLBoolean swapped = EGL_FALSE;
+            if (withDamage) {
+                EGLint rect[4] = {damage->x, damage->y, damage->w, damage->h};
+                swapped = swapBuffersWithDamage_(eglDisplay_, eglSurface_,
+                                                 rect, 1);
+            } else {
+                swapped = eglSwapBuffers(eglDisplay_, eglSurface_);
+            }
+            if (!swapped) {
                 EGLint err = eglGetError();
                 LOG_WARN("xdg-shell eglSwapBuffers failed: 0x%x", err);
             }
@@ -293,11 +410,64 @@ public:
         }
     }
 
-    void* glGetProcAddress(const char* name) override {
-        return reinterpret_cast<void*>(eglGetProcAddress(name));
+    void dispatchEvents(int timeoutMs) {
+        if (!display_) {
+            shouldClose_ = true;
+            return;
+        }
+        if (!eventThread_->dispatchMain(timeoutMs)) {
+            LOG_ERROR("Wayland connection lost");
+            shouldClose_ = true;
+        }
+
+        // Input accumulated by the event thread since the last frame
+        std::lock_guard<std::mutex> lock(eventThread_->mutex());
+        frameInput_ = input_;
+        frameInput_.eventTime = eventThread_->eventTime();
+        input_.deltaX = 0.0;
+        input_.deltaY = 0.0;
+        input_.wheelDelta = 0.0;
+        input_.keyHPresses = 0;
+        input_.exposed = false;
+        input_.events.clear();
+    }
+
+    void queuePointerEvent(const InputEvent& event) {
+        if (pointer_ && wl_pointer_get_version(pointer_) >=
+                            WL_POINTER_FRAME_SINCE_VERSION) {
+            pendingPointerEvents_.push_back(event);
+        } else {
+            input_.events.push_back(event);
+        }
+    }
+
+    bool hasWheelSteps() const {
+        return pointer_ && wl_pointer_get_version(pointer_) >=
+                               WL_POINTER_AXIS_VALUE120_SINCE_VERSION;
+    }
+
+    // Queues the frame's wheel steps, or its axis motion when there were
+    // none (touchpads and other continuous sources send no steps).
+    void queueFrameWheel() {
+        // axis_value120 carries no time of its own
+        double time = hasFrameAxis_ ? eventTimeSeconds(frameAxisTime_)
+                                    : nowSeconds();
+        if (frameWheelSteps_.empty() && hasFrameAxis_) {
+            InputEvent event;
+            event.type = InputEvent::Type::Wheel;
+            event.wheel = frameAxis_ / 120.0;
+            frameWheelSteps_.push_back(event);
+        }
+        for (InputEvent& event : frameWheelSteps_) {
+            event.time = time;
+            pendingPointerEvents_.push_back(event);
+            input_.wheelDelta += event.wheel;
+        }
+        frameWheelSteps_.clear();
+        frameAxis_ = 0.0;
+        hasFrameAxis_ = false;
     }
 
-private:
     static int scaleSurfaceToBuffer(int size, uint32_t scale120) {
         long long scaled = static_cast<long long>(size) *
                            static_cast<long long>(std::max(1u, scale120));
@@ -321,6 +491,7 @@ private:
     }
 
     void updateBufferGeometry() {
+        std::lock_guard<std::mutex> lock(eventThread_->mutex());
         surfaceWidth_ = std::max(1, surfaceWidth_);
         surfaceHeight_ = std::max(1, surfaceHeight_);
 
@@ -334,46 +505,59 @@ private:
 
         width_ = newWidth;
         height_ = newHeight;
+        input_.exposed = true;
         if (eglWindow_) {
             wl_egl_window_resize(eglWindow_, width_, height_, 0, 0);
         }
+        if (swapchain_) {
+            swapchain_->resize(width_, height_);
+        }
     }
 
-    static void handleGlobal(void* data, wl_registry* registry, uint32_t name,
-                             const char* interface, uint32_t version) {
-        auto* self = static_cast<WaylandWindowXdgEgl*>(data);
+    // Binds what the window needs from the connection's globals.
+    void bindGlobal(wl_registry* registry, uint32_t name,
+                    const char* interface, uint32_t version) {
         if (std::strcmp(interface, wl_compositor_interface.name) == 0) {
-            self->compositor_ = static_cast<wl_compositor*>(
+            compositor_ = static_cast<wl_compositor*>(
                 wl_registry_bind(registry, name, &wl_compositor_interface,
                                  std::min(version, 4u)));
+        } else if (std::strcmp(interface, wl_shm_interface.name) == 0) {
+            shm_ = static_cast<wl_shm*>(
+                wl_registry_bind(registry, name, &wl_shm_interface, 1));
         } else if (std::strcmp(interface, wl_seat_interface.name) == 0) {
-            self->seat_ = static_cast<wl_seat*>(wl_registry_bind(
-                registry, name, &wl_seat_interface, std::min(version, 5u)));
-            wl_seat_add_listener(self->seat_, &seatListener_, self);
+            seat_ = static_cast<wl_seat*>(wl_registry_bind(
+                registry, name, &wl_seat_interface, std::min(version, 8u)));
+            // Seat, pointer and keyboard events go to the event thread
+            wl_proxy_set_queue(reinterpret_cast<wl_proxy*>(seat_),
+                               eventThread_->queue());
+            wl_seat_add_listener(seat_, &seatListener_, this);
         } else if (std::strcmp(interface, xdg_wm_base_interface.name) == 0) {
-            self->wmBase_ = static_cast<xdg_wm_base*>(
+            wmBase_ = static_cast<xdg_wm_base*>(
                 wl_registry_bind(registry, name, &xdg_wm_base_interface, 1));
-            xdg_wm_base_add_listener(self->wmBase_, &wmBaseListener_, self);
+            xdg_wm_base_add_listener(wmBase_, &wmBaseListener_, this);
+        } else if (std::strcmp(interface, wp_presentation_interface.name) ==
+                   0) {
+            presentation_->bind(registry, name);
         } else if (std::strcmp(interface, wp_viewporter_interface.name) == 0) {
-            self->viewporter_ = static_cast<wp_viewporter*>(
+            viewporter_ = static_cast<wp_viewporter*>(
                 wl_registry_bind(registry, name, &wp_viewporter_interface, 1));
         } else if (std::strcmp(interface,
                                wp_fractional_scale_manager_v1_interface.name) ==
                    0) {
-            self->fractionalScaleManager_ =
+            fractionalScaleManager_ =
                 static_cast<wp_fractional_scale_manager_v1*>(wl_registry_bind(
                     registry, name, &wp_fractional_scale_manager_v1_interface,
                     1));
+        } else if (std::strcmp(interface,
+                               wp_tearing_control_manager_v1_interface.name) ==
+                   0) {
+            tearingControlManager_ =
+                static_cast<wp_tearing_control_manager_v1*>(wl_registry_bind(
+                    registry, name, &wp_tearing_control_manager_v1_interface,
+                    1));
         }
     }
 
-    static void handleGlobalRemove(void* data, wl_registry* registry,
-                                   uint32_t name) {
-        (void)data;
-        (void)registry;
-        (void)name;
-    }
-
     static void handlePing(void* data, xdg_wm_base* wm, uint32_t serial) {
         xdg_wm_base_pong(wm, serial);
         (void)data;
@@ -383,7 +567,12 @@ private:
                                           uint32_t serial) {
         auto* self = static_cast<WaylandWindowXdgEgl*>(data);
         xdg_surface_ack_configure(surface, serial);
-        self->configured_ = true;
+        if (!self->configured_) {
+            // The first real frame is the surface's first buffer
+            self->configured_ = true;
+            LOG_DEBUG("xdg-shell: configured after %.1f ms",
+                      (nowSeconds() - self->createTime_) * 1000.0);
+        }
     }
 
     static void handleToplevelConfigure(void* data, xdg_toplevel*,
@@ -391,8 +580,11 @@ private:
                                         wl_array*) {
         auto* self = static_cast<WaylandWindowXdgEgl*>(data);
         if (width > 0 && height > 0) {
-            self->surfaceWidth_ = width;
-            self->surfaceHeight_ = height;
+            {
+                std::lock_guard<std::mutex> lock(self->eventThread_->mutex());
+                self->surfaceWidth_ = width;
+                self->surfaceHeight_ = height;
+            }
             self->updateBufferGeometry();
         }
     }
@@ -456,7 +648,7 @@ private:
         self->hasLastMouse_ = false;
     }
 
-    static void handlePointerMotion(void* data, wl_pointer*, uint32_t,
+    static void handlePointerMotion(void* data, wl_pointer*, uint32_t time,
                                     wl_fixed_t sx, wl_fixed_t sy) {
         auto* self = static_cast<WaylandWindowXdgEgl*>(data);
         double x = self->surfaceToBufferX(wl_fixed_to_double(sx));
@@ -466,40 +658,93 @@ private:
             self->lastMouseY_ = y;
             self->hasLastMouse_ = true;
         }
-        self->input_.deltaX += x - self->lastMouseX_;
-        self->input_.deltaY += y - self->lastMouseY_;
+        InputEvent event;
+        event.type = InputEvent::Type::Motion;
+        event.time = eventTimeSeconds(time);
+        event.x = x;
+        event.y = y;
+        event.dx = x - self->lastMouseX_;
+        event.dy = y - self->lastMouseY_;
+        event.view = 0;
+        self->queuePointerEvent(event);
+        self->input_.deltaX += event.dx;
+        self->input_.deltaY += event.dy;
         self->lastMouseX_ = x;
         self->lastMouseY_ = y;
         self->input_.mouseX = x;
         self->input_.mouseY = y;
     }
 
-    static void handlePointerButton(void* data, wl_pointer*, uint32_t, uint32_t,
-                                    uint32_t button, uint32_t state) {
+    static void handlePointerButton(void* data, wl_pointer*, uint32_t,
+                                    uint32_t time, uint32_t button,
+                                    uint32_t state) {
         auto* self = static_cast<WaylandWindowXdgEgl*>(data);
-        bool pressed = (state == WL_POINTER_BUTTON_STATE_PRESSED);
+        InputEvent event;
+        event.type = InputEvent::Type::Button;
+        event.time = eventTimeSeconds(time);
+        event.pressed = (state == WL_POINTER_BUTTON_STATE_PRESSED);
         if (button == BTN_LEFT) {
-            self->input_.mouseLeft = pressed;
+            event.button = PointerButton::Left;
+            self->input_.mouseLeft = event.pressed;
         } else if (button == BTN_RIGHT) {
-            self->input_.mouseRight = pressed;
+            event.button = PointerButton::Right;
+            self->input_.mouseRight = event.pressed;
+        } else {
+            return;
         }
+        self->queuePointerEvent(event);
     }
 
-    static void handlePointerAxis(void* data, wl_pointer*, uint32_t,
+    static void handlePointerAxis(void* data, wl_pointer*, uint32_t time,
                                   uint32_t axis, wl_fixed_t value) {
         auto* self = static_cast<WaylandWindowXdgEgl*>(data);
-        if (axis == WL_POINTER_AXIS_VERTICAL_SCROLL) {
-            double v = wl_fixed_to_double(value);
-            self->input_.wheelDelta += v / 120.0;
+        if (axis != WL_POINTER_AXIS_VERTICAL_SCROLL) {
+            return;
+        }
+        if (self->hasWheelSteps()) {
+            // Left to the frame, which prefers the wheel steps
+            self->frameAxis_ += wl_fixed_to_double(value);
+            self->frameAxisTime_ = time;
+            self->hasFrameAxis_ = true;
+            return;
         }
+        InputEvent event;
+        event.type = InputEvent::Type::Wheel;
+        event.time = eventTimeSeconds(time);
+        event.wheel = wl_fixed_to_double(value) / 120.0;
+        self->queuePointerEvent(event);
+        self->input_.wheelDelta += event.wheel;
     }
 
-    static void handlePointerFrame(void*, wl_pointer*) {}
+    // Events between two frame events belong to one hardware report and
+    // are handed over together.
+    static void handlePointerFrame(void* data, wl_pointer*) {
+        auto* self = static_cast<WaylandWindowXdgEgl*>(data);
+        self->queueFrameWheel();
+        auto& events = self->input_.events;
+        events.insert(events.end(), self->pendingPointerEvents_.begin(),
+                      self->pendingPointerEvents_.end());
+        self->pendingPointerEvents_.clear();
+    }
     static void handlePointerAxisSource(void*, wl_pointer*, uint32_t) {}
     static void handlePointerAxisStop(void*, wl_pointer*, uint32_t, uint32_t) {}
     static void handlePointerAxisDiscrete(void*, wl_pointer*, uint32_t,
                                           int32_t) {}
 
+    // One wheel click is 120 here and, with libinput, 15 in axis events;
+    // scale to the axis units so that zoom speed does not depend on the
+    // seat version.
+    static void handlePointerAxisValue120(void* data, wl_pointer*,
+                                          uint32_t axis, int32_t value120) {
+        auto* self = static_cast<WaylandWindowXdgEgl*>(data);
+        if (axis == WL_POINTER_AXIS_VERTICAL_SCROLL) {
+            InputEvent event;
+            event.type = InputEvent::Type::Wheel;
+            event.wheel = value120 * (kAxisPerWheelClick / 120.0) / 120.0;
+            self->frameWheelSteps_.push_back(event);
+        }
+    }
+
     static void handleKeyboardKeymap(void* data, wl_keyboard*, uint32_t format,
                                      int fd, uint32_t size) {
         auto* self = static_cast<WaylandWindowXdgEgl*>(data);
@@ -547,6 +792,8 @@ private:
             self->input_.keyQ = pressed;
         } else if (sym == XKB_KEY_a || sym == XKB_KEY_A) {
             self->input_.keyA = pressed;
+        } else if ((sym == XKB_KEY_h || sym == XKB_KEY_H) && pressed) {
+            ++self->input_.keyHPresses;
         }
     }
 
@@ -580,8 +827,6 @@ private:
         self->updateBufferGeometry();
     }
 
-    static inline wl_registry_listener registryListener_ = {handleGlobal,
-                                                            handleGlobalRemove};
     static inline xdg_wm_base_listener wmBaseListener_ = {handlePing};
     static inline xdg_surface_listener xdgSurfaceListener_ = {
         handleXdgSurfaceConfigure};
@@ -594,7 +839,7 @@ private:
         handlePointerMotion,      handlePointerButton,
         handlePointerAxis,        handlePointerFrame,
         handlePointerAxisSource,  handlePointerAxisStop,
-        handlePointerAxisDiscrete};
+        handlePointerAxisDiscrete, handlePointerAxisValue120};
     static inline wl_keyboard_listener keyboardListener_ = {
         handleKeyboardKeymap,    handleKeyboardEnter,
         handleKeyboardLeave,     handleKeyboardKey,
@@ -604,12 +849,15 @@ private:
         handlePreferredScale};
 
     wl_display* display_ = nullptr;
-    wl_registry* registry_ = nullptr;
     wl_compositor* compositor_ = nullptr;
+    wl_shm* shm_ = nullptr;
     wp_viewporter* viewporter_ = nullptr;
     wp_viewport* viewport_ = nullptr;
     wp_fractional_scale_manager_v1* fractionalScaleManager_ = nullptr;
     wp_fractional_scale_v1* fractionalScale_ = nullptr;
+    wp_tearing_control_manager_v1* tearingControlManager_ = nullptr;
+    wp_tearing_control_v1* tearingControl_ = nullptr;
+    bool lowLatency_ = false;
     wl_surface* surface_ = nullptr;
     xdg_wm_base* wmBase_ = nullptr;
     xdg_surface* xdgSurface_ = nullptr;
@@ -623,15 +871,33 @@ private:
     EGLDisplay eglDisplay_ = EGL_NO_DISPLAY;
     EGLContext eglContext_ = EGL_NO_CONTEXT;
     EGLSurface eglSurface_ = EGL_NO_SURFACE;
+    bool hasBufferAge_ = false;
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swapBuffersWithDamage_ = nullptr;
+    std::unique_ptr<WaylandShmSwapchain> swapchain_;
+    std::unique_ptr<WaylandViewportImage> viewportImage_;
 
     xkb_context* xkbContext_ = nullptr;
     xkb_keymap* xkbKeymap_ = nullptr;
     xkb_state* xkbState_ = nullptr;
 
+    // Written by input listeners on the event thread, guarded by
+    // eventThread_->mutex(); frameInput_ is the render thread's snapshot.
+    std::unique_ptr<WaylandEventThread> eventThread_;
+    std::unique_ptr<WaylandPresentation> presentation_;
     InputState input_{};
+    InputState frameInput_{};
+    std::vector<InputEvent> pendingPointerEvents_;
+    // Wheel input of the current pointer frame, on seats with
+    // axis_value120.
+    static constexpr double kAxisPerWheelClick = 15.0;
+    std::vector<InputEvent> frameWheelSteps_;
+    double frameAxis_ = 0.0;
+    uint32_t frameAxisTime_ = 0;
+    bool hasFrameAxis_ = false;
     bool valid_ = false;
     bool shouldClose_ = false;
     bool configured_ = false;
+    double createTime_ = 0.0;
     wl_callback* frameCallback_ = nullptr;
     int width_ = 0;
     int height_ = 0;
@@ -644,8 +910,9 @@ private:
     double lastMouseY_ = 0.0;
 };
 
-std::unique_ptr<IWindow> CreateWaylandWindowXdgEgl(const WindowConfig& config) {
-    auto window = std::make_unique<WaylandWindowXdgEgl>(config);
+std::unique_ptr<IWindow> CreateWaylandWindowXdgEgl(
+    const WindowConfig& config, DisplayConnection& connection) {
+    auto window = std::make_unique<WaylandWindowXdgEgl>(config, connection);
     if (!window->isValid()) {
         return nullptr;
     }
@@ -2,10 +2,12 @@
 
 #include <memory>
 
+#include "platform/DisplayConnection.hpp"
 #include "window/IWindow.hpp"
 
 namespace coomer {
 
-std::unique_ptr<IWindow> CreateWaylandWindowXdgEgl(const WindowConfig& config);
+std::unique_ptr<IWindow> CreateWaylandWindowXdgEgl(
+    const WindowConfig& config, DisplayConnection& connection);
 
 }  // namespace coomer
@@ -5,75 +5,127 @@
 #include <GL/glxext.h>
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
+#include <X11/Xproto.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
 #include <X11/extensions/Xrandr.h>
 #include <X11/keysym.h>
+#include <poll.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 
+#include "platform/DisplayConnection.hpp"
 #include "platform/Log.hpp"
+#include "platform/StringUtil.hpp"
+#include "platform/Time.hpp"
+#include "platform/Trace.hpp"
+#include "platform/WakeFd.hpp"
 
 namespace coomer {
 
+// Pointer and keyboard events are read on a second connection by an event
+// thread; the render thread's connection only sees window events.
+constexpr long kWindowEventMask = ExposureMask | StructureNotifyMask;
+constexpr long kInputEventMask = KeyPressMask | KeyReleaseMask |
+                                 ButtonPressMask | ButtonReleaseMask |
+                                 PointerMotionMask;
+
+namespace {
+
+XErrorHandler previousErrorHandler = nullptr;
+
+// SetInputFocus fails with BadMatch while the window is not viewable yet.
+// Focus is set on MapNotify without a round trip to check, so the error
+// arrives asynchronously and is dropped.
+int ignoreFocusErrors(Display* display, XErrorEvent* event) {
+    if (event->request_code == X_SetInputFocus) {
+        return 0;
+    }
+    return previousErrorHandler ? previousErrorHandler(display, event) : 0;
+}
+
+}  // namespace
+
 class X11WindowGlx final : public IWindow {
 public:
-    explicit X11WindowGlx(const WindowConfig& config) {
-        display_ = XOpenDisplay(nullptr);
+    X11WindowGlx(const WindowConfig& config, DisplayConnection& connection)
+        : software_(config.software) {
+        display_ = connection.x11();
         if (!display_) {
             LOG_ERROR("failed to open X11 display");
             return;
         }
         int screen = DefaultScreen(display_);
-
-        static int fbAttribs[] = {GLX_X_RENDERABLE,
-                                  True,
-                                  GLX_DRAWABLE_TYPE,
-                                  GLX_WINDOW_BIT,
-                                  GLX_RENDER_TYPE,
-                                  GLX_RGBA_BIT,
-                                  GLX_X_VISUAL_TYPE,
-                                  GLX_TRUE_COLOR,
-                                  GLX_RED_SIZE,
-                                  8,
-                                  GLX_GREEN_SIZE,
-                                  8,
-                                  GLX_BLUE_SIZE,
-                                  8,
-                                  GLX_ALPHA_SIZE,
-                                  8,
-                                  GLX_DEPTH_SIZE,
-                                  24,
-                                  GLX_STENCIL_SIZE,
-                                  8,
-                                  GLX_DOUBLEBUFFER,
-                                  True,
-                                  None};
-
-        int fbCount = 0;
-        GLXFBConfig* fbc =
-            glXChooseFBConfig(display_, screen, fbAttribs, &fbCount);
-        if (!fbc || fbCount == 0) {
-            LOG_ERROR("failed to choose GLX framebuffer config");
-            return;
+        if (config.gles && !software_) {
+            LOG_WARN("GLES contexts are not supported with GLX, using GL");
         }
 
-        GLXFBConfig fbConfig = fbc[0];
-        XFree(fbc);
+        // Software rendering draws into an XImage of the default visual; GL
+        // needs the visual of a matching framebuffer config.
+        Visual* visual = DefaultVisual(display_, screen);
+        int depth = DefaultDepth(display_, screen);
+        GLXFBConfig fbConfig = nullptr;
+        if (!software_) {
+            static int fbAttribs[] = {GLX_X_RENDERABLE,
+                                      True,
+                                      GLX_DRAWABLE_TYPE,
+                                      GLX_WINDOW_BIT,
+                                      GLX_RENDER_TYPE,
+                                      GLX_RGBA_BIT,
+                                      GLX_X_VISUAL_TYPE,
+                                      GLX_TRUE_COLOR,
+                                      GLX_RED_SIZE,
+                                      8,
+                                      GLX_GREEN_SIZE,
+                                      8,
+                                      GLX_BLUE_SIZE,
+                                      8,
+                                      GLX_ALPHA_SIZE,
+                                      8,
+                                      GLX_DEPTH_SIZE,
+                                      24,
+                                      GLX_STENCIL_SIZE,
+                                      8,
+                                      GLX_DOUBLEBUFFER,
+                                      True,
+                                      None};
+
+            int fbCount = 0;
+            GLXFBConfig* fbc =
+                glXChooseFBConfig(display_, screen, fbAttribs, &fbCount);
+            if (!fbc || fbCount == 0) {
+                LOG_ERROR("failed to choose GLX framebuffer config");
+                return;
+            }
+
+            fbConfig = fbc[0];
+            XFree(fbc);
 
-        XVisualInfo* vi = glXGetVisualFromFBConfig(display_, fbConfig);
-        if (!vi) {
-            LOG_ERROR("failed to get X visual");
-            return;
+            XVisualInfo* vi = glXGetVisualFromFBConfig(display_, fbConfig);
+            if (!vi) {
+                LOG_ERROR("failed to get X visual");
+                return;
+            }
+            visual = vi->visual;
+            depth = vi->depth;
+            XFree(vi);
         }
 
-        Colormap cmap = XCreateColormap(display_, RootWindow(display_, screen),
-                                        vi->visual, AllocNone);
+        colormap_ = XCreateColormap(display_, RootWindow(display_, screen),
+                                    visual, AllocNone);
         XSetWindowAttributes swa{};
-        swa.colormap = cmap;
-        swa.event_mask = ExposureMask | KeyPressMask | KeyReleaseMask |
-                         ButtonPressMask | ButtonReleaseMask |
-                         PointerMotionMask | StructureNotifyMask;
+        swa.colormap = colormap_;
+        swa.event_mask = kWindowEventMask;
 
         width_ =
             config.width > 0 ? config.width : DisplayWidth(display_, screen);
@@ -83,9 +135,8 @@ public:
         window_ = XCreateWindow(
             display_, RootWindow(display_, screen), config.x, config.y,
             static_cast<unsigned int>(width_),
-            static_cast<unsigned int>(height_), 0, vi->depth, InputOutput,
-            vi->visual, CWColormap | CWEventMask, &swa);
-        XFree(vi);
+            static_cast<unsigned int>(height_), 0, depth, InputOutput, visual,
+            CWColormap | CWEventMask, &swa);
 
         if (!window_) {
             LOG_ERROR("failed to create X11 window");
@@ -93,6 +144,10 @@ public:
         }
 
         XStoreName(display_, window_, config.title.c_str());
+        // The input connection selects on the window, so the server has to
+        // know it first; a flush alone leaves that racing.
+        XSync(display_, False);
+        startEventThread();
 
         wmDelete_ = XInternAtom(display_, "WM_DELETE_WINDOW", False);
         XSetWMProtocols(display_, window_, &wmDelete_, 1);
@@ -103,20 +158,30 @@ public:
         XChangeProperty(display_, window_, wmState, XA_ATOM, 32,
                         PropModeReplace,
                         reinterpret_cast<unsigned char*>(&wmFullscreen), 1);
+        if (config.lowLatency) {
+            requestCompositorBypass(screen);
+        }
 
+        XErrorHandler previous = XSetErrorHandler(ignoreFocusErrors);
+        if (previous != ignoreFocusErrors) {
+            previousErrorHandler = previous;
+        }
+        // The GL context is created while the window manager maps the
+        // window; MapNotify then sets the focus and makes the view ready.
         XMapRaised(display_, window_);
         XFlush(display_);
-
-        // Wait for window to be mapped before setting focus to avoid BadMatch
-        XSync(display_, False);
-
-        // SetInputFocus may fail if window is not yet viewable, ignore errors
-        XSetErrorHandler([](Display*, XErrorEvent*) {
-            return 0;
-        });
-        XSetInputFocus(display_, window_, RevertToParent, CurrentTime);
-        XSync(display_, False);
-        XSetErrorHandler(nullptr);
+        createTime_ = nowSeconds();
+
+        if (software_) {
+            visual_ = visual;
+            depth_ = depth;
+            gc_ = XCreateGC(display_, window_, 0, nullptr);
+            if (!ensureSoftwareImage()) {
+                return;
+            }
+            valid_ = true;
+            return;
+        }
 
         auto glXCreateContextAttribsARB = reinterpret_cast<GLXContext (*)(
             Display*, GLXFBConfig, GLXContext, Bool, const int*)>(
@@ -146,11 +211,30 @@ public:
         }
 
         glXMakeCurrent(display_, window_, context_);
+
+        hasBufferAge_ = hasExtension(glXQueryExtensionsString(display_, screen),
+                                     "GLX_EXT_buffer_age");
+        LOG_DEBUG("glx: buffer age %s", hasBufferAge_ ? "yes" : "no");
+        initSyncControl(glXQueryExtensionsString(display_, screen));
+        if (config.lowLatency) {
+            disableSwapWait(glXQueryExtensionsString(display_, screen));
+        }
         valid_ = true;
     }
 
     ~X11WindowGlx() override {
+        if (eventThread_.joinable()) {
+            stopEvents_.signal();
+            eventThread_.join();
+        }
+        if (inputDisplay_) {
+            XCloseDisplay(inputDisplay_);
+        }
         if (display_) {
+            destroySoftwareImage();
+            if (gc_) {
+                XFreeGC(display_, gc_);
+            }
             if (context_) {
                 glXMakeCurrent(display_, None, nullptr);
                 glXDestroyContext(display_, context_);
@@ -158,7 +242,11 @@ public:
             if (window_) {
                 XDestroyWindow(display_, window_);
             }
-            XCloseDisplay(display_);
+            if (colormap_) {
+                XFreeColormap(display_, colormap_);
+            }
+            // The connection outlives the window
+            XFlush(display_);
         }
     }
 
@@ -167,68 +255,35 @@ public:
     }
 
     void pollEvents() override {
-        input_.deltaX = 0.0;
-        input_.deltaY = 0.0;
-        input_.wheelDelta = 0.0;
-
         while (display_ && XPending(display_)) {
             XEvent ev{};
             XNextEvent(display_, &ev);
+            std::lock_guard<std::mutex> lock(inputMutex_);
+            if (handleInputEvent(ev)) {
+                // No event thread, input arrives on this connection
+                eventTime_ = nowSeconds();
+                continue;
+            }
             switch (ev.type) {
-                case MotionNotify: {
-                    double x = ev.xmotion.x;
-                    double y = ev.xmotion.y;
-                    if (!hasLastMouse_) {
-                        lastMouseX_ = x;
-                        lastMouseY_ = y;
-                        hasLastMouse_ = true;
-                    }
-                    input_.deltaX += x - lastMouseX_;
-                    input_.deltaY += y - lastMouseY_;
-                    lastMouseX_ = x;
-                    lastMouseY_ = y;
-                    input_.mouseX = x;
-                    input_.mouseY = y;
-                    break;
-                }
-                case ButtonPress: {
-                    if (ev.xbutton.button == Button1) {
-                        input_.mouseLeft = true;
-                    } else if (ev.xbutton.button == Button3) {
-                        input_.mouseRight = true;
-                    } else if (ev.xbutton.button == Button4) {
-                        input_.wheelDelta -= 1.0;
-                    } else if (ev.xbutton.button == Button5) {
-                        input_.wheelDelta += 1.0;
-                    }
-                    break;
-                }
-                case ButtonRelease: {
-                    if (ev.xbutton.button == Button1) {
-                        input_.mouseLeft = false;
-                    } else if (ev.xbutton.button == Button3) {
-                        input_.mouseRight = false;
-                    }
+                case ConfigureNotify: {
+                    width_ = ev.xconfigure.width;
+                    height_ = ev.xconfigure.height;
+                    input_.exposed = true;
                     break;
                 }
-                case KeyPress:
-                case KeyRelease: {
-                    bool pressed = (ev.type == KeyPress);
-                    KeySym sym = XLookupKeysym(&ev.xkey, 0);
-                    if (sym == XK_q || sym == XK_Q) {
-                        input_.keyQ = pressed;
-                    } else if (sym == XK_a || sym == XK_A) {
-                        input_.keyA = pressed;
-                    } else if (sym == XK_Control_L || sym == XK_Control_R) {
-                        input_.keyCtrl = pressed;
-                    } else if (sym == XK_Shift_L || sym == XK_Shift_R) {
-                        input_.keyShift = pressed;
+                case MapNotify: {
+                    if (!mapped_) {
+                        mapped_ = true;
+                        XSetInputFocus(display_, window_, RevertToParent,
+                                       CurrentTime);
+                        LOG_DEBUG("x11: window mapped after %.1f ms",
+                                  (nowSeconds() - createTime_) * 1000.0);
                     }
+                    input_.exposed = true;
                     break;
                 }
-                case ConfigureNotify: {
-                    width_ = ev.xconfigure.width;
-                    height_ = ev.xconfigure.height;
+                case Expose: {
+                    input_.exposed = true;
                     break;
                 }
                 case ClientMessage: {
@@ -241,13 +296,46 @@ public:
                     break;
             }
         }
+
+        // Input accumulated by the event thread since the last frame
+        std::lock_guard<std::mutex> lock(inputMutex_);
+        frameInput_ = input_;
+        frameInput_.eventTime = eventTime_;
+        input_.deltaX = 0.0;
+        input_.deltaY = 0.0;
+        input_.wheelDelta = 0.0;
+        input_.keyHPresses = 0;
+        input_.exposed = false;
+        input_.events.clear();
+    }
+
+    void waitEvents(int timeoutMs) override {
+        if (display_ && !XPending(display_)) {
+            pollfd fds[2] = {{ConnectionNumber(display_), POLLIN, 0},
+                             {inputReady_.fd(), POLLIN, 0}};
+            poll(fds, 2, timeoutMs);
+            if (fds[1].revents & POLLIN) {
+                inputReady_.drain();
+            }
+        }
+        pollEvents();
     }
 
     bool shouldClose() const override {
         return shouldClose_;
     }
     InputState input() const override {
-        return input_;
+        return frameInput_;
+    }
+    int viewCount() const override {
+        return 1;
+    }
+    WindowView view(int) const override {
+        return WindowView{std::string(), width_, height_};
+    }
+    void selectView(int) override {}
+    bool viewReady(int) const override {
+        return mapped_;
     }
     int width() const override {
         return width_;
@@ -257,25 +345,467 @@ public:
     }
 
     void swap() override {
+        ++swaps_;
+        if (software_) {
+            putSoftwareImage(DamageRect{0, 0, width_, height_});
+            return;
+        }
         if (display_ && window_) {
             glXSwapBuffers(display_, window_);
+            if (getSyncValues_) {
+                pendingSwaps_.push_back(PendingSwap{swaps_, ++issuedSbc_});
+                if (pendingSwaps_.size() > 8) {
+                    pendingSwaps_.pop_front();
+                }
+            }
         }
     }
 
+    void swapWithDamage(const DamageRect& damage) override {
+        if (software_) {
+            ++swaps_;
+            putSoftwareImage(damage);
+            return;
+        }
+        // GLX has no way to pass damage to the server; buffer age alone still
+        // lets the renderer skip unchanged pixels.
+        swap();
+    }
+
+    int bufferAge() override {
+        if (software_) {
+            return ensureSoftwareImage() ? softwareAge_ : 0;
+        }
+        if (!hasBufferAge_ || !display_ || !window_) {
+            return 0;
+        }
+        unsigned int age = 0;
+        glXQueryDrawable(display_, window_, GLX_BACK_BUFFER_AGE_EXT, &age);
+        return static_cast<int>(age);
+    }
+
+    std::vector<FramePresentation> takePresentations() override {
+        std::vector<FramePresentation> out;
+        if (!getSyncValues_ || pendingSwaps_.empty()) {
+            return out;
+        }
+        std::int64_t ust = 0;
+        std::int64_t msc = 0;
+        std::int64_t sbc = 0;
+        if (!getSyncValues_(display_, window_, &ust, &msc, &sbc)) {
+            return out;
+        }
+        // Only the latest completed swap's UST can be queried
+        while (!pendingSwaps_.empty() && pendingSwaps_.front().sbc < sbc) {
+            pendingSwaps_.pop_front();
+        }
+        if (pendingSwaps_.empty() || pendingSwaps_.front().sbc != sbc ||
+            !waitForSbc_(display_, window_, sbc, &ust, &msc, &sbc)) {
+            return out;
+        }
+        // UST is CLOCK_MONOTONIC in microseconds on Mesa and NVIDIA
+        double time = ust / 1e6;
+        if (std::abs(time - nowSeconds()) < 1.0) {
+            out.push_back(FramePresentation{pendingSwaps_.front().swap, time,
+                                            0.0});
+        }
+        pendingSwaps_.pop_front();
+        return out;
+    }
+
+    SoftwareFramebuffer softwareFramebuffer() override {
+        if (!software_ || !ensureSoftwareImage()) {
+            return {};
+        }
+        return SoftwareFramebuffer{
+            reinterpret_cast<std::uint32_t*>(image_->data), image_->width,
+            image_->height, image_->bytes_per_line / 4};
+    }
+
+    SoftwareFramebuffer viewportImage(int, int) override {
+        return {};
+    }
+
+    void setViewportSource(const ViewportSource&) override {}
+
     void* glGetProcAddress(const char* name) override {
         return reinterpret_cast<void*>(
             glXGetProcAddressARB(reinterpret_cast<const GLubyte*>(name)));
     }
 
 private:
+    // (Re)creates the software back buffer when missing or after a resize.
+    bool ensureSoftwareImage() {
+        if (image_ && image_->width == width_ && image_->height == height_) {
+            return true;
+        }
+        destroySoftwareImage();
+        if (!display_ || !visual_) {
+            return false;
+        }
+        if (depth_ < 24 || visual_->red_mask != 0xFF0000ul ||
+            visual_->green_mask != 0xFF00ul || visual_->blue_mask != 0xFFul) {
+            LOG_ERROR("software rendering needs a 24-bit TrueColor visual");
+            return false;
+        }
+        if (!createShmImage()) {
+            // Remote displays cannot share memory with us
+            image_ = XCreateImage(display_, visual_,
+                                  static_cast<unsigned int>(depth_), ZPixmap, 0,
+                                  nullptr, static_cast<unsigned int>(width_),
+                                  static_cast<unsigned int>(height_), 32, 0);
+            if (image_) {
+                image_->data = static_cast<char*>(std::malloc(
+                    static_cast<size_t>(image_->bytes_per_line) *
+                    static_cast<size_t>(height_)));
+                // Pixels are written as native 32-bit words; Xlib swaps them
+                // for the server if needed
+                image_->byte_order =
+                    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) ? LSBFirst
+                                                                : MSBFirst;
+            }
+        }
+        if (!image_ || !image_->data || image_->bits_per_pixel != 32) {
+            LOG_ERROR("failed to create software back buffer");
+            destroySoftwareImage();
+            return false;
+        }
+        LOG_DEBUG("x11: software back buffer %dx%d (%s)", width_, height_,
+                  usingShm_ ? "MIT-SHM" : "XPutImage");
+        softwareAge_ = 0;
+        return true;
+    }
+
+    bool createShmImage() {
+        if (!XShmQueryExtension(display_)) {
+            return false;
+        }
+        image_ = XShmCreateImage(display_, visual_,
+                                 static_cast<unsigned int>(depth_), ZPixmap,
+                                 nullptr, &shmInfo_,
+                                 static_cast<unsigned int>(width_),
+                                 static_cast<unsigned int>(height_));
+        if (!image_) {
+            return false;
+        }
+        shmInfo_.shmid = shmget(IPC_PRIVATE,
+                                static_cast<size_t>(image_->bytes_per_line) *
+                                    static_cast<size_t>(height_),
+                                IPC_CREAT | 0600);
+        if (shmInfo_.shmid < 0) {
+            XDestroyImage(image_);
+            image_ = nullptr;
+            return false;
+        }
+        shmInfo_.shmaddr =
+            static_cast<char*>(shmat(shmInfo_.shmid, nullptr, 0));
+        shmInfo_.readOnly = False;
+        image_->data = shmInfo_.shmaddr;
+
+        static bool attachFailed = false;
+        attachFailed = false;
+        // Put back whichever handler was installed, not Xlib's default, so
+        // the tolerated focus errors stay tolerated.
+        XErrorHandler previous =
+            XSetErrorHandler([](Display*, XErrorEvent*) {
+                attachFailed = true;
+                return 0;
+            });
+        XShmAttach(display_, &shmInfo_);
+        XSync(display_, False);
+        XSetErrorHandler(previous);
+        // The segment goes away once both sides have detached
+        shmctl(shmInfo_.shmid, IPC_RMID, nullptr);
+
+        if (attachFailed || shmInfo_.shmaddr == reinterpret_cast<char*>(-1)) {
+            if (shmInfo_.shmaddr != reinterpret_cast<char*>(-1)) {
+                shmdt(shmInfo_.shmaddr);
+            }
+            image_->data = nullptr;
+            XDestroyImage(image_);
+            image_ = nullptr;
+            return false;
+        }
+        usingShm_ = true;
+        return true;
+    }
+
+    void destroySoftwareImage() {
+        if (!image_) {
+            return;
+        }
+        if (usingShm_) {
+            XShmDetach(display_, &shmInfo_);
+            XSync(display_, False);
+            image_->data = nullptr;
+            XDestroyImage(image_);
+            shmdt(shmInfo_.shmaddr);
+        } else {
+            // Also frees the malloc'd pixels
+            XDestroyImage(image_);
+        }
+        image_ = nullptr;
+        usingShm_ = false;
+        softwareAge_ = 0;
+    }
+
+    void initSyncControl(const char* extensions) {
+        if (!hasExtension(extensions, "GLX_OML_sync_control")) {
+            LOG_DEBUG("glx: no OML sync control, presentation times unknown");
+            return;
+        }
+        auto getSyncValues = reinterpret_cast<PFNGLXGETSYNCVALUESOMLPROC>(
+            glXGetProcAddressARB(
+                reinterpret_cast<const GLubyte*>("glXGetSyncValuesOML")));
+        waitForSbc_ = reinterpret_cast<PFNGLXWAITFORSBCOMLPROC>(
+            glXGetProcAddressARB(
+                reinterpret_cast<const GLubyte*>("glXWaitForSbcOML")));
+        std::int64_t ust = 0;
+        std::int64_t msc = 0;
+        std::int64_t sbc = 0;
+        if (!getSyncValues || !waitForSbc_ ||
+            !getSyncValues(display_, window_, &ust, &msc, &sbc)) {
+            return;
+        }
+        getSyncValues_ = getSyncValues;
+        issuedSbc_ = sbc;
+    }
+
+    // Asks the compositing manager, if one runs, to unredirect the window
+    // so frames skip the composite pass. X11 has no way to learn whether it
+    // did, so only the request is logged.
+    void requestCompositorBypass(int screen) {
+        long bypass = 1;
+        XChangeProperty(display_, window_,
+                        XInternAtom(display_, "_NET_WM_BYPASS_COMPOSITOR",
+                                    False),
+                        XA_CARDINAL, 32, PropModeReplace,
+                        reinterpret_cast<unsigned char*>(&bypass), 1);
+        std::string selection = "_NET_WM_CM_S" + std::to_string(screen);
+        Atom cmAtom = XInternAtom(display_, selection.c_str(), False);
+        if (XGetSelectionOwner(display_, cmAtom) == None) {
+            LOG_INFO("x11: no compositing manager, frames go straight to the "
+                     "screen");
+        } else {
+            LOG_INFO("x11: compositor bypass requested; the compositing "
+                     "manager may ignore it");
+        }
+    }
+
+    // Swap interval 0, so swaps neither wait for vblank nor throttle the
+    // render loop. Adaptive vsync (-1) is not used: it still waits whenever
+    // a frame is on time.
+    void disableSwapWait(const char* extensions) {
+        if (hasExtension(extensions, "GLX_EXT_swap_control")) {
+            auto swapInterval = reinterpret_cast<PFNGLXSWAPINTERVALEXTPROC>(
+                glXGetProcAddressARB(
+                    reinterpret_cast<const GLubyte*>("glXSwapIntervalEXT")));
+            if (swapInterval) {
+                swapInterval(display_, window_, 0);
+                LOG_INFO("glx: swap interval 0, frames may tear");
+                return;
+            }
+        }
+        if (hasExtension(extensions, "GLX_MESA_swap_control")) {
+            auto swapInterval = reinterpret_cast<PFNGLXSWAPINTERVALMESAPROC>(
+                glXGetProcAddressARB(
+                    reinterpret_cast<const GLubyte*>("glXSwapIntervalMESA")));
+            if (swapInterval && swapInterval(0) == 0) {
+                LOG_INFO("glx: swap interval 0, frames may tear");
+                return;
+            }
+        }
+        LOG_WARN("glx: no swap control, swaps stay vsynced");
+    }
+
+    void startEventThread() {
+        inputDisplay_ = XOpenDisplay(nullptr);
+        if (!inputDisplay_) {
+            LOG_WARN("x11: no input connection, reading input on the "
+                     "render thread");
+            XSelectInput(display_, window_, kWindowEventMask | kInputEventMask);
+            return;
+        }
+        XSelectInput(inputDisplay_, window_, kInputEventMask);
+        XSync(inputDisplay_, False);
+        eventThread_ = std::thread([this] { runEventThread(); });
+    }
+
+    void runEventThread() {
+        TRACE_THREAD("x11 input");
+        int fd = ConnectionNumber(inputDisplay_);
+        for (;;) {
+            bool handled = false;
+            while (XPending(inputDisplay_)) {
+                XEvent ev{};
+                XNextEvent(inputDisplay_, &ev);
+                TRACE_ZONE("handle input");
+                std::lock_guard<std::mutex> lock(inputMutex_);
+                if (handleInputEvent(ev)) {
+                    eventTime_ = nowSeconds();
+                    handled = true;
+                }
+            }
+            if (handled) {
+                inputReady_.signal();
+            }
+
+            pollfd fds[2] = {{fd, POLLIN, 0}, {stopEvents_.fd(), POLLIN, 0}};
+            if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+                break;
+            }
+            if ((fds[1].revents & POLLIN) ||
+                (fds[0].revents & (POLLERR | POLLHUP))) {
+                break;
+            }
+        }
+    }
+
+    // Applies a pointer or keyboard event to input_; false for other
+    // events. Called with inputMutex_ held.
+    bool handleInputEvent(const XEvent& ev) {
+        switch (ev.type) {
+            case MotionNotify: {
+                double x = ev.xmotion.x;
+                double y = ev.xmotion.y;
+                if (!hasLastMouse_) {
+                    lastMouseX_ = x;
+                    lastMouseY_ = y;
+                    hasLastMouse_ = true;
+                }
+                InputEvent event;
+                event.type = InputEvent::Type::Motion;
+                event.time = eventTimeSeconds(
+                    static_cast<std::uint32_t>(ev.xmotion.time));
+                event.x = x;
+                event.y = y;
+                event.dx = x - lastMouseX_;
+                event.dy = y - lastMouseY_;
+                input_.events.push_back(event);
+                input_.deltaX += event.dx;
+                input_.deltaY += event.dy;
+                lastMouseX_ = x;
+                lastMouseY_ = y;
+                input_.mouseX = x;
+                input_.mouseY = y;
+                return true;
+            }
+            case ButtonPress:
+            case ButtonRelease: {
+                InputEvent event;
+                event.type = InputEvent::Type::Button;
+                event.time = eventTimeSeconds(
+                    static_cast<std::uint32_t>(ev.xbutton.time));
+                event.pressed = (ev.type == ButtonPress);
+                if (ev.xbutton.button == Button1) {
+                    event.button = PointerButton::Left;
+                    input_.mouseLeft = event.pressed;
+                } else if (ev.xbutton.button == Button3) {
+                    event.button = PointerButton::Right;
+                    input_.mouseRight = event.pressed;
+                } else if (event.pressed && (ev.xbutton.button == Button4 ||
+                                             ev.xbutton.button == Button5)) {
+                    // Wheel clicks come as press/release pairs
+                    event.type = InputEvent::Type::Wheel;
+                    event.wheel = ev.xbutton.button == Button4 ? -1.0 : 1.0;
+                    input_.wheelDelta += event.wheel;
+                } else {
+                    return true;
+                }
+                input_.events.push_back(event);
+                return true;
+            }
+            case KeyPress:
+            case KeyRelease: {
+                bool pressed = (ev.type == KeyPress);
+                XKeyEvent key = ev.xkey;
+                KeySym sym = XLookupKeysym(&key, 0);
+                if (sym == XK_q || sym == XK_Q) {
+                    input_.keyQ = pressed;
+                } else if (sym == XK_a || sym == XK_A) {
+                    input_.keyA = pressed;
+                } else if ((sym == XK_h || sym == XK_H) && pressed) {
+                    ++input_.keyHPresses;
+                } else if (sym == XK_Control_L || sym == XK_Control_R) {
+                    input_.keyCtrl = pressed;
+                } else if (sym == XK_Shift_L || sym == XK_Shift_R) {
+                    input_.keyShift = pressed;
+                }
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    void putSoftwareImage(const DamageRect& damage) {
+        if (!image_ || !gc_) {
+            return;
+        }
+        DamageRect rect = intersectDamage(
+            damage, DamageRect{0, 0, image_->width, image_->height});
+        if (rect.empty()) {
+            return;
+        }
+        // Damage has a bottom-left origin, X11 a top-left one
+        int y = image_->height - (rect.y + rect.h);
+        unsigned int w = static_cast<unsigned int>(rect.w);
+        unsigned int h = static_cast<unsigned int>(rect.h);
+        if (usingShm_) {
+            XShmPutImage(display_, window_, gc_, image_, rect.x, y, rect.x, y,
+                         w, h, False);
+        } else {
+            XPutImage(display_, window_, gc_, image_, rect.x, y, rect.x, y, w,
+                      h);
+        }
+        // The server reads the shared image asynchronously; wait until it is
+        // done before the next frame draws into it
+        XSync(display_, False);
+        softwareAge_ = 1;
+    }
+
     Display* display_ = nullptr;
     Window window_ = 0;
+    Colormap colormap_ = 0;
+    bool mapped_ = false;
+    double createTime_ = 0.0;
     GLXContext context_ = nullptr;
     Atom wmDelete_ = 0;
+    bool hasBufferAge_ = false;
+
+    // GLX_OML_sync_control: swaps waiting for their completion time
+    struct PendingSwap {
+        std::uint64_t swap;
+        std::int64_t sbc;
+    };
+    PFNGLXGETSYNCVALUESOMLPROC getSyncValues_ = nullptr;
+    PFNGLXWAITFORSBCOMLPROC waitForSbc_ = nullptr;
+    std::int64_t issuedSbc_ = 0;
+    std::deque<PendingSwap> pendingSwaps_;
+    std::uint64_t swaps_ = 0;
+
+    bool software_ = false;
+    Visual* visual_ = nullptr;
+    int depth_ = 0;
+    GC gc_ = nullptr;
+    XImage* image_ = nullptr;
+    XShmSegmentInfo shmInfo_{};
+    bool usingShm_ = false;
+    int softwareAge_ = 0;
+
     bool shouldClose_ = false;
     bool valid_ = false;
 
+    Display* inputDisplay_ = nullptr;
+    std::thread eventThread_;
+    WakeFd stopEvents_;
+    WakeFd inputReady_;
+    // Guards input_, eventTime_ and the last mouse position; frameInput_
+    // is the render thread's snapshot.
+    std::mutex inputMutex_;
     InputState input_{};
+    InputState frameInput_{};
+    double eventTime_ = 0.0;
     int width_ = 0;
     int height_ = 0;
     bool hasLastMouse_ = false;
@@ -283,8 +813,9 @@ private:
     double lastMouseY_ = 0.0;
 };
 
-std::unique_ptr<IWindow> CreateX11WindowGlx(const WindowConfig& config) {
-    auto window = std::make_unique<X11WindowGlx>(config);
+std::unique_ptr<IWindow> CreateX11WindowGlx(const WindowConfig& config,
+                                            DisplayConnection& connection) {
+    auto window = std::make_unique<X11WindowGlx>(config, connection);
     if (!window->isValid()) {
         return nullptr;
     }